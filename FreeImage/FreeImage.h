@@ -487,6 +487,16 @@ FI_ENUM(FREE_IMAGE_JPEG_OPERATION) {
 	FIJPEG_OP_ROTATE_270	= 7		//! 270-degree clockwise (or 90 ccw)
 };
 
+/** Blend modes of 32-bit images.
+Constants used in FreeImage_Blend. The alpha of the result is the one of src over dst in every mode.
+*/
+FI_ENUM(FREE_IMAGE_BLEND_MODE) {
+	FIBLEND_OVER				= 0,	//! src over dst, straight (non-premultiplied) colors
+	FIBLEND_PREMULTIPLIED_OVER	= 1,	//! src over dst, both with colors premultiplied by their alpha
+	FIBLEND_ADD					= 2,	//! dst + src * src alpha, clamped to 255
+	FIBLEND_MULTIPLY			= 3		//! dst * src, src weighted by its alpha
+};
+
 /** Tone mapping operators.
 Constants used in FreeImage_ToneMapping.
 */
@@ -779,6 +789,30 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define FI_RESCALE_DEFAULT			0x00    //! default options; none of the following other options apply
 #define FI_RESCALE_TRUE_COLOR		0x01	//! for non-transparent greyscale images, convert to 24-bit if src bitdepth <= 8 (default is a 8-bit greyscale image). 
 #define FI_RESCALE_OMIT_METADATA	0x02	//! do not copy metadata to the rescaled image
+#define FI_RESCALE_THREADS(n)		(((unsigned)(n) & 0xFF) << 8)	//! run the filter passes on up to n threads (1 to 255); without it, the FreeImage_SetRescaleThreads count applies
+
+// Blend options (FreeImage_Blend) ------------------------------------------
+
+#define FI_BLEND_DEFAULT			0x00	//! blend on the calling thread
+#define FI_BLEND_THREADS(n)			(((unsigned)(n) & 0xFF) << 8)	//! blend bands of rows on up to n threads (1 to 255)
+
+// Thumbnail quality levels (FreeImage_MakeThumbnailEx) ---------------------
+
+#define FI_THUMBNAIL_FAST		0	//! box average 8-bit per channel images down to twice the thumbnail size, then one bilinear pass (FreeImage_MakeThumbnail)
+#define FI_THUMBNAIL_BALANCED	1	//! box average 8-bit per channel images down to 4 times the thumbnail size, then one Lanczos3 pass
+#define FI_THUMBNAIL_BEST		2	//! one Lanczos3 pass from the full image
+
+// SIMD instruction sets (FreeImage_SetSIMDLevel) ---------------------------
+
+#define FI_SIMD_NONE	0	//! plain C++ code for the resampling filters and the compositing functions
+#define FI_SIMD_SSE2	1	//! SSE2 kernels
+#define FI_SIMD_SSSE3	2	//! SSE2 and SSSE3 kernels
+#define FI_SIMD_AVX2	3	//! SSE2, SSSE3 and AVX2 kernels, the default
+
+// Streaming rescale callbacks (FreeImage_RescaleStream) --------------------
+
+typedef BOOL (DLL_CALLCONV *FI_RescaleReadProc)(void *data, unsigned y, BYTE *bits);	//! fills bits with the source row y, returns FALSE to abort
+typedef BOOL (DLL_CALLCONV *FI_RescaleWriteProc)(void *data, unsigned y, const BYTE *bits);	//! receives the destination row y, returns FALSE to abort
 
 
 #ifdef __cplusplus
@@ -811,6 +845,19 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateT(FREE_IMAGE_TYPE type, int wid
 DLL_API FIBITMAP * DLL_CALLCONV FreeImage_Clone(FIBITMAP *dib);
 DLL_API void DLL_CALLCONV FreeImage_Unload(FIBITMAP *dib);
 
+// Bitmap memory routines. alloc_proc must return blocks aligned on a 16 bytes boundary (NULL on failure).
+// Each bitmap remembers the allocator it came from, so the allocator can be replaced while bitmaps are alive.
+typedef void *(DLL_CALLCONV *FI_AllocProc)(size_t size, void *user);
+typedef void (DLL_CALLCONV *FI_FreeProc)(void *data, void *user);
+
+FI_STRUCT (FreeImageAllocator) {
+	FI_AllocProc alloc_proc;	//! pointer to the function used to allocate a bitmap block
+	FI_FreeProc  free_proc;		//! pointer to the function used to release a block returned by alloc_proc
+	void *user;					//! passed to both functions
+};
+
+DLL_API void DLL_CALLCONV FreeImage_SetBitmapAllocator(FreeImageAllocator *allocator);
+
 // Header loading routines
 DLL_API BOOL DLL_CALLCONV FreeImage_HasPixels(FIBITMAP *dib);
 
@@ -896,6 +943,7 @@ DLL_API FREE_IMAGE_TYPE DLL_CALLCONV FreeImage_GetImageType(FIBITMAP *dib);
 // FreeImage helper routines ------------------------------------------------
 
 DLL_API BOOL DLL_CALLCONV FreeImage_IsLittleEndian(void);
+DLL_API void DLL_CALLCONV FreeImage_SetSIMDLevel(int level);
 DLL_API BOOL DLL_CALLCONV FreeImage_LookupX11Color(const char *szColor, BYTE *nRed, BYTE *nGreen, BYTE *nBlue);
 DLL_API BOOL DLL_CALLCONV FreeImage_LookupSVGColor(const char *szColor, BYTE *nRed, BYTE *nGreen, BYTE *nBlue);
 
@@ -1106,13 +1154,22 @@ DLL_API BOOL DLL_CALLCONV FreeImage_JPEGTransformCombinedFromMemory(FIMEMORY* sr
 // rotation and flipping
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor FI_DEFAULT(NULL));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask);
+DLL_API BOOL DLL_CALLCONV FreeImage_RotateInPlace(FIBITMAP *dib, double angle);
+DLL_API void DLL_CALLCONV FreeImage_SetRotateThreads(int threads);
 DLL_API BOOL DLL_CALLCONV FreeImage_FlipHorizontal(FIBITMAP *dib);
 DLL_API BOOL DLL_CALLCONV FreeImage_FlipVertical(FIBITMAP *dib);
 
 // upsampling / downsampling
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rescale(FIBITMAP *dib, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert FI_DEFAULT(TRUE));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeThumbnailEx(FIBITMAP *dib, int max_pixel_size, BOOL convert FI_DEFAULT(TRUE), int quality FI_DEFAULT(FI_THUMBNAIL_FAST));
+DLL_API int DLL_CALLCONV FreeImage_MakePyramid(FIBITMAP *dib, FIBITMAP **levels, int count, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_BOX));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleRect(FIBITMAP *dib, int dst_width, int dst_height, int left, int top, int right, int bottom, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+DLL_API BOOL DLL_CALLCONV FreeImage_RescaleInto(FIBITMAP *src, FIBITMAP *dst, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+DLL_API BOOL DLL_CALLCONV FreeImage_RescaleStream(FREE_IMAGE_TYPE type, int bpp, int width, int height, int dst_width, int dst_height, int left, int top, int right, int bottom, FI_RescaleReadProc read, FI_RescaleWriteProc write, void *data, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+DLL_API void DLL_CALLCONV FreeImage_SetRescaleThreads(int threads);
+DLL_API void DLL_CALLCONV FreeImage_SetRescaleCacheSize(unsigned entries);
+DLL_API void DLL_CALLCONV FreeImage_GetRescaleCacheStats(UINT64 *hits, UINT64 *misses);
 
 // color manipulation routines (point operations)
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustCurve(FIBITMAP *dib, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
@@ -1140,7 +1197,9 @@ DLL_API BOOL DLL_CALLCONV FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom);
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg FI_DEFAULT(FALSE), RGBQUAD *appBkColor FI_DEFAULT(NULL), FIBITMAP *bg FI_DEFAULT(NULL));
+DLL_API BOOL DLL_CALLCONV FreeImage_Blend(FIBITMAP *dst, FIBITMAP *src, int left, int top, FREE_IMAGE_BLEND_MODE mode FI_DEFAULT(FIBLEND_OVER), unsigned flags FI_DEFAULT(0));
 DLL_API BOOL DLL_CALLCONV FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib);
+DLL_API BOOL DLL_CALLCONV FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib);
 
 // background filling routines
 DLL_API BOOL DLL_CALLCONV FreeImage_FillBackground(FIBITMAP *dib, const void *color, int options FI_DEFAULT(0));
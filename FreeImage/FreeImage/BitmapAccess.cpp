@@ -103,6 +103,8 @@ FI_STRUCT (FREEIMAGEHEADER) {
 
 	/** contains a list of metadata models attached to the bitmap */
 	METADATAMAP *metadata;
+	/** storage of the metadata list, so that allocating a bitmap takes no other block than its own */
+	alignas(METADATAMAP) BYTE metadata_storage[sizeof(METADATAMAP)];
 
 	/** FALSE if the FIBITMAP only contains the header and no pixel data */
 	BOOL has_pixels;
@@ -118,6 +120,9 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	unsigned external_pitch;
 	//@}
 
+	/** allocator of this block, all NULL for FreeImage_Aligned_Malloc */
+	FreeImageAllocator allocator;
+
 	//BYTE filler[1];			 // fill to 32-bit alignment
 };
 
@@ -193,6 +198,44 @@ void FreeImage_Aligned_Free(void* mem) {
 
 #endif // _WIN32 || _WIN64
 
+// ----------------------------------------------------------
+//  User provided bitmap allocator
+// ----------------------------------------------------------
+
+/** allocator used for new bitmaps. NULL procs select FreeImage_Aligned_Malloc */
+static FreeImageAllocator s_bitmap_allocator = { NULL, NULL, NULL };
+
+/**
+Set the allocator used for the memory block (header, palette and pixels) of the bitmaps allocated from now on.
+Pass NULL to restore the default allocator. This is not synchronized with allocations made by other threads, 
+so it should be called before FreeImage is used concurrently.
+*/
+void DLL_CALLCONV
+FreeImage_SetBitmapAllocator(FreeImageAllocator *allocator) {
+	if(allocator && allocator->alloc_proc && allocator->free_proc) {
+		s_bitmap_allocator = *allocator;
+	} else {
+		memset(&s_bitmap_allocator, 0, sizeof(FreeImageAllocator));
+	}
+}
+
+static void*
+FreeImage_AllocateBlock(size_t amount, const FreeImageAllocator *allocator) {
+	if(allocator->alloc_proc) {
+		return allocator->alloc_proc(amount, allocator->user);
+	}
+	return FreeImage_Aligned_Malloc(amount, FIBITMAP_ALIGNMENT);
+}
+
+static void
+FreeImage_FreeBlock(void *mem, const FreeImageAllocator *allocator) {
+	if(allocator->free_proc) {
+		allocator->free_proc(mem, allocator->user);
+	} else {
+		FreeImage_Aligned_Free(mem);
+	}
+}
+
 // ----------------------------------------------------------
 //  FIBITMAP memory management
 // ----------------------------------------------------------
@@ -387,7 +430,9 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 			return NULL;
 		}
 
-		bitmap->data = (BYTE *)FreeImage_Aligned_Malloc(dib_size * sizeof(BYTE), FIBITMAP_ALIGNMENT);
+		const FreeImageAllocator allocator = s_bitmap_allocator;
+
+		bitmap->data = (BYTE *)FreeImage_AllocateBlock(dib_size * sizeof(BYTE), &allocator);
 
 		if (bitmap->data != NULL) {
 			memset(bitmap->data, 0, dib_size);
@@ -415,7 +460,7 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 
 			// initialize metadata models list
 
-			fih->metadata = new(std::nothrow) METADATAMAP;
+			fih->metadata = new(fih->metadata_storage) METADATAMAP;
 
 			// initialize attached thumbnail
 
@@ -426,6 +471,10 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 			fih->external_bits = ext_bits;
 			fih->external_pitch = ext_pitch;
 
+			// remember how to release the block
+
+			fih->allocator = allocator;
+
 			// write out the BITMAPINFOHEADER
 
 			BITMAPINFOHEADER *bih   = FreeImage_GetInfoHeader(bitmap);
@@ -517,13 +566,14 @@ FreeImage_Unload(FIBITMAP *dib) {
 				}
 			}
 
-			delete metadata;
+			metadata->~METADATAMAP();
 
 			// delete embedded thumbnail
 			FreeImage_Unload(FreeImage_GetThumbnail(dib));
 
 			// delete bitmap ...
-			FreeImage_Aligned_Free(dib->data);
+			const FreeImageAllocator allocator = ((FREEIMAGEHEADER *)dib->data)->allocator;
+			FreeImage_FreeBlock(dib->data, &allocator);
 		}
 
 		free(dib);		// ... and the wrapper
@@ -565,6 +615,9 @@ FreeImage_Clone(FIBITMAP *dib) {
 		METADATAMAP *src_metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
 		METADATAMAP *dst_metadata = ((FREEIMAGEHEADER *)new_dib->data)->metadata;
 
+		// save the allocator of new_dib
+		const FreeImageAllocator dst_allocator = ((FREEIMAGEHEADER *)new_dib->data)->allocator;
+
 		// calculate the size of the dst image
 		// align the palette and the pixels on a FIBITMAP_ALIGNMENT bytes alignment boundary
 		// palette is aligned on a 16 bytes boundary
@@ -580,8 +633,11 @@ FreeImage_Clone(FIBITMAP *dib) {
 		// reset ICC profile link for new_dib
 		memset(dst_iccProfile, 0, sizeof(FIICCPROFILE));
 
-		// restore metadata link for new_dib
-		((FREEIMAGEHEADER *)new_dib->data)->metadata = dst_metadata;
+		// the copy overwrote the empty metadata list of new_dib, construct it again
+		((FREEIMAGEHEADER *)new_dib->data)->metadata = new(dst_metadata) METADATAMAP;
+
+		// restore allocator for new_dib
+		((FREEIMAGEHEADER *)new_dib->data)->allocator = dst_allocator;
 
 		// reset thumbnail link for new_dib
 		((FREEIMAGEHEADER *)new_dib->data)->thumbnail = NULL;
@@ -1554,8 +1610,7 @@ FreeImage_GetMemorySize(FIBITMAP *dib) {
 		return (unsigned)size;
 	}
 
-	// add size of METADATAMAP
-	size += sizeof(METADATAMAP);
+	// the METADATAMAP itself is part of the FREEIMAGEHEADER
 
 	const size_t models = md->size();
 	if (models == 0) {
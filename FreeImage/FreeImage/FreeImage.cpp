@@ -29,6 +29,10 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#if defined(FI_HAS_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 //----------------------------------------------------------------------
 
 static const char *s_copyright = "This program uses FreeImage, a free, open source image library supporting all common bitmap formats. See http://freeimage.sourceforge.net for details";
@@ -104,6 +108,82 @@ FreeImage_IsLittleEndian() {
 
 //----------------------------------------------------------------------
 
+/**
+Highest instruction set the kernels may use, see FreeImage_SetSIMDLevel
+*/
+static int s_simd_level = FI_SIMD_AVX2;
+
+/**
+Limits the SIMD kernels to an instruction set, mostly to compare them with the plain C++ code. 
+Instruction sets the processor doesn't support are never used, whatever the level. 
+Not to be called while other threads use FreeImage.
+@param level FI_SIMD_NONE, FI_SIMD_SSE2, FI_SIMD_SSSE3 or FI_SIMD_AVX2
+*/
+void DLL_CALLCONV
+FreeImage_SetSIMDLevel(int level) {
+	s_simd_level = MAX((int)FI_SIMD_NONE, MIN(level, (int)FI_SIMD_AVX2));
+}
+
+static BOOL
+DetectSSSE3() {
+#ifndef FI_HAS_SSSE3
+	return FALSE;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3") ? TRUE : FALSE;
+#endif
+}
+
+static BOOL
+DetectAVX2() {
+#ifndef FI_HAS_AVX2
+	return FALSE;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return FALSE;
+	}
+	__cpuid(info, 1);
+	// OSXSAVE and AVX, and the OS saves the YMM registers
+	if (((info[2] & (1 << 27)) == 0) || ((info[2] & (1 << 28)) == 0) || ((_xgetbv(0) & 6) != 6)) {
+		return FALSE;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+#endif
+}
+
+BOOL
+HasSSE2() {
+#ifndef FI_HAS_SSE2
+	return FALSE;
+#else
+	return (s_simd_level >= FI_SIMD_SSE2);
+#endif
+}
+
+BOOL
+HasSSSE3() {
+	static const BOOL has_ssse3 = DetectSSSE3();
+	return has_ssse3 && (s_simd_level >= FI_SIMD_SSSE3);
+}
+
+BOOL
+HasAVX2() {
+	static const BOOL has_avx2 = DetectAVX2();
+	return has_avx2 && (s_simd_level >= FI_SIMD_AVX2);
+}
+
+//----------------------------------------------------------------------
+
 static FreeImage_OutputMessageFunction freeimage_outputmessage_proc = NULL;
 static FreeImage_OutputMessageFunctionStdCall freeimage_outputmessagestdcall_proc = NULL; 
 
@@ -524,6 +524,11 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 
 // ----------------------------------------------------------
 
+static BOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
 static void *DLL_CALLCONV 
 Open(FreeImageIO *io, fi_handle handle, BOOL read) {
 	GIFinfo *info = new(std::nothrow) GIFinfo;
@@ -669,6 +674,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		return NULL;
 	}
 
+	const BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
 	FIBITMAP *dib = NULL;
 	try {
 		bool have_transparent = false, no_local_palette = false, interlaced = false;
@@ -703,11 +710,16 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			background.rgbReserved = 0;
 
 			//allocate entire logical area
-			dib = FreeImage_Allocate(logicalwidth, logicalheight, 32);
+			dib = FreeImage_AllocateHeader(header_only, logicalwidth, logicalheight, 32);
 			if( dib == NULL ) {
 				throw FI_MSG_ERROR_DIB_MEMORY;
 			}
 
+			if( header_only ) {
+				//the composed frame is always 32-bit, no need to play anything back
+				return dib;
+			}
+
 			//fill with background color to start
 			int x, y;
 			RGBQUAD *scanline;
@@ -863,7 +875,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				else if( info->global_color_table_size <= 16 ) bpp = 4;
 			}
 		}
-		dib = FreeImage_Allocate(width, height, bpp);
+		dib = FreeImage_AllocateHeader(header_only, width, height, bpp);
 		if( dib == NULL ) {
 			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
@@ -909,49 +921,54 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}
 		}
 
-		//LZW Minimum Code Size
-		io->read_proc(&b, 1, 1, handle);
-		StringTable *stringtable = new(std::nothrow) StringTable;
-		stringtable->Initialize(b);
+		//Image Data, skipped when only the header is requested
+		if( !header_only ) {
+			//LZW Minimum Code Size
+			io->read_proc(&b, 1, 1, handle);
+			StringTable *stringtable = new(std::nothrow) StringTable;
+			stringtable->Initialize(b);
 
-		//Image Data Sub-blocks
-		int x = 0, xpos = 0, y = 0, shift = 8 - bpp, mask = (1 << bpp) - 1, interlacepass = 0;
-		BYTE *scanline = FreeImage_GetScanLine(dib, height - 1);
-		BYTE buf[4096];
-		io->read_proc(&b, 1, 1, handle);
-		while( b ) {
-			io->read_proc(stringtable->FillInputBuffer(b), b, 1, handle);
-			int size = sizeof(buf);
-			while( stringtable->Decompress(buf, &size) ) {
-				for( int i = 0; i < size; i++ ) {
-					scanline[xpos] |= (buf[i] & mask) << shift;
-					if( shift > 0 ) {
-						shift -= bpp;
-					} else {
-						xpos++;
-						shift = 8 - bpp;
-					}
-					if( ++x >= width ) {
-						if( interlaced ) {
-							y += g_GifInterlaceIncrement[interlacepass];
-							if( y >= height && ++interlacepass < GIF_INTERLACE_PASSES ) {
-								y = g_GifInterlaceOffset[interlacepass];
-							} 						
+			//Image Data Sub-blocks
+			int x = 0, xpos = 0, y = 0, shift = 8 - bpp, mask = (1 << bpp) - 1, interlacepass = 0;
+			BYTE *scanline = FreeImage_GetScanLine(dib, height - 1);
+			BYTE buf[4096];
+			io->read_proc(&b, 1, 1, handle);
+			while( b ) {
+				io->read_proc(stringtable->FillInputBuffer(b), b, 1, handle);
+				int size = sizeof(buf);
+				while( stringtable->Decompress(buf, &size) ) {
+					for( int i = 0; i < size; i++ ) {
+						scanline[xpos] |= (buf[i] & mask) << shift;
+						if( shift > 0 ) {
+							shift -= bpp;
 						} else {
-							y++;
+							xpos++;
+							shift = 8 - bpp;
 						}
-						if( y >= height ) {
-							stringtable->Done();
-							break;
+						if( ++x >= width ) {
+							if( interlaced ) {
+								y += g_GifInterlaceIncrement[interlacepass];
+								if( y >= height && ++interlacepass < GIF_INTERLACE_PASSES ) {
+									y = g_GifInterlaceOffset[interlacepass];
+								} 						
+							} else {
+								y++;
+							}
+							if( y >= height ) {
+								stringtable->Done();
+								break;
+							}
+							x = xpos = 0;
+							shift = 8 - bpp;
+							scanline = FreeImage_GetScanLine(dib, height - y - 1);
 						}
-						x = xpos = 0;
-						shift = 8 - bpp;
-						scanline = FreeImage_GetScanLine(dib, height - y - 1);
 					}
+					size = sizeof(buf);
 				}
-				size = sizeof(buf);
+				io->read_proc(&b, 1, 1, handle);
 			}
-			io->read_proc(&b, 1, 1, handle);
+
+			delete stringtable;
 		}
 
 		if( page == 0 ) {
@@ -1058,8 +1075,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		b = (BYTE)disposal_method;
 		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "DisposalMethod", ANIMTAG_DISPOSALMETHOD, FIDT_BYTE, 1, 1, &b);
 
-		delete stringtable;
-
 	} catch (const char *msg) {
 		if( dib != NULL ) {
 			FreeImage_Unload(dib);
@@ -1402,4 +1417,5 @@ InitGIF(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = NULL;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
 }
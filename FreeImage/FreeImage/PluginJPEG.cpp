@@ -1198,22 +1198,19 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// step 4: set parameters for decompression
 
-			unsigned int scale_denom = 1;		// fraction by which to scale image
+			unsigned int scale_num = 8;			// the image is scaled by scale_num / 8
 			int	requested_size = flags >> 16;	// requested user size in pixels
 			if(requested_size > 0) {
-				// the JPEG codec can perform x2, x4 or x8 scaling on loading
-				// try to find the more appropriate scaling according to user's need
-				double scale = MAX((double)cinfo.image_width, (double)cinfo.image_height) / (double)requested_size;
-				if(scale >= 8) {
-					scale_denom = 8;
-				} else if(scale >= 4) {
-					scale_denom = 4;
-				} else if(scale >= 2) {
-					scale_denom = 2;
+				// the JPEG codec can perform N/8 scaling (N = 1..8) on loading
+				// pick the smallest scaling whose output still covers the user's need
+				unsigned max_size = MAX(cinfo.image_width, cinfo.image_height);
+				scale_num = 1;
+				while((scale_num < 8) && ((max_size * scale_num + 7) / 8 < (unsigned)requested_size)) {
+					scale_num++;
 				}
 			}
-			cinfo.scale_num = 1;
-			cinfo.scale_denom = scale_denom;
+			cinfo.scale_num = scale_num;
+			cinfo.scale_denom = 8;
 
 			if ((flags & JPEG_ACCURATE) != JPEG_ACCURATE) {
 				cinfo.dct_method          = JDCT_IFAST;
@@ -1259,7 +1256,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 				}
 			}
-			if(scale_denom != 1) {
+			if(scale_num != 8) {
 				// store original size info if a scaling was requested
 				store_size_info(dib, cinfo.image_width, cinfo.image_height);
 			}
@@ -0,0 +1,178 @@
+// ==========================================================
+// Thread pool used to split filters into bands of rows or columns
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+// ----------------------------------------------------------
+
+/// Upper limit of the number of worker threads
+#define FI_MAX_WORKER_THREADS	255
+
+/// Number of bands per thread, so that faster threads can take over the work of slower ones
+#define FI_BANDS_PER_THREAD		4
+
+namespace {
+
+/**
+A FreeImage_ParallelFor call, shared by the threads working on it
+*/
+struct ParallelJob {
+	/// Function processing a band, only used while bands remain
+	const std::function<void(unsigned, unsigned)> *body;
+	/// Number of items
+	unsigned count;
+	/// Number of items per band
+	unsigned band_size;
+	/// Number of bands
+	unsigned bands;
+	/// Next band to hand out
+	std::atomic<unsigned> next;
+	/// Number of bands not finished yet, guarded by mutex
+	unsigned remaining;
+	std::mutex mutex;
+	std::condition_variable finished;
+};
+
+/**
+Processes bands of a job until none is left
+*/
+void
+RunBands(ParallelJob &job) {
+	for(;;) {
+		const unsigned band = job.next.fetch_add(1);
+		if(band >= job.bands) {
+			break;
+		}
+		const unsigned first = band * job.band_size;
+		const unsigned last = (job.count - first > job.band_size) ? first + job.band_size : job.count;
+		(*job.body)(first, last);
+
+		std::lock_guard<std::mutex> lock(job.mutex);
+		if(--job.remaining == 0) {
+			job.finished.notify_all();
+		}
+	}
+}
+
+/**
+Worker threads waiting for jobs. A job is queued once per worker asked to help with it,
+a worker finding all bands already taken just moves on to the next job.
+*/
+class ThreadPool {
+public:
+	/**
+	Asks 'helpers' workers to process bands of a job, creating the missing workers
+	*/
+	void submit(const std::shared_ptr<ParallelJob> &job, unsigned helpers) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while(m_workers < helpers) {
+			try {
+				// workers are never joined: they wait for jobs until the process exits
+				std::thread(&ThreadPool::work, this).detach();
+				m_workers++;
+			} catch(const std::system_error&) {
+				// run with the workers we have, the calling thread processes bands as well
+				break;
+			}
+		}
+		for(unsigned i = 0; i < helpers; i++) {
+			m_queue.push_back(job);
+		}
+		m_wake.notify_all();
+	}
+
+private:
+	void work() {
+		for(;;) {
+			std::shared_ptr<ParallelJob> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this] { return !m_queue.empty(); });
+				job = m_queue.front();
+				m_queue.pop_front();
+			}
+			RunBands(*job);
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<std::shared_ptr<ParallelJob> > m_queue;
+	unsigned m_workers = 0;
+};
+
+ThreadPool&
+GetThreadPool() {
+	// never destroyed, the detached workers keep using it until the process exits
+	static ThreadPool *pool = new ThreadPool;
+	return *pool;
+}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+unsigned
+FreeImage_GetHardwareThreads() {
+	const unsigned threads = std::thread::hardware_concurrency();
+	return threads ? threads : 1;
+}
+
+void
+FreeImage_ParallelFor(unsigned count, unsigned threads, unsigned grain, const std::function<void(unsigned first, unsigned last)> &body) {
+	if(count == 0) {
+		return;
+	}
+	if(threads > FI_MAX_WORKER_THREADS + 1) {
+		threads = FI_MAX_WORKER_THREADS + 1;
+	}
+	if(grain == 0) {
+		grain = 1;
+	}
+
+	// band size: a multiple of grain, with about FI_BANDS_PER_THREAD bands per thread
+	const unsigned target = threads > 1 ? (count + threads * FI_BANDS_PER_THREAD - 1) / (threads * FI_BANDS_PER_THREAD) : count;
+	const unsigned band_size = ((target + grain - 1) / grain) * grain;
+	const unsigned bands = (count + band_size - 1) / band_size;
+	if(bands <= 1) {
+		body(0, count);
+		return;
+	}
+
+	std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>();
+	job->body = &body;
+	job->count = count;
+	job->band_size = band_size;
+	job->bands = bands;
+	job->next = 0;
+	job->remaining = bands;
+
+	GetThreadPool().submit(job, (threads < bands ? threads : bands) - 1);
+	RunBands(*job);
+
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->finished.wait(lock, [&job] { return job->remaining == 0; });
+}
@@ -46,6 +46,9 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 #include <float.h>
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#include <atomic>
 
 #define PI	((double)3.14159265358979323846264338327950288419716939937510)
 
@@ -54,6 +57,9 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 #define ROTATE_QUARTIC   4L	// Use B-splines of degree 4 (quartic interpolation)
 #define ROTATE_QUINTIC   5L	// Use B-splines of degree 5 (quintic interpolation)
 
+/// Minimum number of samples of the bands of lines converted or interpolated by a thread
+#define FI_BSPLINE_BAND_SAMPLES	65536
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Prototypes definition
@@ -61,11 +67,9 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 static void ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance);
 static double InitialCausalCoefficient(double *c, long DataLength, double z, double Tolerance);
 static void GetColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	GetRow(double *Image, long y, double *Line, long Width);
 static double InitialAntiCausalCoefficient(double *c, long DataLength, double z);
 static void	PutColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	PutRow(double *Image, long y, double *Line, long Width);
-static bool SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree);
+static bool SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree, unsigned threads);
 static double InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree);
 
 static FIBITMAP * Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask);
@@ -181,24 +185,6 @@ GetColumn(double *Image, long Width, long x, double *Line, long Height) {
 	}
 }
 
-/**
- GetRow
-
- @param Image Input image array
- @param y y coordinate of the selected line
- @param Line Output linear array
- @param Width Length of the line
-*/
-static void	
-GetRow(double *Image, long y, double *Line, long Width) {
-	long	x;
-
-	Image = Image + (y * Width);
-	for(x = 0L; x < Width; x++) {
-		Line[x] = (double)*Image++;
-	}
-}
-
 /**
  InitialAntiCausalCoefficient
 
@@ -233,24 +219,140 @@ PutColumn(double *Image, long Width, long x, double *Line, long Height) {
 	}
 }
 
+#ifdef FI_HAS_SSE2
+
 /**
- PutRow
+ Load2
 
- @param Image Output image array
- @param y y coordinate of the selected line
- @param Line Input linear array
- @param Width length of the line and width of the image
+ @param a Sample of the first line
+ @param b Sample of the second line
+ @return Returns the samples a and b in the low and high lanes
 */
-static void	
-PutRow(double *Image, long y, double *Line, long Width) {
-	long	x;
+static inline __m128d
+Load2(const double *a, const double *b) {
+	return _mm_loadh_pd(_mm_load_sd(a), b);
+}
+
+/**
+ Store2
 
-	Image = Image + (y * Width);
-	for(x = 0L; x < Width; x++) {
-		*Image++ = (double)Line[x];
+ @param a Sample of the first line
+ @param b Sample of the second line
+ @param value Samples of the low and high lanes
+*/
+static inline void
+Store2(double *a, double *b, __m128d value) {
+	_mm_storel_pd(a, value);
+	_mm_storeh_pd(b, value);
+}
+
+/**
+ InitialCausalCoefficient2.<br>
+ InitialCausalCoefficient of two lines, one per SSE2 lane
+
+ @param a First line of coefficients
+ @param b Second line of coefficients
+ @param Stride Distance between two coefficients of a line
+ @param DataLength Number of coefficients
+ @param z Actual pole
+ @param Tolerance Admissible relative error
+ @return
+*/
+static __m128d
+InitialCausalCoefficient2(const double *a, const double *b, long Stride, long DataLength, double z, double Tolerance) {
+	double	zn, z2n, iz;
+	__m128d	Sum;
+	long	n, Horizon;
+
+	// this initialization corresponds to mirror boundaries 
+	Horizon = DataLength;
+	if(Tolerance > 0) {
+		Horizon = (long)ceil(log(Tolerance) / log(fabs(z)));
+	}
+	if(Horizon < DataLength) {
+		// accelerated loop
+		zn = z;
+		Sum = Load2(a, b);
+		for (n = 1L; n < Horizon; n++) {
+			Sum = _mm_add_pd(Sum, _mm_mul_pd(_mm_set1_pd(zn), Load2(a + n * Stride, b + n * Stride)));
+			zn *= z;
+		}
+		return(Sum);
+	}
+	else {
+		// full loop 
+		const long last = (DataLength - 1L) * Stride;
+		zn = z;
+		iz = 1.0 / z;
+		z2n = pow(z, (double)(DataLength - 1L));
+		Sum = _mm_add_pd(Load2(a, b), _mm_mul_pd(_mm_set1_pd(z2n), Load2(a + last, b + last)));
+		z2n *= z2n * iz;
+		for (n = 1L; n <= DataLength - 2L; n++) {
+			Sum = _mm_add_pd(Sum, _mm_mul_pd(_mm_set1_pd(zn + z2n), Load2(a + n * Stride, b + n * Stride)));
+			zn *= z;
+			z2n *= iz;
+		}
+		return(_mm_div_pd(Sum, _mm_set1_pd(1.0 - zn * zn)));
 	}
 }
 
+/**
+ ConvertToInterpolationCoefficients2.<br>
+ ConvertToInterpolationCoefficients of two lines, one per SSE2 lane. 
+ Each lane performs the operations of the scalar function in the same order, 
+ so that the coefficients are identical.
+
+ @param a First line of samples --> coefficients
+ @param b Second line of samples --> coefficients
+ @param Stride Distance between two samples of a line (1 for rows, the image width for columns)
+ @param DataLength Number of samples or coefficients of each line
+ @param z Poles
+ @param NbPoles Number of poles
+ @param Tolerance Admissible relative error
+*/
+static void 
+ConvertToInterpolationCoefficients2(double *a, double *b, long Stride, long DataLength, double *z, long NbPoles, double Tolerance) {
+	double	Lambda = 1;
+	__m128d	c;
+	long	n, k;
+
+	// special case required by mirror boundaries
+	if(DataLength == 1L) {
+		return;
+	}
+	// compute the overall gain
+	for(k = 0L; k < NbPoles; k++) {
+		Lambda = Lambda * (1.0 - z[k]) * (1.0 - 1.0 / z[k]);
+	}
+	// apply the gain 
+	for (n = 0L; n < DataLength; n++) {
+		Store2(a + n * Stride, b + n * Stride, _mm_mul_pd(Load2(a + n * Stride, b + n * Stride), _mm_set1_pd(Lambda)));
+	}
+	// loop over all poles 
+	for (k = 0L; k < NbPoles; k++) {
+		const __m128d zk = _mm_set1_pd(z[k]);
+		// causal initialization 
+		c = InitialCausalCoefficient2(a, b, Stride, DataLength, z[k], Tolerance);
+		Store2(a, b, c);
+		// causal recursion 
+		for (n = 1L; n < DataLength; n++) {
+			c = _mm_add_pd(Load2(a + n * Stride, b + n * Stride), _mm_mul_pd(zk, c));
+			Store2(a + n * Stride, b + n * Stride, c);
+		}
+		// anticausal initialization 
+		const long last = (DataLength - 1L) * Stride;
+		c = _mm_mul_pd(_mm_set1_pd(z[k] / (z[k] * z[k] - 1.0)), _mm_add_pd(_mm_mul_pd(zk, Load2(a + last - Stride, b + last - Stride)), c));
+		Store2(a + last, b + last, c);
+		// anticausal recursion 
+		for (n = DataLength - 2L; 0 <= n; n--) {
+			c = _mm_mul_pd(zk, _mm_sub_pd(c, Load2(a + n * Stride, b + n * Stride)));
+			Store2(a + n * Stride, b + n * Stride, c);
+		}
+	}
+} 
+
+#endif // FI_HAS_SSE2
+
 /**
  SamplesToCoefficients.<br>
  Implement the algorithm that converts the image samples into B-spline coefficients. 
@@ -259,18 +361,20 @@ PutRow(double *Image, long y, double *Line, long Width) {
  Even though this algorithm is robust with respect to quantization, 
  we advocate the use of a floating-point format for the data. 
 
+ The rows, then the columns, are converted in bands spread over the threads. With SSE2, 
+ pairs of rows and of columns are converted at once.
+
  @param Image Input / Output image (in-place processing)
  @param Width Width of the image
  @param Height Height of the image
  @param spline_degree Degree of the spline model
+ @param threads Maximum number of threads
  @return Returns true if success, false otherwise
 */
 static bool	
-SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree) {
-	double	*Line;
+SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree, unsigned threads) {
 	double	Pole[2];
 	long	NbPoles;
-	long	x, y;
 
 	// recover the poles from a lookup table
 	switch (spline_degree) {
@@ -301,33 +405,56 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 
 	// convert the image samples into interpolation coefficients 
 
+#ifdef FI_HAS_SSE2
+	const long LinesPerStep = 2L;
+#else
+	const long LinesPerStep = 1L;
+#endif
+	std::atomic<bool> bResult(true);
+
 	// in-place separable process, along x 
-	Line = (double *)malloc(Width * sizeof(double));
-	if (Line == NULL) {
-		// Row allocation failed
-		return false;
-	}
-	for (y = 0L; y < Height; y++) {
-		GetRow(Image, y, Line, Width);
-		ConvertToInterpolationCoefficients(Line, Width, Pole, NbPoles, DBL_EPSILON);
-		PutRow(Image, y, Line, Width);
-	}
-	free(Line);
+	const unsigned nb_row_steps = (unsigned)((Height + LinesPerStep - 1L) / LinesPerStep);
+	FreeImage_ParallelFor(nb_row_steps, threads, 1 + FI_BSPLINE_BAND_SAMPLES / (LinesPerStep * Width), [&](unsigned first, unsigned last) {
+		for (long y = first * LinesPerStep; y < MIN((long)last * LinesPerStep, Height); y += LinesPerStep) {
+			double *Line = Image + (y * Width);
+#ifdef FI_HAS_SSE2
+			if (y + 1L < Height) {
+				ConvertToInterpolationCoefficients2(Line, Line + Width, 1L, Width, Pole, NbPoles, DBL_EPSILON);
+				continue;
+			}
+#endif
+			// the rows are converted in place
+			ConvertToInterpolationCoefficients(Line, Width, Pole, NbPoles, DBL_EPSILON);
+		}
+	});
 
 	// in-place separable process, along y 
-	Line = (double *)malloc(Height * sizeof(double));
-	if (Line == NULL) {
-		// Column allocation failed
-		return false;
-	}
-	for (x = 0L; x < Width; x++) {
-		GetColumn(Image, Width, x, Line, Height);
-		ConvertToInterpolationCoefficients(Line, Height, Pole, NbPoles, DBL_EPSILON);
-		PutColumn(Image, Width, x, Line, Height);
-	}
-	free(Line);
+	const unsigned nb_column_steps = (unsigned)((Width + LinesPerStep - 1L) / LinesPerStep);
+	FreeImage_ParallelFor(nb_column_steps, threads, 1 + FI_BSPLINE_BAND_SAMPLES / (LinesPerStep * Height), [&](unsigned first, unsigned last) {
+		double *Line = NULL;
+		for (long x = first * LinesPerStep; x < MIN((long)last * LinesPerStep, Width); x += LinesPerStep) {
+#ifdef FI_HAS_SSE2
+			if (x + 1L < Width) {
+				ConvertToInterpolationCoefficients2(Image + x, Image + x + 1L, Width, Height, Pole, NbPoles, DBL_EPSILON);
+				continue;
+			}
+#endif
+			if (Line == NULL) {
+				Line = (double *)malloc(Height * sizeof(double));
+				if (Line == NULL) {
+					// Column allocation failed
+					bResult = false;
+					return;
+				}
+			}
+			GetColumn(Image, Width, x, Line, Height);
+			ConvertToInterpolationCoefficients(Line, Height, Pole, NbPoles, DBL_EPSILON);
+			PutColumn(Image, Width, x, Line, Height);
+		}
+		free(Line);
+	});
 
-	return true;
+	return bResult;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -503,6 +630,101 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
 	return interpolated;
 }
 
+#ifdef FI_HAS_SSE2
+
+/**
+Computes the cubic interpolation weights of two positions, one per SSE2 lane, 
+with the operations of InterpolatedValue.
+
+@param w Distances of the positions to their second interpolation index
+@param Weight Output weights
+*/
+static inline void
+CubicWeights2(__m128d w, __m128d *Weight) {
+	const __m128d one = _mm_set1_pd(1.0);
+	Weight[3] = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_set1_pd(1.0 / 6.0), w), w), w);
+	Weight[0] = _mm_sub_pd(_mm_add_pd(_mm_set1_pd(1.0 / 6.0), _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(1.0 / 2.0), w), _mm_sub_pd(w, one))), Weight[3]);
+	Weight[2] = _mm_sub_pd(_mm_add_pd(w, Weight[0]), _mm_mul_pd(_mm_set1_pd(2.0), Weight[3]));
+	Weight[1] = _mm_sub_pd(_mm_sub_pd(_mm_sub_pd(one, Weight[0]), Weight[2]), Weight[3]);
+}
+
+/**
+Perform the cubic interpolation of two pixels, one per SSE2 lane. 
+The result is the one of InterpolatedValue, provided that the 4 x 4 coefficients 
+of both pixels lie inside the image, so that no mirror boundary applies.
+
+@param Bcoeff Input B-spline array of coefficients
+@param Width Width of the image
+@param x x coordinates where to interpolate
+@param y y coordinates where to interpolate
+@param xIndex Second horizontal interpolation index of each position, floor(x)
+@param yIndex Second vertical interpolation index of each position, floor(y)
+@return Returns the values of the cubic spline model at both positions
+*/
+static inline __m128d
+InterpolatedCubic2(const double *Bcoeff, long Width, const double *x, const double *y, const long *xIndex, const long *yIndex) {
+	__m128d	xWeight[4], yWeight[4];
+
+	// compute the interpolation weights
+	CubicWeights2(_mm_sub_pd(_mm_set_pd(x[1], x[0]), _mm_set_pd((double)xIndex[1], (double)xIndex[0])), xWeight);
+	CubicWeights2(_mm_sub_pd(_mm_set_pd(y[1], y[0]), _mm_set_pd((double)yIndex[1], (double)yIndex[0])), yWeight);
+
+	// perform interpolation
+	const double *p0 = Bcoeff + (yIndex[0] - 1L) * Width + xIndex[0] - 1L;
+	const double *p1 = Bcoeff + (yIndex[1] - 1L) * Width + xIndex[1] - 1L;
+	__m128d interpolated = _mm_setzero_pd();
+	for(int j = 0; j <= 3; j++) {
+		const __m128d a = _mm_loadu_pd(p0);
+		const __m128d b = _mm_loadu_pd(p1);
+		const __m128d c = _mm_loadu_pd(p0 + 2);
+		const __m128d d = _mm_loadu_pd(p1 + 2);
+		__m128d w = _mm_setzero_pd();
+		w = _mm_add_pd(w, _mm_mul_pd(xWeight[0], _mm_unpacklo_pd(a, b)));
+		w = _mm_add_pd(w, _mm_mul_pd(xWeight[1], _mm_unpackhi_pd(a, b)));
+		w = _mm_add_pd(w, _mm_mul_pd(xWeight[2], _mm_unpacklo_pd(c, d)));
+		w = _mm_add_pd(w, _mm_mul_pd(xWeight[3], _mm_unpackhi_pd(c, d)));
+		interpolated = _mm_add_pd(interpolated, _mm_mul_pd(yWeight[j], w));
+		p0 += Width;
+		p1 += Width;
+	}
+
+	return interpolated;
+}
+
+#endif // FI_HAS_SSE2
+
+/**
+Returns the 8-bit value of an image pixel.
+
+@param Bcoeff Input B-spline array of coefficients
+@param Width Width of the image
+@param Height Height of the image
+@param x x coordinate where to interpolate
+@param y y coordinate where to interpolate
+@param spline_degree Degree of the spline model
+@param use_mask Whether or not to mask the image
+@return Returns the clamped and rounded value of the spline model at (x, y), 
+0 outside of the image if use_mask is set
+*/
+static inline BYTE
+InterpolatedPixel(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree, BOOL use_mask) {
+	double p;
+
+	if(use_mask) {
+		if((x <= -0.5) || (((double)Width - 0.5) <= x) || (y <= -0.5) || (((double)Height - 0.5) <= y)) {
+			p = 0;
+		}
+		else {
+			p = (double)InterpolatedValue(Bcoeff, Width, Height, x, y, spline_degree);
+		}
+	}
+	else {
+		p = (double)InterpolatedValue(Bcoeff, Width, Height, x, y, spline_degree);
+	}
+	// clamp and convert to BYTE
+	return (BYTE)MIN(MAX((int)0, (int)(p + 0.5)), (int)255);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // FreeImage implementation
 
@@ -523,13 +745,15 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
 static FIBITMAP * 
 Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask) {
 	double	*ImageRasterArray;
-	double	p;
 	double	a11, a12, a21, a22;
-	double	x0, y0, x1, y1;
+	double	x0, y0;
 	long	x, y;
 	long	spline;
 	bool	bResult;
 
+	// the coefficients, then the output rows, are computed in bands spread over the threads
+	const unsigned threads = GetRotateThreads();
+
 	int bpp = FreeImage_GetBPP(dib);
 	if(bpp != 8) {
 		return NULL;
@@ -582,7 +806,7 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 
 	// convert between a representation based on image samples
 	// and a representation based on image B-spline coefficients
-	bResult = SamplesToCoefficients(ImageRasterArray, width, height, spline);
+	bResult = SamplesToCoefficients(ImageRasterArray, width, height, spline, threads);
 	if(!bResult) {
 		FreeImage_Unload(dst);
 		free(ImageRasterArray);
@@ -601,30 +825,50 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 	y_shift = y_origin - y0;
 
 	// visit all pixels of the output image and assign their value
-	for(y = 0; y < height; y++) {
-		BYTE *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
-		
-		x0 = a12 * (double)y + x_shift;
-		y0 = a22 * (double)y + y_shift;
-
-		for(x = 0; x < width; x++) {
-			x1 = x0 + a11 * (double)x;
-			y1 = y0 + a21 * (double)x;
-			if(use_mask) {
-				if((x1 <= -0.5) || (((double)width - 0.5) <= x1) || (y1 <= -0.5) || (((double)height - 0.5) <= y1)) {
-					p = 0;
-				}
-				else {
-					p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
+	FreeImage_ParallelFor(height, threads, 1 + FI_BSPLINE_BAND_SAMPLES / width, [&](unsigned first, unsigned last) {
+		for(long y = first; y < (long)last; y++) {
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
+			
+			const double x0 = a12 * (double)y + x_shift;
+			const double y0 = a22 * (double)y + y_shift;
+
+			long x = 0;
+#ifdef FI_HAS_SSE2
+			if(spline == 3L) {
+				// pairs of pixels whose coefficients lie inside the image are interpolated at once
+				for(; x + 1 < width; x += 2) {
+					double x1[2], y1[2];
+					long xIndex[2], yIndex[2];
+					bool inside = true;
+					for(int k = 0; k < 2; k++) {
+						x1[k] = x0 + a11 * (double)(x + k);
+						y1[k] = y0 + a21 * (double)(x + k);
+						inside = inside && (1.0 <= x1[k]) && (x1[k] < (double)(width - 2)) && (1.0 <= y1[k]) && (y1[k] < (double)(height - 2));
+					}
+					if(inside) {
+						for(int k = 0; k < 2; k++) {
+							xIndex[k] = (long)floor(x1[k]);
+							yIndex[k] = (long)floor(y1[k]);
+						}
+						double p[2];
+						_mm_storeu_pd(p, InterpolatedCubic2(ImageRasterArray, width, x1, y1, xIndex, yIndex));
+						for(int k = 0; k < 2; k++) {
+							// clamp and convert to BYTE
+							dst_bits[x + k] = (BYTE)MIN(MAX((int)0, (int)(p[k] + 0.5)), (int)255);
+						}
+					} else {
+						for(int k = 0; k < 2; k++) {
+							dst_bits[x + k] = InterpolatedPixel(ImageRasterArray, width, height, x1[k], y1[k], spline, use_mask);
+						}
+					}
 				}
 			}
-			else {
-				p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
+#endif
+			for(; x < width; x++) {
+				dst_bits[x] = InterpolatedPixel(ImageRasterArray, width, height, x0 + a11 * (double)x, y0 + a21 * (double)x, spline, use_mask);
 			}
-			// clamp and convert to BYTE
-			dst_bits[x] = (BYTE)MIN(MAX((int)0, (int)(p + 0.5)), (int)255);
 		}
-	}
+	});
 
 	// free working array and return
 	free(ImageRasterArray);
@@ -35,11 +35,65 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#include <stddef.h>
+
+#include <atomic>
 
 #define RBLOCK		64	// image blocks of RBLOCK*RBLOCK pixels
 
+/// Minimum number of pixels of the bands of rows or columns skewed by a thread
+#define FI_ROTATE_BAND_PIXELS	65536
+
+/// Number of columns skewed together by VerticalSkewT
+#define VSKEW_BAND	64
+
+/// Number of threads of the arbitrary angle rotations
+static std::atomic<unsigned> s_rotate_threads(1);
+
 // --------------------------------------------------------------------------
 
+/**
+Weighted part of the samples of a skewed row or column, which is moved to the next pixel. 
+Parameter T can be BYTE, WORD of float. 
+*/
+template <class T> class SkewWeight {
+public:
+	/// Sets the background color (samples values) and the relative weight of the row or column
+	void init(const T *bkg, unsigned samples, double weight) {
+		m_bkg = bkg;
+		m_weight = weight;
+	}
+	/// Returns the weighted part of sample j of a pixel
+	T left(unsigned j, T value) const {
+		return static_cast<T>(m_bkg[j] + (value - m_bkg[j]) * m_weight + 0.5);
+	}
+private:
+	const T *m_bkg;
+	double m_weight;
+};
+
+/**
+8-bit samples take their weighted parts from a table computed once per row or column, 
+with the expression of the generic version so that the values are the same.
+*/
+template <> class SkewWeight<BYTE> {
+public:
+	void init(const BYTE *bkg, unsigned samples, double weight) {
+		for(unsigned j = 0; j < samples; j++) {
+			for(int value = 0; value < 256; value++) {
+				m_table[j][value] = static_cast<BYTE>(bkg[j] + (value - bkg[j]) * weight + 0.5);
+			}
+		}
+	}
+	BYTE left(unsigned j, BYTE value) const {
+		return m_table[j][value];
+	}
+private:
+	BYTE m_table[4][256];
+};
+
 /**
 Skews a row horizontally (with filtered weights). 
 Limited to 45 degree skewing only. Filters two adjacent pixels.
@@ -76,6 +130,9 @@ HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weigh
 	BYTE *src_bits = FreeImage_GetScanLine(src, row);
 	BYTE *dst_bits = FreeImage_GetScanLine(dst, row);
 
+	SkewWeight<T> left;
+	left.init(pxlBkg, samples, weight);
+
 	// fill gap left of skew with background
 	if(bkcolor) {
 		for(int k = 0; k < iOffset; k++) {
@@ -94,7 +151,7 @@ HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weigh
 		AssignPixel((BYTE*)&pxlSrc[0], (BYTE*)src_bits, bytespp);
 		// calculate weights
 		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
+			pxlLeft[j] = left.left(j, pxlSrc[j]);
 		}
 		// check boundaries 
 		iXPos = i + iOffset;
@@ -172,24 +229,27 @@ HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeigh
 }
 
 /**
-Skews a column vertically (with filtered weights). 
+Skews columns vertically (with filtered weights). 
 Limited to 45 degree skewing only. Filters two adjacent pixels.
 Parameter T can be BYTE, WORD of float. 
+The columns are skewed VSKEW_BAND at a time, walking the rows of the band from top to bottom 
+rather than each column on its own, so that the pixels of a row are read together.
 @param src Pointer to source image to rotate
 @param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
+@param first First column index
+@param last Last column index (excluded)
+@param offsets Skew offset of each column, the fractional part is the relative weight of upper pixel
 @param bkcolor Background color
 */
 template <class T> void 
-VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight, const void *bkcolor = NULL) {
-	int iYPos;
+VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, unsigned first, unsigned last, const double *offsets, const void *bkcolor = NULL) {
+	int iOffset[VSKEW_BAND];
+	SkewWeight<T> left[VSKEW_BAND];
 
 	unsigned src_height = FreeImage_GetHeight(src);
 	unsigned dst_height = FreeImage_GetHeight(dst);
 
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
+	T pxlSrc[4], pxlLeft[4], pxlOldLeft[VSKEW_BAND][4];	// 4 = 4*sizeof(T) max
 
 	// background
 	const T pxlBlack[4] = {0, 0, 0, 0 };
@@ -206,85 +266,91 @@ VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight,
 
 	const unsigned src_pitch = FreeImage_GetPitch(src);
 	const unsigned dst_pitch = FreeImage_GetPitch(dst);
-	const unsigned index = col * bytespp;
 
-	BYTE *src_bits = FreeImage_GetBits(src) + index;
-	BYTE *dst_bits = FreeImage_GetBits(dst) + index;
+	for(unsigned col_start = first; col_start < last; col_start += VSKEW_BAND) {
+		const unsigned count = MIN(last - col_start, (unsigned)VSKEW_BAND);
+		const unsigned index = col_start * bytespp;
 
-	// fill gap above skew with background
-	if(bkcolor) {
-		for(int k = 0; k < iOffset; k++) {
-			memcpy(dst_bits, bkcolor, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memcpy(&pxlOldLeft[0], bkcolor, bytespp);
-	} else {
-		for(int k = 0; k < iOffset; k++) {
-			memset(dst_bits, 0, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memset(&pxlOldLeft[0], 0, bytespp);
-	}
+		BYTE *src_bits = FreeImage_GetBits(src) + index;
+		BYTE *dst_bits = FreeImage_GetBits(dst) + index;
 
-	for(unsigned i = 0; i < src_height; i++) {
-		// loop through column pixels
-		AssignPixel((BYTE*)(&pxlSrc[0]), src_bits, bytespp);
-		// calculate weights
-		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
+		int max_offset = 0;
+		for(unsigned c = 0; c < count; c++) {
+			iOffset[c] = int(floor(offsets[col_start + c]));
+			left[c].init(pxlBkg, samples, offsets[col_start + c] - double(iOffset[c]));
+			max_offset = MAX(max_offset, iOffset[c]);
+			AssignPixel((BYTE*)(&pxlOldLeft[c][0]), (const BYTE*)pxlBkg, bytespp);
 		}
-		// check boundaries
-		iYPos = i + iOffset;
-		if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-			// update left over on source
-			for(unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
+
+		// fill gap above skew with background
+		for(int k = 0; k < max_offset; k++) {
+			BYTE *dst_row = dst_bits + k * dst_pitch;
+			for(unsigned c = 0; c < count; c++) {
+				if(k < iOffset[c]) {
+					AssignPixel(dst_row + c * bytespp, (const BYTE*)pxlBkg, bytespp);
+				}
 			}
-			dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-			AssignPixel(dst_bits, (BYTE*)(&pxlSrc[0]), bytespp);
 		}
-		// save leftover for next pixel in scan
-		AssignPixel((BYTE*)(&pxlOldLeft[0]), (BYTE*)(&pxlLeft[0]), bytespp);
-
-		// next pixel in scan
-		src_bits += src_pitch;
-	}
-	// go to bottom point of skew
-	iYPos = src_height + iOffset;
 
-	if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-		dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
+		for(unsigned i = 0; i < src_height; i++) {
+			// loop through the pixels of the row
+			const BYTE *src_pixel = src_bits + i * src_pitch;
+			for(unsigned c = 0; c < count; c++, src_pixel += bytespp) {
+				AssignPixel((BYTE*)(&pxlSrc[0]), src_pixel, bytespp);
+				// calculate weights
+				for(unsigned j = 0; j < samples; j++) {
+					pxlLeft[j] = left[c].left(j, pxlSrc[j]);
+				}
+				// check boundaries
+				const int iYPos = i + iOffset[c];
+				if((iYPos >= 0) && (iYPos < (int)dst_height)) {
+					// update left over on source
+					for(unsigned j = 0; j < samples; j++) {
+						pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[c][j]);
+					}
+					AssignPixel(dst_bits + iYPos * dst_pitch + c * bytespp, (BYTE*)(&pxlSrc[0]), bytespp);
+				}
+				// save leftover for next pixel in scan
+				AssignPixel((BYTE*)(&pxlOldLeft[c][0]), (BYTE*)(&pxlLeft[0]), bytespp);
+			}
+		}
 
-		// if still in image bounds, put leftovers there				
-		AssignPixel((BYTE*)(dst_bits), (BYTE*)(&pxlOldLeft[0]), bytespp);
+		// go to bottom point of skew
+		int min_bottom = (int)dst_height;
+		for(unsigned c = 0; c < count; c++) {
+			const int iYPos = src_height + iOffset[c];
+			if((iYPos >= 0) && (iYPos < (int)dst_height)) {
+				// if still in image bounds, put leftovers there
+				AssignPixel(dst_bits + iYPos * dst_pitch + c * bytespp, (BYTE*)(&pxlOldLeft[c][0]), bytespp);
+				min_bottom = MIN(min_bottom, iYPos + 1);
+			}
+		}
 
 		// clear below skewed line with background
-		if(bkcolor) {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				AssignPixel((BYTE*)(dst_bits), (BYTE*)(bkcolor), bytespp);
-			}
-		} else {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				memset(dst_bits, 0, bytespp);
+		for(int k = min_bottom; k < (int)dst_height; k++) {
+			BYTE *dst_row = dst_bits + k * dst_pitch;
+			for(unsigned c = 0; c < count; c++) {
+				const int iYPos = src_height + iOffset[c];
+				if((iYPos >= 0) && (iYPos < k)) {
+					AssignPixel(dst_row + c * bytespp, (const BYTE*)pxlBkg, bytespp);
+				}
 			}
 		}
 	}
 }
 
 /**
-Skews a column vertically (with filtered weights). 
+Skews columns vertically (with filtered weights). 
 Limited to 45 degree skewing only. Filters two adjacent pixels.
 @param src Pointer to source image to rotate
 @param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
+@param first First column index
+@param last Last column index (excluded)
+@param offsets Skew offset of each column, the fractional part is the relative weight of upper pixel
 @param bkcolor Background color
 */
 static void 
-VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight, const void *bkcolor) {
+VerticalSkew(FIBITMAP *src, FIBITMAP *dst, unsigned first, unsigned last, const double *offsets, const void *bkcolor) {
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 
 	switch(image_type) {
@@ -293,23 +359,370 @@ VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight,
 				case 8:
 				case 24:
 				case 32:
-					VerticalSkewT<BYTE>(src, dst, col, iOffset, dWeight, bkcolor);
+					VerticalSkewT<BYTE>(src, dst, first, last, offsets, bkcolor);
 					break;
 			}
 			break;
 			case FIT_UINT16:
 			case FIT_RGB16:
 			case FIT_RGBA16:
-				VerticalSkewT<WORD>(src, dst, col, iOffset, dWeight, bkcolor);
+				VerticalSkewT<WORD>(src, dst, first, last, offsets, bkcolor);
 				break;
 			case FIT_FLOAT:
 			case FIT_RGBF:
 			case FIT_RGBAF:
-				VerticalSkewT<float>(src, dst, col, iOffset, dWeight, bkcolor);
+				VerticalSkewT<float>(src, dst, first, last, offsets, bkcolor);
 				break;
 	}
 } 
 
+/**
+Transposition of square blocks of pixels of N bytes. The generic version moves blocks of 4 x 4 pixels 
+one pixel at a time, the SSE2 versions move blocks of 8 x 8 8-bit pixels and of 4 x 4 32-bit pixels.
+*/
+template <unsigned N> struct TransposeKernel {
+	/// Width and height of the blocks
+	enum { SIZE = 4 };
+	/// Copies the block at src, transposed, to dst
+	static inline void transpose(const BYTE *src, int src_pitch, BYTE *dst, int dst_pitch) {
+		for(int i = 0; i < SIZE; i++) {
+			for(int j = 0; j < SIZE; j++) {
+				memcpy(dst + i * dst_pitch + j * N, src + j * src_pitch + i * N, N);
+			}
+		}
+	}
+	/// Exchanges the blocks at a and b, each one transposed (a and b may be the same block)
+	static inline void swap(BYTE *a, BYTE *b, int pitch) {
+		BYTE a_block[SIZE * SIZE * N], b_block[SIZE * SIZE * N];
+		transpose(a, pitch, a_block, SIZE * N);
+		transpose(b, pitch, b_block, SIZE * N);
+		for(int i = 0; i < SIZE; i++) {
+			memcpy(a + i * pitch, b_block + i * SIZE * N, SIZE * N);
+			memcpy(b + i * pitch, a_block + i * SIZE * N, SIZE * N);
+		}
+	}
+};
+
+#ifdef FI_HAS_SSE2
+
+template <> struct TransposeKernel<1> {
+	enum { SIZE = 8 };
+	/// Loads 8 rows of 8 pixels, returns the 8 columns, two per register
+	static inline void load(const BYTE *src, int pitch, __m128i *columns) {
+		const __m128i b0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)src), _mm_loadl_epi64((const __m128i*)(src + pitch)));
+		const __m128i b1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + 2 * pitch)), _mm_loadl_epi64((const __m128i*)(src + 3 * pitch)));
+		const __m128i b2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + 4 * pitch)), _mm_loadl_epi64((const __m128i*)(src + 5 * pitch)));
+		const __m128i b3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + 6 * pitch)), _mm_loadl_epi64((const __m128i*)(src + 7 * pitch)));
+		const __m128i c0 = _mm_unpacklo_epi16(b0, b1);
+		const __m128i c1 = _mm_unpackhi_epi16(b0, b1);
+		const __m128i c2 = _mm_unpacklo_epi16(b2, b3);
+		const __m128i c3 = _mm_unpackhi_epi16(b2, b3);
+		columns[0] = _mm_unpacklo_epi32(c0, c2);
+		columns[1] = _mm_unpackhi_epi32(c0, c2);
+		columns[2] = _mm_unpacklo_epi32(c1, c3);
+		columns[3] = _mm_unpackhi_epi32(c1, c3);
+	}
+	/// Stores the 8 columns returned by load as rows
+	static inline void store(const __m128i *columns, BYTE *dst, int pitch) {
+		for(int i = 0; i < 4; i++) {
+			_mm_storel_epi64((__m128i*)(dst + 2 * i * pitch), columns[i]);
+			_mm_storel_epi64((__m128i*)(dst + (2 * i + 1) * pitch), _mm_unpackhi_epi64(columns[i], columns[i]));
+		}
+	}
+	static inline void transpose(const BYTE *src, int src_pitch, BYTE *dst, int dst_pitch) {
+		__m128i columns[4];
+		load(src, src_pitch, columns);
+		store(columns, dst, dst_pitch);
+	}
+	static inline void swap(BYTE *a, BYTE *b, int pitch) {
+		__m128i a_columns[4], b_columns[4];
+		load(a, pitch, a_columns);
+		load(b, pitch, b_columns);
+		store(b_columns, a, pitch);
+		store(a_columns, b, pitch);
+	}
+};
+
+template <> struct TransposeKernel<4> {
+	enum { SIZE = 4 };
+	/// Returns the 4 columns of 4 rows of 4 pixels
+	static inline void columns(__m128i r0, __m128i r1, __m128i r2, __m128i r3, __m128i *columns) {
+		const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+		const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+		const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+		const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+		columns[0] = _mm_unpacklo_epi64(t0, t1);
+		columns[1] = _mm_unpackhi_epi64(t0, t1);
+		columns[2] = _mm_unpacklo_epi64(t2, t3);
+		columns[3] = _mm_unpackhi_epi64(t2, t3);
+	}
+	/// Loads 4 rows of 4 pixels, returns the 4 columns
+	static inline void load(const BYTE *src, int pitch, __m128i *columns) {
+		TransposeKernel<4>::columns(
+			_mm_loadu_si128((const __m128i*)src), 
+			_mm_loadu_si128((const __m128i*)(src + pitch)), 
+			_mm_loadu_si128((const __m128i*)(src + 2 * pitch)), 
+			_mm_loadu_si128((const __m128i*)(src + 3 * pitch)), 
+			columns);
+	}
+	/// Stores the 4 columns returned by load as rows
+	static inline void store(const __m128i *columns, BYTE *dst, int pitch) {
+		for(int i = 0; i < 4; i++) {
+			_mm_storeu_si128((__m128i*)(dst + i * pitch), columns[i]);
+		}
+	}
+	static inline void transpose(const BYTE *src, int src_pitch, BYTE *dst, int dst_pitch) {
+		__m128i columns[4];
+		load(src, src_pitch, columns);
+		store(columns, dst, dst_pitch);
+	}
+	static inline void swap(BYTE *a, BYTE *b, int pitch) {
+		__m128i a_columns[4], b_columns[4];
+		load(a, pitch, a_columns);
+		load(b, pitch, b_columns);
+		store(b_columns, a, pitch);
+		store(a_columns, b, pitch);
+	}
+};
+
+#endif // FI_HAS_SSE2
+
+#ifdef FI_HAS_SSSE3
+
+/**
+Transposition of blocks of 4 x 4 24-bit pixels with SSSE3: the rows are widened to 32-bit pixels 
+with pshufb, transposed as by TransposeKernel<4>, and narrowed back to 24-bit pixels. 
+The rows are read and written as 8 + 4 bytes, so that nothing past the block is touched.
+*/
+struct TransposeKernel24_SSSE3 {
+	enum { SIZE = 4 };
+	/// Loads a row of 4 pixels as 32-bit pixels
+	FI_TARGET_SSSE3 static inline __m128i loadRow(const BYTE *src) {
+		int tail;
+		memcpy(&tail, src + 8, 4);
+		const __m128i row = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)src), _mm_cvtsi32_si128(tail));
+		return _mm_shuffle_epi8(row, _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+	}
+	/// Stores 4 32-bit pixels as a row of 24-bit pixels
+	FI_TARGET_SSSE3 static inline void storeRow(__m128i pixels, BYTE *dst) {
+		const __m128i row = _mm_shuffle_epi8(pixels, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+		const int tail = _mm_cvtsi128_si32(_mm_srli_si128(row, 8));
+		_mm_storel_epi64((__m128i*)dst, row);
+		memcpy(dst + 8, &tail, 4);
+	}
+	/// Loads 4 rows of 4 pixels, returns the 4 columns
+	FI_TARGET_SSSE3 static inline void load(const BYTE *src, int pitch, __m128i *columns) {
+		TransposeKernel<4>::columns(loadRow(src), loadRow(src + pitch), loadRow(src + 2 * pitch), loadRow(src + 3 * pitch), columns);
+	}
+	/// Stores the 4 columns returned by load as rows
+	FI_TARGET_SSSE3 static inline void store(const __m128i *columns, BYTE *dst, int pitch) {
+		for(int i = 0; i < 4; i++) {
+			storeRow(columns[i], dst + i * pitch);
+		}
+	}
+	FI_TARGET_SSSE3 static inline void transpose(const BYTE *src, int src_pitch, BYTE *dst, int dst_pitch) {
+		__m128i columns[4];
+		load(src, src_pitch, columns);
+		store(columns, dst, dst_pitch);
+	}
+	FI_TARGET_SSSE3 static inline void swap(BYTE *a, BYTE *b, int pitch) {
+		__m128i a_columns[4], b_columns[4];
+		load(a, pitch, a_columns);
+		load(b, pitch, b_columns);
+		store(b_columns, a, pitch);
+		store(a_columns, b, pitch);
+	}
+};
+
+#endif // FI_HAS_SSSE3
+
+/**
+Transposes an image of N bytes per pixel: pixel x of source row y becomes pixel y of destination row x. 
+The image is walked in blocks of RBLOCK x RBLOCK pixels, cut into kernel blocks.
+Negative pitches walk the rows from the last one, which turns the transposition into a rotation.
+@param src First source row
+@param src_pitch Distance between the source rows in bytes
+@param dst First destination row
+@param dst_pitch Distance between the destination rows in bytes
+@param width Source width (destination height)
+@param height Source height (destination width)
+*/
+template <unsigned N, class Kernel = TransposeKernel<N> > static inline void 
+TransposeT(const BYTE *src, int src_pitch, BYTE *dst, int dst_pitch, unsigned width, unsigned height) {
+	const unsigned size = Kernel::SIZE;
+
+	for(unsigned xs = 0; xs < width; xs += RBLOCK) {
+		const unsigned x_end = MIN(width, xs + RBLOCK);
+		for(unsigned ys = 0; ys < height; ys += RBLOCK) {
+			const unsigned y_end = MIN(height, ys + RBLOCK);
+			for(unsigned x = xs; x < x_end; x += size) {
+				for(unsigned y = ys; y < y_end; y += size) {
+					const BYTE *src_bits = src + (ptrdiff_t)y * src_pitch + x * N;
+					BYTE *dst_bits = dst + (ptrdiff_t)x * dst_pitch + y * N;
+					if((x + size <= x_end) && (y + size <= y_end)) {
+						Kernel::transpose(src_bits, src_pitch, dst_bits, dst_pitch);
+					} else {
+						// partial block on the right or bottom edge
+						for(unsigned i = 0; i < MIN(size, x_end - x); i++) {
+							for(unsigned j = 0; j < MIN(size, y_end - y); j++) {
+								memcpy(dst_bits + (ptrdiff_t)i * dst_pitch + j * N, src_bits + (ptrdiff_t)j * src_pitch + i * N, N);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+Transposes a square image of N bytes per pixel in place, exchanging the blocks above the diagonal 
+with the blocks below it
+@param bits First row
+@param pitch Distance between the rows in bytes
+@param size Width and height of the image
+*/
+template <unsigned N, class Kernel = TransposeKernel<N> > static inline void 
+TransposeSquareT(BYTE *bits, int pitch, unsigned size) {
+	const unsigned block = Kernel::SIZE;
+
+	for(unsigned ys = 0; ys < size; ys += RBLOCK) {
+		const unsigned y_end = MIN(size, ys + RBLOCK);
+		for(unsigned xs = ys; xs < size; xs += RBLOCK) {
+			const unsigned x_end = MIN(size, xs + RBLOCK);
+			for(unsigned y = ys; y < y_end; y += block) {
+				for(unsigned x = MAX(xs, y); x < x_end; x += block) {
+					BYTE *a = bits + (ptrdiff_t)y * pitch + x * N;
+					BYTE *b = bits + (ptrdiff_t)x * pitch + y * N;
+					if((x + block <= size) && (y + block <= size)) {
+						Kernel::swap(a, b, pitch);
+					} else {
+						// partial block on the right or bottom edge
+						for(unsigned i = y; i < MIN(y + block, size); i++) {
+							for(unsigned j = MAX(x, i + 1); j < MIN(x + block, size); j++) {
+								BYTE tmp[N];
+								BYTE *p = bits + (ptrdiff_t)i * pitch + j * N;
+								BYTE *q = bits + (ptrdiff_t)j * pitch + i * N;
+								memcpy(tmp, p, N);
+								memcpy(p, q, N);
+								memcpy(q, tmp, N);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+#ifdef FI_HAS_SSSE3
+
+/**
+TransposeT for 24-bit pixels
+*/
+FI_TARGET_SSSE3 static void
+Transpose24_SSSE3(const BYTE *src, int src_pitch, BYTE *dst, int dst_pitch, unsigned width, unsigned height) {
+	TransposeT<3, TransposeKernel24_SSSE3>(src, src_pitch, dst, dst_pitch, width, height);
+}
+
+/**
+TransposeSquareT for 24-bit pixels
+*/
+FI_TARGET_SSSE3 static void
+TransposeSquare24_SSSE3(BYTE *bits, int pitch, unsigned size) {
+	TransposeSquareT<3, TransposeKernel24_SSSE3>(bits, pitch, size);
+}
+
+#endif // FI_HAS_SSSE3
+
+/**
+Transposes an image, see TransposeT
+@param bytespp Number of bytes per pixel
+@return Returns FALSE if the pixel size isn't supported
+*/
+static BOOL 
+Transpose(const BYTE *src, int src_pitch, BYTE *dst, int dst_pitch, unsigned width, unsigned height, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			TransposeT<1>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		case 2:
+			TransposeT<2>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		case 3:
+#ifdef FI_HAS_SSSE3
+			if(HasSSSE3()) {
+				Transpose24_SSSE3(src, src_pitch, dst, dst_pitch, width, height);
+				break;
+			}
+#endif
+			TransposeT<3>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		case 4:
+			TransposeT<4>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		case 6:
+			TransposeT<6>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		case 8:
+			TransposeT<8>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		case 12:
+			TransposeT<12>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		case 16:
+			TransposeT<16>(src, src_pitch, dst, dst_pitch, width, height);
+			break;
+		default:
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+Transposes a square image in place, see TransposeSquareT
+@param bytespp Number of bytes per pixel
+@return Returns FALSE if the pixel size isn't supported
+*/
+static BOOL 
+TransposeSquare(BYTE *bits, int pitch, unsigned size, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			TransposeSquareT<1>(bits, pitch, size);
+			break;
+		case 2:
+			TransposeSquareT<2>(bits, pitch, size);
+			break;
+		case 3:
+#ifdef FI_HAS_SSSE3
+			if(HasSSSE3()) {
+				TransposeSquare24_SSSE3(bits, pitch, size);
+				break;
+			}
+#endif
+			TransposeSquareT<3>(bits, pitch, size);
+			break;
+		case 4:
+			TransposeSquareT<4>(bits, pitch, size);
+			break;
+		case 6:
+			TransposeSquareT<6>(bits, pitch, size);
+			break;
+		case 8:
+			TransposeSquareT<8>(bits, pitch, size);
+			break;
+		case 12:
+			TransposeSquareT<12>(bits, pitch, size);
+			break;
+		case 16:
+			TransposeSquareT<16>(bits, pitch, size);
+			break;
+		default:
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
 Rotates an image by 90 degrees (counter clockwise). 
 Precise rotation, no filters required.<br>
@@ -368,41 +781,10 @@ Rotate90(FIBITMAP *src) {
 				}
 			}
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							BYTE *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							BYTE *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
+				// anything other than BW: dst row y is the source column dst_height - 1 - y, 
+				// so the image is transposed into the destination rows walked upwards
+				Transpose(FreeImage_GetBits(src), src_pitch, FreeImage_GetBits(dst) + (dst_height - 1) * dst_pitch, -(int)dst_pitch, 
+					src_width, src_height, bpp / 8);
 			}
 			break;
 		case FIT_UINT16:
@@ -411,24 +793,9 @@ Rotate90(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
-			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
-			}
-		}
-		break;
+			Transpose(FreeImage_GetBits(src), src_pitch, FreeImage_GetBits(dst) + (dst_height - 1) * dst_pitch, -(int)dst_pitch, 
+				src_width, src_height, FreeImage_GetLine(src) / src_width);
+			break;
 	}
 
 	return dst;
@@ -442,7 +809,7 @@ Precise rotation, no filters required.
 */
 static FIBITMAP* 
 Rotate180(FIBITMAP *src) {
-	int x, y, k, pos;
+	int y, k, pos;
 
 	const int bpp = FreeImage_GetBPP(src);
 
@@ -483,16 +850,9 @@ Rotate180(FIBITMAP *src) {
 			 // Calculate the number of bytes per pixel
 			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
+			// dst row dst_height - y - 1 is the source row y reversed
 			for(y = 0; y < src_height; y++) {
-				BYTE *src_bits = FreeImage_GetScanLine(src, y);
-				BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1) + (dst_width - 1) * bytespp;
-				for(x = 0; x < src_width; x++) {
-					// get pixel at (x, y)
-					// set pixel at (dst_width - x - 1, dst_height - y - 1)
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += bytespp;
-					dst_bits -= bytespp;					
-				}				
+				ReverseLine(FreeImage_GetScanLine(dst, dst_height - y - 1), FreeImage_GetScanLine(src, y), src_width, bytespp);
 			}
 		}
 		break;
@@ -510,7 +870,7 @@ Code adapted from CxImage (http://www.xdp.it/cximage.htm)
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
+	int dlineup;
 
 	const unsigned bpp = FreeImage_GetBPP(src);
 
@@ -560,41 +920,10 @@ Rotate270(FIBITMAP *src) {
 				}
 			} 
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							BYTE *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							BYTE *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
+				// anything other than BW: dst row y is the source column y read upwards, 
+				// so the source rows walked upwards are transposed into the destination
+				Transpose(FreeImage_GetBits(src) + (src_height - 1) * src_pitch, -(int)src_pitch, FreeImage_GetBits(dst), dst_pitch, 
+					src_width, src_height, bpp / 8);
 			}
 			break;
 		case FIT_UINT16:
@@ -603,24 +932,9 @@ Rotate270(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
-			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
-			}
-		}
-		break;
+			Transpose(FreeImage_GetBits(src) + (src_height - 1) * src_pitch, -(int)src_pitch, FreeImage_GetBits(dst), dst_pitch, 
+				src_width, src_height, FreeImage_GetLine(src) / src_width);
+			break;
 	}
 
 	return dst;
@@ -639,6 +953,9 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 
 	unsigned u;
 
+	// rows and columns are skewed independently of each other, in bands spread over the threads
+	const unsigned threads = GetRotateThreads();
+
 	const unsigned bpp = FreeImage_GetBPP(src);
 
 	const double dRadAngle = dAngle * ROTATE_PI / double(180); // Angle in radians
@@ -663,20 +980,22 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		return NULL;
 	}
 	
-	for(u = 0; u < height_1; u++) {  
-		double dShear;
+	FreeImage_ParallelFor(height_1, threads, 1 + FI_ROTATE_BAND_PIXELS / width_1, [&](unsigned first, unsigned last) {
+		for(unsigned u = first; u < last; u++) {  
+			double dShear;
 
-		if(dTan >= 0)	{
-			// Positive angle
-			dShear = (u + 0.5) * dTan;
-		}
-		else {
-			// Negative angle
-			dShear = (double(u) - height_1 + 0.5) * dTan;
+			if(dTan >= 0)	{
+				// Positive angle
+				dShear = (u + 0.5) * dTan;
+			}
+			else {
+				// Negative angle
+				dShear = (double(u) - height_1 + 0.5) * dTan;
+			}
+			int iShear = int(floor(dShear));
+			HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
 		}
-		int iShear = int(floor(dShear));
-		HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
-	}
+	});
 
 	// Perform 2nd shear  (vertical)
 	// ----------------------------------------------------------------------
@@ -692,6 +1011,14 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		return NULL;
 	}
 
+	// skew offsets of the columns of the 2nd shear, then of the rows of the 3rd shear
+	double *offsets = (double*)malloc(MAX(width_2, height_2) * sizeof(double));
+	if(NULL == offsets) {
+		FreeImage_Unload(dst1);
+		FreeImage_Unload(dst2);
+		return NULL;
+	}
+
 	double dOffset;     // Variable skew offset
 	if(dSinE > 0)	{   
 		// Positive angle
@@ -702,10 +1029,14 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = -dSinE * (double(src_width) - width_2);
 	}
 
+	// the offsets are accumulated column after column, before the columns are handed out to the threads
 	for(u = 0; u < width_2; u++, dOffset -= dSinE) {
-		int iShear = int(floor(dOffset));
-		VerticalSkew(dst1, dst2, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets[u] = dOffset;
 	}
+	const unsigned grain = ((FI_ROTATE_BAND_PIXELS / height_2) + VSKEW_BAND) & ~(VSKEW_BAND - 1);
+	FreeImage_ParallelFor(width_2, threads, grain, [&](unsigned first, unsigned last) {
+		VerticalSkew(dst1, dst2, first, last, offsets, bkcolor);
+	});
 
 	// Perform 3rd shear (horizontal)
 	// ----------------------------------------------------------------------
@@ -721,6 +1052,7 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	FIBITMAP *dst3 = FreeImage_AllocateT(image_type, width_3, height_3, bpp);
 	if(NULL == dst3) {
 		FreeImage_Unload(dst2);
+		free(offsets);
 		return NULL;
 	}
 
@@ -733,11 +1065,17 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = dTan * ( (src_width - 1.0) * -dSinE + (1.0 - height_3) );
 	}
 	for(u = 0; u < height_3; u++, dOffset += dTan) {
-		int iShear = int(floor(dOffset));
-		HorizontalSkew(dst2, dst3, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets[u] = dOffset;
 	}
+	FreeImage_ParallelFor(height_3, threads, 1 + FI_ROTATE_BAND_PIXELS / width_3, [&](unsigned first, unsigned last) {
+		for(unsigned u = first; u < last; u++) {
+			int iShear = int(floor(offsets[u]));
+			HorizontalSkew(dst2, dst3, u, iShear, offsets[u] - double(iShear), bkcolor);
+		}
+	});
 	// Free result of 2nd shear    
 	FreeImage_Unload(dst2);
+	free(offsets);
 
 	// Return result of 3rd shear
 	return dst3;      
@@ -823,6 +1161,21 @@ RotateAny(FIBITMAP *src, double dAngle, const void *bkcolor) {
 
 // ==========================================================
 
+unsigned
+GetRotateThreads() {
+	return s_rotate_threads.load();
+}
+
+/**
+Sets the number of threads used by FreeImage_Rotate for angles other than multiples of 90 degrees 
+and by FreeImage_RotateEx. The output doesn't depend on the number of threads.
+@param threads Number of threads, 0 or less selects the number of hardware threads. The default is 1.
+*/
+void DLL_CALLCONV
+FreeImage_SetRotateThreads(int threads) {
+	s_rotate_threads = (threads > 0) ? (unsigned)threads : FreeImage_GetHardwareThreads();
+}
+
 FIBITMAP *DLL_CALLCONV 
 FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor) {
 	if(!FreeImage_HasPixels(dib)) return NULL;
@@ -915,3 +1268,62 @@ FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor) {
 	return NULL;
 }
 
+/**
+Rotates an image by a multiple of 90 degrees (counter clockwise) without allocating a new image: 
+180 degrees for any image, 90 and 270 degrees for square images only. The result is the one of 
+FreeImage_Rotate. 
+@param dib Image to rotate, 8-, 24- or 32-bit bitmap or 16-bit / float image
+@param angle Rotation angle
+@return Returns FALSE, leaving the image unchanged, if the image or the angle isn't supported
+*/
+BOOL DLL_CALLCONV 
+FreeImage_RotateInPlace(FIBITMAP *dib, double angle) {
+	if(!FreeImage_HasPixels(dib)) return FALSE;
+
+	// only whole pixels of 8 bits or more are moved
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	switch(FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+			if((bpp != 8) && (bpp != 24) && (bpp != 32)) return FALSE;
+			break;
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			break;
+		default:
+			return FALSE;
+	}
+
+	// DIB are stored upside down ...
+	angle = fmod(-angle, 360);
+	if(angle < 0) {
+		angle += 360;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned pitch = FreeImage_GetPitch(dib);
+	const unsigned bytespp = FreeImage_GetLine(dib) / width;
+	BYTE *bits = FreeImage_GetBits(dib);
+
+	if(angle == 0) {
+		return TRUE;
+	}
+	if(angle == 180) {
+		// exchange the rows y and height - 1 - y, reversing both (the middle row with itself)
+		for(unsigned y = 0; y < (height + 1) / 2; y++) {
+			ReverseSwapLines(bits + y * pitch, bits + (height - 1 - y) * pitch, width, bytespp);
+		}
+		return TRUE;
+	}
+	if(((angle == 90) || (angle == 270)) && (width == height)) {
+		// a transposition followed by a flip: see Rotate90 and Rotate270
+		TransposeSquare(bits, pitch, width, bytespp);
+		return (angle == 90) ? FreeImage_FlipVertical(dib) : FreeImage_FlipHorizontal(dib);
+	}
+
+	return FALSE;
+}
@@ -629,6 +629,168 @@ FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double
 	return FALSE;
 }
 
+// ----------------------------------------------------------
+//   Color mapping
+// ----------------------------------------------------------
+
+/**
+Open addressing hash table of the colors of FreeImage_ApplyColorMapping, keyed 
+on the packed pixel value. A color mapped more than once keeps its first mapping, 
+as when the colors were searched in order.
+*/
+class ColorMappingTable {
+public:
+	ColorMappingTable() : m_keys(NULL), m_values(NULL), m_used(NULL), m_mask(0), m_shift(32) {
+	}
+	~ColorMappingTable() {
+		free(m_keys);
+		free(m_values);
+		free(m_used);
+	}
+	/**
+	Allocates room for up to 'entries' colors, with at most half of the slots used
+	*/
+	BOOL init(unsigned entries) {
+		unsigned size = 16;
+		m_shift = 28;
+		while(size < 2 * entries) {
+			size *= 2;
+			m_shift--;
+		}
+		m_mask = size - 1;
+		m_keys = (DWORD*)malloc(size * sizeof(DWORD));
+		m_values = (DWORD*)malloc(size * sizeof(DWORD));
+		m_used = (BYTE*)calloc(size, sizeof(BYTE));
+		return m_keys && m_values && m_used;
+	}
+	void add(DWORD key, DWORD value) {
+		unsigned slot = hash(key);
+		while(m_used[slot]) {
+			if(m_keys[slot] == key) {
+				return;
+			}
+			slot = (slot + 1) & m_mask;
+		}
+		m_used[slot] = 1;
+		m_keys[slot] = key;
+		m_values[slot] = value;
+	}
+	BOOL find(DWORD key, DWORD *value) const {
+		for(unsigned slot = hash(key); m_used[slot]; slot = (slot + 1) & m_mask) {
+			if(m_keys[slot] == key) {
+				*value = m_values[slot];
+				return TRUE;
+			}
+		}
+		return FALSE;
+	}
+
+private:
+	unsigned hash(DWORD key) const {
+		// Fibonacci hashing: the high bits of the product depend on all the bits of the key
+		return (unsigned)((key * 0x9E3779B1U) >> m_shift);
+	}
+
+	DWORD *m_keys;
+	DWORD *m_values;
+	BYTE *m_used;
+	unsigned m_mask;
+	unsigned m_shift;
+};
+
+/**
+Packs a color into the value of a 24- or 32-bit pixel, as it is laid out in memory
+*/
+static inline DWORD
+PackColor(const RGBQUAD *color, BOOL alpha) {
+	BYTE bytes[4];
+	bytes[FI_RGBA_BLUE] = color->rgbBlue;
+	bytes[FI_RGBA_GREEN] = color->rgbGreen;
+	bytes[FI_RGBA_RED] = color->rgbRed;
+	bytes[FI_RGBA_ALPHA] = alpha ? color->rgbReserved : 0;
+	DWORD value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+/**
+Fills a ColorMappingTable with the mappings of FreeImage_ApplyColorMapping, 
+in the order the linear search checked them
+*/
+static BOOL
+InitColorMappingTable(ColorMappingTable &table, FIBITMAP *dib, RGBQUAD *srccolors, RGBQUAD *dstcolors, unsigned count, BOOL alpha, BOOL swap) {
+	if(!table.init(swap ? 2 * count : count)) {
+		return FALSE;
+	}
+	const BOOL rgb16 = (FreeImage_GetBPP(dib) == 16);
+	for(unsigned j = 0; j < count; j++) {
+		const DWORD src = rgb16 ? RGBQUAD_TO_WORD(dib, (srccolors + j)) : PackColor(srccolors + j, alpha);
+		const DWORD dst = rgb16 ? RGBQUAD_TO_WORD(dib, (dstcolors + j)) : PackColor(dstcolors + j, alpha);
+		table.add(src, dst);
+		if(swap) {
+			table.add(dst, src);
+		}
+	}
+	return TRUE;
+}
+
+/**
+Maps the colors of a line of 32-bit pixels, returns the number of pixels changed. 
+Only the bits of key_mask are compared and replaced, the others are kept. 
+Runs of pixels repeat the last color looked up, blocks of 4 are then 
+skipped or replaced at once.
+*/
+static unsigned
+ApplyColorMappingLine32(BYTE *bits, unsigned width, const ColorMappingTable &table, DWORD key_mask) {
+	unsigned result = 0;
+	unsigned x = 0;
+	DWORD *pixels = (DWORD*)bits;
+	DWORD last_key = ~(pixels[0] & key_mask);
+	DWORD last_value = 0;
+	BOOL last_found = FALSE;
+
+#ifdef FI_HAS_SSE2
+	const __m128i mask = _mm_set1_epi32((int)key_mask);
+	for(; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(pixels + x));
+		const __m128i same = _mm_cmpeq_epi32(_mm_and_si128(v, mask), _mm_set1_epi32((int)last_key));
+		if(_mm_movemask_epi8(same) == 0xFFFF) {
+			if(last_found) {
+				_mm_storeu_si128((__m128i*)(pixels + x), _mm_or_si128(_mm_andnot_si128(mask, v), _mm_set1_epi32((int)last_value)));
+				result += 4;
+			}
+			continue;
+		}
+		for(unsigned i = x; i < x + 4; i++) {
+			const DWORD key = pixels[i] & key_mask;
+			if(key != last_key) {
+				last_key = key;
+				last_found = table.find(key, &last_value);
+				last_value &= key_mask;
+			}
+			if(last_found) {
+				pixels[i] = (pixels[i] & ~key_mask) | last_value;
+				result++;
+			}
+		}
+	}
+#endif
+
+	for(; x < width; x++) {
+		const DWORD key = pixels[x] & key_mask;
+		if(key != last_key) {
+			last_key = key;
+			last_found = table.find(key, &last_value);
+			last_value &= key_mask;
+		}
+		if(last_found) {
+			pixels[x] = (pixels[x] & ~key_mask) | last_value;
+			result++;
+		}
+	}
+	return result;
+}
+
 /** @brief Applies color mapping for one or several colors on a 1-, 4- or 8-bit
  palletized or a 16-, 24- or 32-bit high color image.
 
@@ -704,101 +866,42 @@ FreeImage_ApplyColorMapping(FIBITMAP *dib, RGBQUAD *srccolors, RGBQUAD *dstcolor
 			}
 			return result;
 		}
-		case 16: {
-			WORD *src16 = (WORD *)malloc(sizeof(WORD) * count);
-			if (NULL == src16) {
-				return 0;
-			}
-
-			WORD *dst16 = (WORD *)malloc(sizeof(WORD) * count);
-			if (NULL == dst16) {
-				free(src16);
+		case 16:
+		case 24:
+		case 32: {
+			// one hash lookup per pixel, whatever the number of colors
+			ColorMappingTable table;
+			if(!InitColorMappingTable(table, dib, srccolors, dstcolors, count, (bpp == 32) && !ignore_alpha, swap)) {
 				return 0;
 			}
 
-			for (unsigned j = 0; j < count; j++) {
-				src16[j] = RGBQUAD_TO_WORD(dib, (srccolors + j));
-				dst16[j] = RGBQUAD_TO_WORD(dib, (dstcolors + j));
-			}
+			// the 32-bit pixel bits compared and replaced
+			RGBQUAD white;
+			memset(&white, 0xFF, sizeof(white));
+			const DWORD key_mask = PackColor(&white, !ignore_alpha);
 
 			unsigned height = FreeImage_GetHeight(dib);
 			unsigned width = FreeImage_GetWidth(dib);
-			WORD *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				WORD *bits = (WORD *)FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits++) {
-					for (unsigned j = 0; j < count; j++) {
-						a = src16;
-						b = dst16;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if (*bits == a[j]) {
-								*bits = b[j];
-								result++;
-								j = count;
-								break;
-							}
-							a = dst16;
-							b = src16;
-						}
-					}
-				}
-			}
-			free(src16);
-			free(dst16);
-			return result;
-		}
-		case 24: {
-			unsigned height = FreeImage_GetHeight(dib);
-			unsigned width = FreeImage_GetWidth(dib);
-			RGBQUAD *a, *b;
+			DWORD key = 0, value;
 			for (unsigned y = 0; y < height; y++) {
 				BYTE *bits = FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits += 3) {
-					for (unsigned j = 0; j < count; j++) {
-						a = srccolors;
-						b = dstcolors;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if ((bits[FI_RGBA_BLUE] == a[j].rgbBlue) && (bits[FI_RGBA_GREEN] == a[j].rgbGreen) &&(bits[FI_RGBA_RED] == a[j].rgbRed)) {
-								bits[FI_RGBA_BLUE] = b[j].rgbBlue;
-								bits[FI_RGBA_GREEN] = b[j].rgbGreen;
-								bits[FI_RGBA_RED] = b[j].rgbRed;
-								result++;
-								j = count;
-								break;
-							}
-							a = dstcolors;
-							b = srccolors;
+				if (bpp == 32) {
+					result += ApplyColorMappingLine32(bits, width, table, key_mask);
+				} else if (bpp == 24) {
+					for (unsigned x = 0; x < width; x++, bits += 3) {
+						// the alpha byte of the key stays 0, as in PackColor
+						memcpy(&key, bits, 3);
+						if (table.find(key, &value)) {
+							memcpy(bits, &value, 3);
+							result++;
 						}
 					}
-				}
-			}
-			return result;
-		}
-		case 32: {
-			unsigned height = FreeImage_GetHeight(dib);
-			unsigned width = FreeImage_GetWidth(dib);
-			RGBQUAD *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				BYTE *bits = FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits += 4) {
-					for (unsigned j = 0; j < count; j++) {
-						a = srccolors;
-						b = dstcolors;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if ((bits[FI_RGBA_BLUE] == a[j].rgbBlue) &&(bits[FI_RGBA_GREEN] == a[j].rgbGreen) &&(bits[FI_RGBA_RED] == a[j].rgbRed)
-								&&((ignore_alpha) || (bits[FI_RGBA_ALPHA] == a[j].rgbReserved))) {
-								bits[FI_RGBA_BLUE] = b[j].rgbBlue;
-								bits[FI_RGBA_GREEN] = b[j].rgbGreen;
-								bits[FI_RGBA_RED] = b[j].rgbRed;
-								if (!ignore_alpha) {
-									bits[FI_RGBA_ALPHA] = b[j].rgbReserved;
-								}
-								result++;
-								j = count;
-								break;
-							}
-							a = dstcolors;
-							b = srccolors;
+				} else {
+					WORD *bits16 = (WORD *)bits;
+					for (unsigned x = 0; x < width; x++, bits16++) {
+						if (table.find(*bits16, &value)) {
+							*bits16 = (WORD)value;
+							result++;
 						}
 					}
 				}
@@ -21,7 +21,10 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
+/// Minimum number of pixels of the bands of rows blended by a thread
+#define FI_BLEND_BAND_PIXELS	65536
 
 /**
 @brief Composite a foreground image against a background color or a background image.
@@ -184,6 +187,442 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 	return composite;	
 }
 
+// --------------------------------------------------------------------------
+// Blending of 32-bit images
+// --------------------------------------------------------------------------
+
+/**
+Rounded division by 255 of values up to 255 * 255
+*/
+static inline unsigned
+Div255(unsigned x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+/**
+Blends a src pixel over a dst pixel, see FREE_IMAGE_BLEND_MODE. 
+The SIMD kernels compute the same values.
+*/
+static inline void
+BlendPixel(BYTE *dst, const BYTE *src, FREE_IMAGE_BLEND_MODE mode) {
+	const unsigned sa = src[FI_RGBA_ALPHA];
+	const unsigned da = dst[FI_RGBA_ALPHA];
+	// dst alpha weighted by what src lets through
+	const unsigned t = da * (255 - sa);
+
+	switch(mode) {
+		case FIBLEND_OVER:
+		{
+			// colors weighted by their alpha, divided by the alpha of the result
+			const unsigned weight = sa * 255 + t;
+			if(weight == 0) {
+				return;
+			}
+			for(int c = 0; c < 3; c++) {
+				dst[c] = (BYTE)((float)(src[c] * sa * 255 + dst[c] * t) / (float)weight + 0.5F);
+			}
+			break;
+		}
+		case FIBLEND_PREMULTIPLIED_OVER:
+			for(int c = 0; c < 3; c++) {
+				dst[c] = (BYTE)MIN(src[c] + Div255(dst[c] * (255 - sa)), 255U);
+			}
+			break;
+		case FIBLEND_ADD:
+			for(int c = 0; c < 3; c++) {
+				dst[c] = (BYTE)MIN(dst[c] + Div255(src[c] * sa), 255U);
+			}
+			break;
+		case FIBLEND_MULTIPLY:
+			for(int c = 0; c < 3; c++) {
+				dst[c] = (BYTE)Div255(dst[c] * (255 - sa + Div255(src[c] * sa)));
+			}
+			break;
+	}
+	dst[FI_RGBA_ALPHA] = (BYTE)(sa + Div255(t));
+}
+
+#ifdef FI_HAS_SSE2
+
+/**
+Div255 of 16-bit lanes
+*/
+static inline __m128i
+Div255_SSE2(__m128i x) {
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/**
+Blends 2 pixels unpacked to 16-bit lanes, in any mode but FIBLEND_OVER
+*/
+template <int MODE> static inline __m128i
+Blend16_SSE2(__m128i s, __m128i d) {
+	const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+	// src alpha in the 4 lanes of each pixel
+	const __m128i sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), sa);
+	const __m128i through = Div255_SSE2(_mm_mullo_epi16(d, inv));
+	if(MODE == FIBLEND_PREMULTIPLIED_OVER) {
+		// the alpha lanes follow the same equation
+		return _mm_add_epi16(s, through);
+	}
+	const __m128i weighted = Div255_SSE2(_mm_mullo_epi16(s, sa));
+	const __m128i c = (MODE == FIBLEND_ADD) ? _mm_add_epi16(d, weighted) : Div255_SSE2(_mm_mullo_epi16(d, _mm_add_epi16(inv, weighted)));
+	const __m128i a = _mm_add_epi16(sa, through);
+	return _mm_or_si128(_mm_and_si128(alpha_lanes, a), _mm_andnot_si128(alpha_lanes, c));
+}
+
+/**
+Div255 of 32-bit lanes
+*/
+static inline __m128i
+Div255x32_SSE2(__m128i x) {
+	x = _mm_add_epi32(x, _mm_set1_epi32(128));
+	return _mm_srli_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 8)), 8);
+}
+
+/**
+Blends 4 pixels in FIBLEND_OVER mode, one pixel per 32-bit lane. 
+The products are integers below 2^24, exact in single precision as in BlendPixel.
+*/
+static inline __m128i
+BlendOver_SSE2(__m128i s, __m128i d) {
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128 c255 = _mm_set1_ps(255.0F);
+	const __m128i sa_i = _mm_srli_epi32(s, 24);
+	const __m128 sa = _mm_cvtepi32_ps(sa_i);
+	const __m128 da = _mm_cvtepi32_ps(_mm_srli_epi32(d, 24));
+	const __m128 t = _mm_mul_ps(da, _mm_sub_ps(c255, sa));
+	const __m128 src_weight = _mm_mul_ps(sa, c255);
+	const __m128 weight = _mm_add_ps(src_weight, t);
+
+	__m128i result = _mm_slli_epi32(_mm_add_epi32(sa_i, Div255x32_SSE2(_mm_cvttps_epi32(t))), 24);
+	for(int c = 0; c < 3; c++) {
+		const __m128 sc = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(s, 8 * c), mask));
+		const __m128 dc = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(d, 8 * c), mask));
+		const __m128 q = _mm_div_ps(_mm_add_ps(_mm_mul_ps(sc, src_weight), _mm_mul_ps(dc, t)), weight);
+		result = _mm_or_si128(result, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(q, _mm_set1_ps(0.5F))), 8 * c));
+	}
+	// both pixels transparent: dst is left as it is
+	const __m128i empty = _mm_castps_si128(_mm_cmpeq_ps(weight, _mm_setzero_ps()));
+	return _mm_or_si128(_mm_and_si128(empty, d), _mm_andnot_si128(empty, result));
+}
+
+/**
+Blends a line of 32-bit pixels by blocks of 4, returns the number of pixels blended
+*/
+template <int MODE> static unsigned
+BlendLineT_SSE2(BYTE *dst, const BYTE *src, unsigned width) {
+	const __m128i zero = _mm_setzero_si128();
+	unsigned x = 0;
+	for(; x + 4 <= width; x += 4) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + x * 4));
+		const __m128i d = _mm_loadu_si128((const __m128i*)(dst + x * 4));
+		__m128i result;
+		if(MODE == FIBLEND_OVER) {
+			result = BlendOver_SSE2(s, d);
+		} else {
+			const __m128i lo = Blend16_SSE2<MODE>(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+			const __m128i hi = Blend16_SSE2<MODE>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+			result = _mm_packus_epi16(lo, hi);
+		}
+		_mm_storeu_si128((__m128i*)(dst + x * 4), result);
+	}
+	return x;
+}
+
+#ifdef FI_HAS_AVX2
+
+/**
+Div255_SSE2 on 16 lanes
+*/
+FI_TARGET_AVX2 static inline __m256i
+Div255_AVX2(__m256i x) {
+	x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+/**
+Blend16_SSE2 on 4 pixels
+*/
+template <int MODE> FI_TARGET_AVX2 static inline __m256i
+Blend16_AVX2(__m256i s, __m256i d) {
+	const __m256i alpha_lanes = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+	const __m256i sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	const __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(255), sa);
+	const __m256i through = Div255_AVX2(_mm256_mullo_epi16(d, inv));
+	if(MODE == FIBLEND_PREMULTIPLIED_OVER) {
+		return _mm256_add_epi16(s, through);
+	}
+	const __m256i weighted = Div255_AVX2(_mm256_mullo_epi16(s, sa));
+	const __m256i c = (MODE == FIBLEND_ADD) ? _mm256_add_epi16(d, weighted) : Div255_AVX2(_mm256_mullo_epi16(d, _mm256_add_epi16(inv, weighted)));
+	const __m256i a = _mm256_add_epi16(sa, through);
+	return _mm256_blendv_epi8(c, a, alpha_lanes);
+}
+
+/**
+BlendOver_SSE2 on 8 pixels
+*/
+FI_TARGET_AVX2 static inline __m256i
+BlendOver_AVX2(__m256i s, __m256i d) {
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256 c255 = _mm256_set1_ps(255.0F);
+	const __m256i sa_i = _mm256_srli_epi32(s, 24);
+	const __m256 sa = _mm256_cvtepi32_ps(sa_i);
+	const __m256 da = _mm256_cvtepi32_ps(_mm256_srli_epi32(d, 24));
+	const __m256 t = _mm256_mul_ps(da, _mm256_sub_ps(c255, sa));
+	const __m256 src_weight = _mm256_mul_ps(sa, c255);
+	const __m256 weight = _mm256_add_ps(src_weight, t);
+
+	__m256i alpha = _mm256_add_epi32(_mm256_cvttps_epi32(t), _mm256_set1_epi32(128));
+	alpha = _mm256_add_epi32(sa_i, _mm256_srli_epi32(_mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 8)), 8));
+	__m256i result = _mm256_slli_epi32(alpha, 24);
+	for(int c = 0; c < 3; c++) {
+		const __m256 sc = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(s, 8 * c), mask));
+		const __m256 dc = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(d, 8 * c), mask));
+		const __m256 q = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(sc, src_weight), _mm256_mul_ps(dc, t)), weight);
+		result = _mm256_or_si256(result, _mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_add_ps(q, _mm256_set1_ps(0.5F))), 8 * c));
+	}
+	const __m256i empty = _mm256_castps_si256(_mm256_cmp_ps(weight, _mm256_setzero_ps(), _CMP_EQ_OQ));
+	return _mm256_blendv_epi8(result, d, empty);
+}
+
+/**
+BlendLineT_SSE2 by blocks of 8 pixels
+*/
+template <int MODE> FI_TARGET_AVX2 static unsigned
+BlendLineT_AVX2(BYTE *dst, const BYTE *src, unsigned width) {
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned x = 0;
+	for(; x + 8 <= width; x += 8) {
+		const __m256i s = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+		const __m256i d = _mm256_loadu_si256((const __m256i*)(dst + x * 4));
+		__m256i result;
+		if(MODE == FIBLEND_OVER) {
+			result = BlendOver_AVX2(s, d);
+		} else {
+			// unpack and pack work within 128-bit lanes, so the pixels keep their order
+			const __m256i lo = Blend16_AVX2<MODE>(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+			const __m256i hi = Blend16_AVX2<MODE>(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+			result = _mm256_packus_epi16(lo, hi);
+		}
+		_mm256_storeu_si256((__m256i*)(dst + x * 4), result);
+	}
+	return x;
+}
+
+#endif // FI_HAS_AVX2
+
+#endif // FI_HAS_SSE2
+
+/**
+Blends a line of 32-bit pixels with the fastest kernel the processor supports and FreeImage_SetSIMDLevel allows
+*/
+template <int MODE> static void
+BlendLineT(BYTE *dst, const BYTE *src, unsigned width) {
+	unsigned x = 0;
+#ifdef FI_HAS_SSE2
+#ifdef FI_HAS_AVX2
+	if(HasAVX2()) {
+		x = BlendLineT_AVX2<MODE>(dst, src, width);
+	}
+#endif
+	if(HasSSE2()) {
+		x += BlendLineT_SSE2<MODE>(dst + x * 4, src + x * 4, width - x);
+	}
+#endif
+	for(; x < width; x++) {
+		BlendPixel(dst + x * 4, src + x * 4, (FREE_IMAGE_BLEND_MODE)MODE);
+	}
+}
+
+/**
+Blends src over dst, see FREE_IMAGE_BLEND_MODE. 
+The area of src outside of dst is ignored, src and dst must be different images.
+@param dst 32-bit destination image
+@param src 32-bit source image
+@param left Position of the left side of src in dst
+@param top Position of the top side of src in dst
+@param mode Blend mode
+@param flags FI_BLEND_THREADS(n) to blend bands of rows on up to n threads
+@return Returns TRUE if successful (including when src and dst don't overlap), FALSE otherwise
+*/
+BOOL DLL_CALLCONV
+FreeImage_Blend(FIBITMAP *dst, FIBITMAP *src, int left, int top, FREE_IMAGE_BLEND_MODE mode, unsigned flags) {
+	if(!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst) || (src == dst)) {
+		return FALSE;
+	}
+	if((FreeImage_GetImageType(src) != FIT_BITMAP) || (FreeImage_GetImageType(dst) != FIT_BITMAP)
+		|| (FreeImage_GetBPP(src) != 32) || (FreeImage_GetBPP(dst) != 32)) {
+		return FALSE;
+	}
+
+	void (*blend_line)(BYTE*, const BYTE*, unsigned) = NULL;
+	switch(mode) {
+		case FIBLEND_OVER:
+			blend_line = BlendLineT<FIBLEND_OVER>;
+			break;
+		case FIBLEND_PREMULTIPLIED_OVER:
+			blend_line = BlendLineT<FIBLEND_PREMULTIPLIED_OVER>;
+			break;
+		case FIBLEND_ADD:
+			blend_line = BlendLineT<FIBLEND_ADD>;
+			break;
+		case FIBLEND_MULTIPLY:
+			blend_line = BlendLineT<FIBLEND_MULTIPLY>;
+			break;
+		default:
+			return FALSE;
+	}
+
+	// clip src to dst, in top-down coordinates
+
+	const int src_width = (int)FreeImage_GetWidth(src);
+	const int src_height = (int)FreeImage_GetHeight(src);
+	const int dst_width = (int)FreeImage_GetWidth(dst);
+	const int dst_height = (int)FreeImage_GetHeight(dst);
+
+	const int x0 = MAX(left, 0);
+	const int y0 = MAX(top, 0);
+	const int x1 = (int)MIN((INT64)left + src_width, (INT64)dst_width);
+	const int y1 = (int)MIN((INT64)top + src_height, (INT64)dst_height);
+	if((x0 >= x1) || (y0 >= y1)) {
+		return TRUE;
+	}
+
+	const unsigned width = (unsigned)(x1 - x0);
+	const unsigned rows = (unsigned)(y1 - y0);
+	unsigned threads = (flags >> 8) & 0xFF;
+	if(threads == 0) {
+		threads = 1;
+	}
+	const unsigned grain = MAX(FI_BLEND_BAND_PIXELS / width, 1U);
+
+	FreeImage_ParallelFor(rows, threads, grain, [&](unsigned first, unsigned last) {
+		for(unsigned y = first; y < last; y++) {
+			const int dst_y = y0 + (int)y;
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - 1 - dst_y) + x0 * 4;
+			const BYTE *src_bits = FreeImage_GetScanLine(src, src_height - 1 - (dst_y - top)) + (x0 - left) * 4;
+			blend_line(dst_bits, src_bits, width);
+		}
+	});
+
+	return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// Premultiplied alpha
+// --------------------------------------------------------------------------
+
+#ifdef FI_HAS_SSE2
+
+/**
+Premultiplies a line of 32-bit pixels by blocks of 4, returns the number of pixels done
+*/
+static unsigned
+PreMultiplyLine_SSE2(BYTE *bits, unsigned width) {
+	const __m128i zero = _mm_setzero_si128();
+	// the alpha lanes are multiplied by 255, which leaves them as they are
+	const __m128i alpha_one = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+	unsigned x = 0;
+	for(; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(bits + x * 4));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		const __m128i a_lo = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)), alpha_one);
+		const __m128i a_hi = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)), alpha_one);
+		lo = Div255_SSE2(_mm_mullo_epi16(lo, a_lo));
+		hi = Div255_SSE2(_mm_mullo_epi16(hi, a_hi));
+		_mm_storeu_si128((__m128i*)(bits + x * 4), _mm_packus_epi16(lo, hi));
+	}
+	return x;
+}
+
+/**
+Divides the colors of 4 pixels, one per 32-bit lane, by their alpha. 
+rcp holds the reciprocals of the alpha values, scaled by 255.
+*/
+static inline __m128i
+UnPreMultiply_SSE2(__m128i v, __m128 rcp) {
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128 half = _mm_set1_ps(0.5F);
+	const __m128 c255 = _mm_set1_ps(255.0F);
+	__m128i result = _mm_andnot_si128(_mm_set1_epi32(0x00FFFFFF), v);
+	for(int c = 0; c < 3; c++) {
+		const __m128 color = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8 * c), mask));
+		const __m128 q = _mm_min_ps(_mm_add_ps(_mm_mul_ps(color, rcp), half), c255);
+		result = _mm_or_si128(result, _mm_slli_epi32(_mm_cvttps_epi32(q), 8 * c));
+	}
+	return result;
+}
+
+/**
+Unpremultiplies a line of 32-bit pixels by blocks of 4, returns the number of pixels done
+*/
+static unsigned
+UnPreMultiplyLine_SSE2(BYTE *bits, unsigned width, const float *rcp) {
+	unsigned x = 0;
+	for(; x + 4 <= width; x += 4) {
+		const BYTE *p = bits + x * 4 + FI_RGBA_ALPHA;
+		const __m128 r = _mm_setr_ps(rcp[p[0]], rcp[p[4]], rcp[p[8]], rcp[p[12]]);
+		const __m128i v = _mm_loadu_si128((const __m128i*)(bits + x * 4));
+		_mm_storeu_si128((__m128i*)(bits + x * 4), UnPreMultiply_SSE2(v, r));
+	}
+	return x;
+}
+
+#ifdef FI_HAS_AVX2
+
+/**
+PreMultiplyLine_SSE2 by blocks of 8 pixels
+*/
+FI_TARGET_AVX2 static unsigned
+PreMultiplyLine_AVX2(BYTE *bits, unsigned width) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alpha_one = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+	unsigned x = 0;
+	for(; x + 8 <= width; x += 8) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(bits + x * 4));
+		__m256i lo = _mm256_unpacklo_epi8(v, zero);
+		__m256i hi = _mm256_unpackhi_epi8(v, zero);
+		const __m256i a_lo = _mm256_or_si256(_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)), alpha_one);
+		const __m256i a_hi = _mm256_or_si256(_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)), alpha_one);
+		lo = Div255_AVX2(_mm256_mullo_epi16(lo, a_lo));
+		hi = Div255_AVX2(_mm256_mullo_epi16(hi, a_hi));
+		_mm256_storeu_si256((__m256i*)(bits + x * 4), _mm256_packus_epi16(lo, hi));
+	}
+	return x;
+}
+
+/**
+UnPreMultiplyLine_SSE2 by blocks of 8 pixels, gathering the reciprocals
+*/
+FI_TARGET_AVX2 static unsigned
+UnPreMultiplyLine_AVX2(BYTE *bits, unsigned width, const float *rcp) {
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256 half = _mm256_set1_ps(0.5F);
+	const __m256 c255 = _mm256_set1_ps(255.0F);
+	unsigned x = 0;
+	for(; x + 8 <= width; x += 8) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(bits + x * 4));
+		const __m256 r = _mm256_i32gather_ps(rcp, _mm256_srli_epi32(v, 24), 4);
+		__m256i result = _mm256_andnot_si256(_mm256_set1_epi32(0x00FFFFFF), v);
+		for(int c = 0; c < 3; c++) {
+			const __m256 color = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 8 * c), mask));
+			const __m256 q = _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(color, r), half), c255);
+			result = _mm256_or_si256(result, _mm256_slli_epi32(_mm256_cvttps_epi32(q), 8 * c));
+		}
+		_mm256_storeu_si256((__m256i*)(bits + x * 4), result);
+	}
+	return x;
+}
+
+#endif // FI_HAS_AVX2
+
+#endif // FI_HAS_SSE2
+
 /**
 Pre-multiplies a 32-bit image's red-, green- and blue channels with it's alpha channel 
 for to be used with e.g. the Windows GDI function AlphaBlend(). 
@@ -203,9 +642,27 @@ FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
 	int width = FreeImage_GetWidth(dib);
 	int height = FreeImage_GetHeight(dib);
 
+#ifdef FI_HAS_SSE2
+	const BOOL has_sse2 = HasSSE2();
+	const BOOL has_avx2 = HasAVX2();
+#endif
+
 	for(int y = 0; y < height; y++) {
 		BYTE *bits = FreeImage_GetScanLine(dib, y);
-		for (int x = 0; x < width; x++, bits += 4) {
+		int x = 0;
+#ifdef FI_HAS_SSE2
+		// the SIMD kernels compute (alpha * color + 127) / 255 as well
+#ifdef FI_HAS_AVX2
+		if(has_avx2) {
+			x = (int)PreMultiplyLine_AVX2(bits, width);
+		}
+#endif
+		if(has_sse2) {
+			x += (int)PreMultiplyLine_SSE2(bits + x * 4, width - x);
+		}
+		bits += x * 4;
+#endif
+		for (; x < width; x++, bits += 4) {
 			const BYTE alpha = bits[FI_RGBA_ALPHA];
 			// slightly faster: care for two special cases
 			if(alpha == 0x00) {
@@ -228,3 +685,57 @@ FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
 	return TRUE;
 }
 
+/**
+Reverts FreeImage_PreMultiplyWithAlpha, as far as the rounding allows. 
+The red-, green- and blue channels are changed according to the following equation, 
+using a table of the reciprocals of the alpha values:  
+channel(x, y) = min(channel(x, y) * 255 / alpha_channel(x, y), 255)  
+Fully transparent pixels are left black.
+@param dib Input/Output premultiplied dib
+@return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
+*/
+BOOL DLL_CALLCONV 
+FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib) {
+	if (!FreeImage_HasPixels(dib)) return FALSE;
+	
+	if ((FreeImage_GetBPP(dib) != 32) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+		return FALSE;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	float rcp[256];
+	rcp[0] = 0;
+	for(int alpha = 1; alpha < 256; alpha++) {
+		rcp[alpha] = 255.0F / (float)alpha;
+	}
+
+#ifdef FI_HAS_SSE2
+	const BOOL has_sse2 = HasSSE2();
+	const BOOL has_avx2 = HasAVX2();
+#endif
+
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		unsigned x = 0;
+#ifdef FI_HAS_SSE2
+#ifdef FI_HAS_AVX2
+		if(has_avx2) {
+			x = UnPreMultiplyLine_AVX2(bits, width, rcp);
+		}
+#endif
+		if(has_sse2) {
+			x += UnPreMultiplyLine_SSE2(bits + x * 4, width - x, rcp);
+		}
+		bits += x * 4;
+#endif
+		for(; x < width; x++, bits += 4) {
+			const float r = rcp[bits[FI_RGBA_ALPHA]];
+			bits[FI_RGBA_BLUE] = (BYTE)MIN((float)bits[FI_RGBA_BLUE] * r + 0.5F, 255.0F);
+			bits[FI_RGBA_GREEN] = (BYTE)MIN((float)bits[FI_RGBA_GREEN] * r + 0.5F, 255.0F);
+			bits[FI_RGBA_RED] = (BYTE)MIN((float)bits[FI_RGBA_RED] * r + 0.5F, 255.0F);
+		}
+	}
+	return TRUE;
+}
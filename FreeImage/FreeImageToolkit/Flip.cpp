@@ -24,6 +24,300 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+/// Size of the blocks of lines exchanged by FreeImage_FlipVertical
+#define FI_FLIP_BLOCK	4096
+
+// --------------------------------------------------------------------------
+
+/**
+Reversal of blocks of pixels of N bytes. The generic version moves single pixels, 
+the SSE2 versions move blocks of 16 8-bit, 8 16-bit and 4 32-bit pixels.
+24-bit pixels have SSSE3 kernels, see ReverseLine24_SSSE3.
+*/
+template <unsigned N> struct ReverseKernel {
+	/// Number of pixels of the blocks
+	enum { SIZE = 1 };
+	/// Copies the block at src, reversed, to dst
+	static inline void reverse(BYTE *dst, const BYTE *src) {
+		memcpy(dst, src, N);
+	}
+	/// Exchanges the blocks at a and b (which don't overlap), each one reversed
+	static inline void swap(BYTE *a, BYTE *b) {
+		BYTE tmp[N];
+		memcpy(tmp, a, N);
+		memcpy(a, b, N);
+		memcpy(b, tmp, N);
+	}
+};
+
+#ifdef FI_HAS_SSE2
+
+template <> struct ReverseKernel<1> {
+	enum { SIZE = 16 };
+	static inline __m128i reversed(__m128i v) {
+		// reverse the dwords, the words of each dword, then the bytes of each word
+		v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	}
+	static inline void reverse(BYTE *dst, const BYTE *src) {
+		_mm_storeu_si128((__m128i*)dst, reversed(_mm_loadu_si128((const __m128i*)src)));
+	}
+	static inline void swap(BYTE *a, BYTE *b) {
+		const __m128i va = _mm_loadu_si128((const __m128i*)a);
+		_mm_storeu_si128((__m128i*)a, reversed(_mm_loadu_si128((const __m128i*)b)));
+		_mm_storeu_si128((__m128i*)b, reversed(va));
+	}
+};
+
+template <> struct ReverseKernel<2> {
+	enum { SIZE = 8 };
+	static inline __m128i reversed(__m128i v) {
+		// reverse the dwords, then the words of each dword
+		v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	}
+	static inline void reverse(BYTE *dst, const BYTE *src) {
+		_mm_storeu_si128((__m128i*)dst, reversed(_mm_loadu_si128((const __m128i*)src)));
+	}
+	static inline void swap(BYTE *a, BYTE *b) {
+		const __m128i va = _mm_loadu_si128((const __m128i*)a);
+		_mm_storeu_si128((__m128i*)a, reversed(_mm_loadu_si128((const __m128i*)b)));
+		_mm_storeu_si128((__m128i*)b, reversed(va));
+	}
+};
+
+template <> struct ReverseKernel<4> {
+	enum { SIZE = 4 };
+	static inline __m128i reversed(__m128i v) {
+		return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	}
+	static inline void reverse(BYTE *dst, const BYTE *src) {
+		_mm_storeu_si128((__m128i*)dst, reversed(_mm_loadu_si128((const __m128i*)src)));
+	}
+	static inline void swap(BYTE *a, BYTE *b) {
+		const __m128i va = _mm_loadu_si128((const __m128i*)a);
+		_mm_storeu_si128((__m128i*)a, reversed(_mm_loadu_si128((const __m128i*)b)));
+		_mm_storeu_si128((__m128i*)b, reversed(va));
+	}
+};
+
+#endif // FI_HAS_SSE2
+
+/**
+Copies a line of N bytes per pixel, with the pixels in reverse order
+*/
+template <unsigned N> static void 
+ReverseLineT(BYTE *dst, const BYTE *src, unsigned width) {
+	const unsigned size = ReverseKernel<N>::SIZE;
+	unsigned x = 0;
+	for(; x + size <= width; x += size) {
+		ReverseKernel<N>::reverse(dst + (width - size - x) * N, src + x * N);
+	}
+	for(; x < width; x++) {
+		memcpy(dst + (width - 1 - x) * N, src + x * N, N);
+	}
+}
+
+/**
+Exchanges two lines of N bytes per pixel, reversing the order of their pixels. 
+If a and b are the same line, the line is reversed in place.
+*/
+template <unsigned N> static void 
+ReverseSwapLinesT(BYTE *a, BYTE *b, unsigned width) {
+	const unsigned size = ReverseKernel<N>::SIZE;
+	unsigned x = 0;
+	// blocks of a line exchanged with themselves must not overlap
+	const unsigned end = (a != b) ? width : width / 2;
+	for(; x + size <= end; x += size) {
+		ReverseKernel<N>::swap(a + x * N, b + (width - size - x) * N);
+	}
+	for(; x < end; x++) {
+		BYTE tmp[N];
+		memcpy(tmp, a + x * N, N);
+		memcpy(a + x * N, b + (width - 1 - x) * N, N);
+		memcpy(b + (width - 1 - x) * N, tmp, N);
+	}
+}
+
+#ifdef FI_HAS_SSSE3
+
+/**
+Loads a block of 16 24-bit pixels and returns it in o0, o1, o2 with the pixels in reverse order. 
+Each output vector gathers its bytes from two input vectors with pshufb, -1 clears a byte.
+*/
+FI_TARGET_SSSE3 static inline void
+Reverse24(__m128i &o0, __m128i &o1, __m128i &o2, const BYTE *src) {
+	const __m128i i0 = _mm_loadu_si128((const __m128i*)src);
+	const __m128i i1 = _mm_loadu_si128((const __m128i*)(src + 16));
+	const __m128i i2 = _mm_loadu_si128((const __m128i*)(src + 32));
+	o0 = _mm_or_si128(
+		_mm_shuffle_epi8(i2, _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1)),
+		_mm_shuffle_epi8(i1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14)));
+	// the last byte of i0 and the first byte of i2, side by side
+	const __m128i ends = _mm_alignr_epi8(i2, i0, 15);
+	o1 = _mm_or_si128(
+		_mm_shuffle_epi8(i1, _mm_setr_epi8(15, -1, 11, 12, 13, 8, 9, 10, 5, 6, 7, 2, 3, 4, -1, 0)),
+		_mm_shuffle_epi8(ends, _mm_setr_epi8(-1, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, -1)));
+	o2 = _mm_or_si128(
+		_mm_shuffle_epi8(i0, _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2)),
+		_mm_shuffle_epi8(i1, _mm_setr_epi8(1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)));
+}
+
+/**
+Stores a block of 16 24-bit pixels
+*/
+FI_TARGET_SSSE3 static inline void
+Store24(BYTE *dst, __m128i o0, __m128i o1, __m128i o2) {
+	_mm_storeu_si128((__m128i*)dst, o0);
+	_mm_storeu_si128((__m128i*)(dst + 16), o1);
+	_mm_storeu_si128((__m128i*)(dst + 32), o2);
+}
+
+/**
+ReverseLineT for 24-bit pixels
+*/
+FI_TARGET_SSSE3 static void
+ReverseLine24_SSSE3(BYTE *dst, const BYTE *src, unsigned width) {
+	unsigned x = 0;
+	for(; x + 16 <= width; x += 16) {
+		__m128i o0, o1, o2;
+		Reverse24(o0, o1, o2, src + x * 3);
+		Store24(dst + (width - 16 - x) * 3, o0, o1, o2);
+	}
+	for(; x < width; x++) {
+		memcpy(dst + (width - 1 - x) * 3, src + x * 3, 3);
+	}
+}
+
+/**
+ReverseSwapLinesT for 24-bit pixels
+*/
+FI_TARGET_SSSE3 static void
+ReverseSwapLines24_SSSE3(BYTE *a, BYTE *b, unsigned width) {
+	unsigned x = 0;
+	// blocks of a line exchanged with themselves must not overlap
+	const unsigned end = (a != b) ? width : width / 2;
+	for(; x + 16 <= end; x += 16) {
+		BYTE *block_a = a + x * 3;
+		BYTE *block_b = b + (width - 16 - x) * 3;
+		__m128i a0, a1, a2, b0, b1, b2;
+		Reverse24(a0, a1, a2, block_a);
+		Reverse24(b0, b1, b2, block_b);
+		Store24(block_a, b0, b1, b2);
+		Store24(block_b, a0, a1, a2);
+	}
+	for(; x < end; x++) {
+		BYTE tmp[3];
+		memcpy(tmp, a + x * 3, 3);
+		memcpy(a + x * 3, b + (width - 1 - x) * 3, 3);
+		memcpy(b + (width - 1 - x) * 3, tmp, 3);
+	}
+}
+
+#endif // FI_HAS_SSSE3
+
+/**
+Copies a line with the pixels in reverse order, see ReverseLineT
+@param bytespp Number of bytes per pixel
+*/
+void 
+ReverseLine(BYTE *dst, const BYTE *src, unsigned width, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			ReverseLineT<1>(dst, src, width);
+			break;
+		case 2:
+			ReverseLineT<2>(dst, src, width);
+			break;
+		case 3:
+#ifdef FI_HAS_SSSE3
+			if(HasSSSE3()) {
+				ReverseLine24_SSSE3(dst, src, width);
+				break;
+			}
+#endif
+			ReverseLineT<3>(dst, src, width);
+			break;
+		case 4:
+			ReverseLineT<4>(dst, src, width);
+			break;
+		case 6:
+			ReverseLineT<6>(dst, src, width);
+			break;
+		case 8:
+			ReverseLineT<8>(dst, src, width);
+			break;
+		case 12:
+			ReverseLineT<12>(dst, src, width);
+			break;
+		case 16:
+			ReverseLineT<16>(dst, src, width);
+			break;
+	}
+}
+
+/**
+Exchanges two lines reversing their pixels, see ReverseSwapLinesT
+@param bytespp Number of bytes per pixel
+*/
+void 
+ReverseSwapLines(BYTE *a, BYTE *b, unsigned width, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			ReverseSwapLinesT<1>(a, b, width);
+			break;
+		case 2:
+			ReverseSwapLinesT<2>(a, b, width);
+			break;
+		case 3:
+#ifdef FI_HAS_SSSE3
+			if(HasSSSE3()) {
+				ReverseSwapLines24_SSSE3(a, b, width);
+				break;
+			}
+#endif
+			ReverseSwapLinesT<3>(a, b, width);
+			break;
+		case 4:
+			ReverseSwapLinesT<4>(a, b, width);
+			break;
+		case 6:
+			ReverseSwapLinesT<6>(a, b, width);
+			break;
+		case 8:
+			ReverseSwapLinesT<8>(a, b, width);
+			break;
+		case 12:
+			ReverseSwapLinesT<12>(a, b, width);
+			break;
+		case 16:
+			ReverseSwapLinesT<16>(a, b, width);
+			break;
+	}
+}
+
+/**
+Exchanges two lines of size bytes
+*/
+static void
+SwapLines(BYTE *a, BYTE *b, unsigned size) {
+	// through a block small enough to stay in the L1 cache
+	BYTE tmp[FI_FLIP_BLOCK];
+	unsigned i = 0;
+	while(i < size) {
+		const unsigned count = MIN(size - i, (unsigned)FI_FLIP_BLOCK);
+		memcpy(tmp, a + i, count);
+		memcpy(a + i, b + i, count);
+		memcpy(b + i, tmp, count);
+		i += count;
+	}
+}
+
+// --------------------------------------------------------------------------
+
 /**
 Flip the image horizontally along the vertical axis.
 @param src Input image to be processed.
@@ -39,6 +333,17 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 
 	unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
+	if (FreeImage_GetBPP(src) >= 8) {
+		// mirror each line in place
+
+		for (unsigned y = 0; y < height; y++) {
+			BYTE *bits = FreeImage_GetScanLine(src, y);
+			ReverseSwapLines(bits, bits, width, bytespp);
+		}
+
+		return TRUE;
+	}
+
 	// copy between aligned memories
 	BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
 	if (!new_bits) return FALSE;
@@ -75,44 +380,6 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 			}
 			break;
 
-			case 8:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 16:
-			{				
-				WORD *dst_data = (WORD*) bits; 				
-				WORD *src_data = (WORD*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 24 :
-			case 32 :
-			case 48:
-			case 64:
-			case 96:
-			case 128:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 		
-					for(unsigned k = 0; k < bytespp; k++) {
-						*dst_data++ = src_data[k];  
-					}
-					src_data -= bytespp;
-				} 
-			}
-			break;
-
 		}
 	}
 
@@ -130,8 +397,6 @@ Flip the image vertically along the horizontal axis.
 
 BOOL DLL_CALLCONV 
 FreeImage_FlipVertical(FIBITMAP *src) {
-	BYTE *From, *Mid;
-
 	if (!FreeImage_HasPixels(src)) return FALSE;
 
 	// swap the buffer
@@ -139,28 +404,20 @@ FreeImage_FlipVertical(FIBITMAP *src) {
 	unsigned pitch  = FreeImage_GetPitch(src);
 	unsigned height = FreeImage_GetHeight(src);
 
-	// copy between aligned memories
-	Mid = (BYTE*)FreeImage_Aligned_Malloc(pitch * sizeof(BYTE), FIBITMAP_ALIGNMENT);
-	if (!Mid) return FALSE;
-
-	From = FreeImage_GetBits(src);
+	BYTE *From = FreeImage_GetBits(src);
 	
 	unsigned line_s = 0;
 	unsigned line_t = (height-1) * pitch;
 
 	for(unsigned y = 0; y < height/2; y++) {
 
-		memcpy(Mid, From + line_s, pitch);
-		memcpy(From + line_s, From + line_t, pitch);
-		memcpy(From + line_t, Mid, pitch);
+		SwapLines(From + line_s, From + line_t, pitch);
 
 		line_s += pitch;
 		line_t -= pitch;
 
 	}
 
-	FreeImage_Aligned_Free(Mid);
-
 	return TRUE;
 }
 
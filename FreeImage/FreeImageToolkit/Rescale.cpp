@@ -21,6 +21,51 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+
+/// Largest reduction factor of BoxReduce, so that the column sums fit in 16 bits
+#define FI_BOX_MAX_FACTOR	256
+
+/// Number of threads of the rescale functions called without FI_RESCALE_THREADS
+static std::atomic<unsigned> s_rescale_threads(1);
+
+/**
+Returns the number of threads requested by the FI_RESCALE_THREADS bits of flags, or the default one
+*/
+static unsigned
+GetRescaleThreads(unsigned flags) {
+	const unsigned threads = (flags >> 8) & 0xFF;
+	return threads ? threads : s_rescale_threads.load();
+}
+
+/**
+Sets the number of threads used by the rescale functions when their flags don't hold FI_RESCALE_THREADS.
+@param threads Number of threads, 0 or less selects the number of hardware threads. The default is 1.
+*/
+void DLL_CALLCONV
+FreeImage_SetRescaleThreads(int threads) {
+	s_rescale_threads = (threads > 0) ? (unsigned)threads : FreeImage_GetHardwareThreads();
+}
+
+/**
+Sets the number of filter weights tables kept for rescaling further images with the same geometry 
+(source size, destination size and filter). The default is 64 tables, 0 disables the cache.
+*/
+void DLL_CALLCONV
+FreeImage_SetRescaleCacheSize(unsigned entries) {
+	CWeightsCache::setCapacity(entries);
+}
+
+/**
+Retrieves the number of filter weights tables found in the cache (hits) and computed (misses) 
+by the rescale functions. Each filter pass looks up one table.
+*/
+void DLL_CALLCONV
+FreeImage_GetRescaleCacheStats(UINT64 *hits, UINT64 *misses) {
+	CWeightsCache::getStats(hits, misses);
+}
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_RescaleRect(FIBITMAP *src, int dst_width, int dst_height, int src_left, int src_top, int src_right, int src_bottom, FREE_IMAGE_FILTER filter, unsigned flags) {
@@ -73,7 +118,7 @@ FreeImage_RescaleRect(FIBITMAP *src, int dst_width, int dst_height, int src_left
 		return NULL;
 	}
 
-	CResizeEngine Engine(pFilter);
+	CResizeEngine Engine(pFilter, GetRescaleThreads(flags));
 
 	dst = Engine.scale(src, dst_width, dst_height, src_left, src_top,
 			src_right - src_left, src_bottom - src_top, flags);
@@ -93,8 +138,337 @@ FreeImage_Rescale(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTE
 	return FreeImage_RescaleRect(src, dst_width, dst_height, 0, 0, FreeImage_GetWidth(src), FreeImage_GetHeight(src), filter, FI_RESCALE_DEFAULT);
 }
 
+/**
+Rescale src into the caller's dst, using the filter on the stack so that nothing but the 
+intermediate image of the two pass filter gets allocated
+*/
+template <class FILTER> static BOOL
+RescaleInto(FIBITMAP *src, FIBITMAP *dst, unsigned flags) {
+	FILTER filter;
+	CResizeEngine Engine(&filter, GetRescaleThreads(flags));
+	return Engine.scale(src, FreeImage_GetWidth(dst), FreeImage_GetHeight(dst), 0, 0, 
+		FreeImage_GetWidth(src), FreeImage_GetHeight(src), flags, dst) != NULL;
+}
+
+BOOL DLL_CALLCONV
+FreeImage_RescaleInto(FIBITMAP *src, FIBITMAP *dst, FREE_IMAGE_FILTER filter, unsigned flags) {
+	if (!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst) || (src == dst)) {
+		return FALSE;
+	}
+
+	BOOL bResult = FALSE;
+	switch (filter) {
+		case FILTER_BOX:
+			bResult = RescaleInto<CBoxFilter>(src, dst, flags);
+			break;
+		case FILTER_BICUBIC:
+			bResult = RescaleInto<CBicubicFilter>(src, dst, flags);
+			break;
+		case FILTER_BILINEAR:
+			bResult = RescaleInto<CBilinearFilter>(src, dst, flags);
+			break;
+		case FILTER_BSPLINE:
+			bResult = RescaleInto<CBSplineFilter>(src, dst, flags);
+			break;
+		case FILTER_CATMULLROM:
+			bResult = RescaleInto<CCatmullRomFilter>(src, dst, flags);
+			break;
+		case FILTER_LANCZOS3:
+			bResult = RescaleInto<CLanczos3Filter>(src, dst, flags);
+			break;
+	}
+
+	if (bResult && ((flags & FI_RESCALE_OMIT_METADATA) != FI_RESCALE_OMIT_METADATA)) {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, src);
+	}
+
+	return bResult;
+}
+
+BOOL DLL_CALLCONV
+FreeImage_RescaleStream(FREE_IMAGE_TYPE type, int bpp, int width, int height, int dst_width, int dst_height, int left, int top, int right, int bottom, FI_RescaleReadProc read, FI_RescaleWriteProc write, void *data, FREE_IMAGE_FILTER filter, unsigned flags) {
+	if (!read || !write || (dst_width <= 0) || (dst_height <= 0) || (width <= 0) || (height <= 0)) {
+		return FALSE;
+	}
+
+	// normalize the rectangle
+	if (right < left) {
+		INPLACESWAP(left, right);
+	}
+	if (bottom < top) {
+		INPLACESWAP(top, bottom);
+	}
+
+	// check the size of the sub image
+	if ((left < 0) || (right > width) || (top < 0) || (bottom > height) || (left == right) || (top == bottom)) {
+		return FALSE;
+	}
+
+	// select the filter
+	CGenericFilter *pFilter = NULL;
+	switch (filter) {
+		case FILTER_BOX:
+			pFilter = new(std::nothrow) CBoxFilter();
+			break;
+		case FILTER_BICUBIC:
+			pFilter = new(std::nothrow) CBicubicFilter();
+			break;
+		case FILTER_BILINEAR:
+			pFilter = new(std::nothrow) CBilinearFilter();
+			break;
+		case FILTER_BSPLINE:
+			pFilter = new(std::nothrow) CBSplineFilter();
+			break;
+		case FILTER_CATMULLROM:
+			pFilter = new(std::nothrow) CCatmullRomFilter();
+			break;
+		case FILTER_LANCZOS3:
+			pFilter = new(std::nothrow) CLanczos3Filter();
+			break;
+	}
+
+	if (!pFilter) {
+		return FALSE;
+	}
+
+	CResizeEngine Engine(pFilter, GetRescaleThreads(flags));
+
+	const BOOL bResult = Engine.scaleStream(type, bpp, width, dst_width, dst_height, left, top, 
+		right - left, bottom - top, read, write, data);
+
+	delete pFilter;
+
+	return bResult;
+}
+
+/**
+Sums the samples of a block of rows into columns
+@param sums Column sums
+@param bits First row of the block
+@param pitch Distance between the rows in bytes
+@param rows Number of rows, at most FI_BOX_MAX_FACTOR
+@param count Number of samples per row
+*/
+static void
+SumRows(WORD *sums, const BYTE *bits, unsigned pitch, unsigned rows, unsigned count) {
+	unsigned i = 0;
+#ifdef FI_HAS_SSE2
+	// 16 columns at a time, over all the rows, so that the sums stay in registers
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		const BYTE *p = bits + i;
+		__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		for (unsigned y = 0; y < rows; y++) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)p);
+			lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+			hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+			p += pitch;
+		}
+		_mm_storeu_si128((__m128i *)(sums + i), lo);
+		_mm_storeu_si128((__m128i *)(sums + i + 8), hi);
+	}
+#endif
+	for (; i < count; i++) {
+		const BYTE *p = bits + i;
+		unsigned sum = 0;
+		for (unsigned y = 0; y < rows; y++) {
+			sum += *p;
+			p += pitch;
+		}
+		sums[i] = (WORD)sum;
+	}
+}
+
+/**
+Returns TRUE for the images whose samples can be averaged: 8-bit greyscale, 24-bit and 32-bit bitmaps
+*/
+static BOOL
+CanBoxReduce(FIBITMAP *dib) {
+	if (FreeImage_GetImageType(dib) != FIT_BITMAP) {
+		return FALSE;
+	}
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	return (bpp == 24) || (bpp == 32) || ((bpp == 8) && (FreeImage_GetColorType(dib) == FIC_MINISBLACK));
+}
+
+/**
+Reduces an 8-bit greyscale, 24-bit or 32-bit image by integer factors, each destination pixel 
+being the rounded average of a block of kx x ky source pixels. Only whole blocks are reduced, so 
+the result covers the top-left src_width / kx * kx x src_height / ky * ky pixels of the image: 
+the few pixels left at the right and bottom would otherwise be stretched over a whole destination 
+pixel by the filter that follows. This is the cheap first step of the thumbnail functions.
+@param src Source image
+@param kx Horizontal reduction factor, at most FI_BOX_MAX_FACTOR
+@param ky Vertical reduction factor, at most FI_BOX_MAX_FACTOR
+@return Returns the reduced image, or NULL if the image isn't supported or on memory error
+*/
+static FIBITMAP*
+BoxReduce(FIBITMAP *src, unsigned kx, unsigned ky) {
+	if (!CanBoxReduce(src) || (kx > FI_BOX_MAX_FACTOR) || (ky > FI_BOX_MAX_FACTOR)) {
+		return NULL;
+	}
+
+	const unsigned bpp = FreeImage_GetBPP(src);
+	const unsigned bytespp = bpp / 8;
+	const unsigned src_width = FreeImage_GetWidth(src);
+	const unsigned src_height = FreeImage_GetHeight(src);
+	const unsigned dst_width = src_width / kx;
+	const unsigned dst_height = src_height / ky;
+	const unsigned line = src_width * bytespp;
+
+	if ((dst_width == 0) || (dst_height == 0)) {
+		return NULL;
+	}
+
+	FIBITMAP *dst = FreeImage_Allocate(dst_width, dst_height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	WORD *sums = (WORD*)malloc(line * sizeof(WORD));
+	if (!dst || !sums) {
+		FreeImage_Unload(dst);
+		free(sums);
+		return NULL;
+	}
+
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const unsigned count = kx * ky;
+
+	// bitmaps are stored bottom-up, the rows left out are the bottom ones
+	const unsigned bottom = src_height - dst_height * ky;
+
+	for (unsigned y = 0; y < dst_height; y++) {
+		// sum the rows of the block into columns
+		SumRows(sums, FreeImage_GetScanLine(src, bottom + y * ky), src_pitch, ky, dst_width * kx * bytespp);
+
+		// then average the columns of each block
+		BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for (unsigned x = 0; x < dst_width; x++) {
+			const WORD *column = sums + x * kx * bytespp;
+			unsigned sum[4] = { 0, 0, 0, 0 };
+			for (unsigned i = 0; i < kx; i++) {
+				for (unsigned c = 0; c < bytespp; c++) {
+					sum[c] += column[c];
+				}
+				column += bytespp;
+			}
+			for (unsigned c = 0; c < bytespp; c++) {
+				dst_bits[c] = (BYTE)((sum[c] + count / 2) / count);
+			}
+			dst_bits += bytespp;
+		}
+	}
+
+	free(sums);
+
+	return dst;
+}
+
+/**
+Averages blocks of 2x2 pixels of two rows into a row of half the width. 
+row0 and row1 may be the same row (image of height 1), kx is 1 for images of width 1.
+*/
+static void
+AverageRows2x2(const BYTE *row0, const BYTE *row1, unsigned kx, unsigned bytespp, unsigned dst_width, BYTE *dst_bits) {
+	unsigned x = 0;
+#ifdef FI_HAS_SSE2
+	if ((kx == 2) && (bytespp == 4)) {
+		// 4 source pixels, 2 destination pixels at a time
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		for (; x + 2 <= dst_width; x += 2) {
+			const __m128i p0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+			const __m128i p1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+			const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(p0, zero), _mm_unpacklo_epi8(p1, zero));
+			const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(p0, zero), _mm_unpackhi_epi8(p1, zero));
+			// add the right pixel of each pair to the left one
+			const __m128i pairs = _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+			const __m128i average = _mm_srli_epi16(_mm_add_epi16(pairs, two), 2);
+			_mm_storel_epi64((__m128i *)(dst_bits + x * 4), _mm_packus_epi16(average, average));
+		}
+	}
+#endif
+	const unsigned right = (kx - 1) * bytespp;
+	for (; x < dst_width; x++) {
+		const BYTE *p0 = row0 + x * kx * bytespp;
+		const BYTE *p1 = row1 + x * kx * bytespp;
+		BYTE *q = dst_bits + x * bytespp;
+		for (unsigned c = 0; c < bytespp; c++) {
+			q[c] = (BYTE)((p0[c] + p0[right + c] + p1[c] + p1[right + c] + 2) >> 2);
+		}
+	}
+}
+
+/**
+Computes row y of a level of a box pyramid, then the rows of the next levels it completes, 
+so that each row is reduced again while it is still in the cache
+@param levels The levels, levels[0] being the source of the first reduced level
+@param count Number of reduced levels
+@param level Level of the row, from 1 to count
+@param y Row to compute
+*/
+static void
+StreamBoxRow(FIBITMAP **levels, int count, int level, unsigned y) {
+	FIBITMAP *src = levels[level - 1];
+	FIBITMAP *dst = levels[level];
+	const unsigned kx = (FreeImage_GetWidth(src) > 1) ? 2 : 1;
+	const unsigned ky = (FreeImage_GetHeight(src) > 1) ? 2 : 1;
+	const BYTE *row0 = FreeImage_GetScanLine(src, y * ky);
+	const BYTE *row1 = FreeImage_GetScanLine(src, y * ky + ky - 1);
+	AverageRows2x2(row0, row1, kx, FreeImage_GetBPP(src) / 8, FreeImage_GetWidth(dst), FreeImage_GetScanLine(dst, y));
+
+	if (level < count) {
+		if (FreeImage_GetHeight(dst) == 1) {
+			StreamBoxRow(levels, count, level + 1, 0);
+		} else if (y & 1) {
+			StreamBoxRow(levels, count, level + 1, y >> 1);
+		}
+	}
+}
+
+/**
+Builds successive box reductions of an image while its dimensions stay even (or 1), 
+streaming the source once for all of them
+@param dib Source image, CanBoxReduce must be TRUE
+@param levels Receives the reduced levels
+@param count Maximum number of levels
+@return Returns the number of levels built
+*/
+static int
+BuildBoxLevels(FIBITMAP *dib, FIBITMAP **levels, int count) {
+	unsigned width = FreeImage_GetWidth(dib);
+	unsigned height = FreeImage_GetHeight(dib);
+	FIBITMAP *chain[32];
+	int built = 0;
+
+	chain[0] = dib;
+	while ((built < count) && (built < 31)) {
+		if (((width > 1) && (width & 1)) || ((height > 1) && (height & 1)) || ((width == 1) && (height == 1))) {
+			break;
+		}
+		width = MAX(width / 2, 1U);
+		height = MAX(height / 2, 1U);
+		FIBITMAP *level = FreeImage_Allocate(width, height, FreeImage_GetBPP(dib), FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+		if (!level) {
+			break;
+		}
+		chain[++built] = level;
+	}
+
+	if (built > 0) {
+		for (unsigned y = 0; y < FreeImage_GetHeight(chain[1]); y++) {
+			StreamBoxRow(chain, built, 1, y);
+		}
+		memcpy(levels, chain + 1, built * sizeof(FIBITMAP*));
+	}
+	return built;
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert) {
+	return FreeImage_MakeThumbnailEx(dib, max_pixel_size, convert, FI_THUMBNAIL_FAST);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_MakeThumbnailEx(FIBITMAP *dib, int max_pixel_size, BOOL convert, int quality) {
 	FIBITMAP *thumbnail = NULL;
 	int new_width, new_height;
 
@@ -126,7 +500,11 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert) {
 
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 
-	// perform downsampling using a bilinear interpolation
+	// fast and balanced thumbnails of 8-bit per channel images are box averaged by integer factors 
+	// down to 2 (respectively 4) times the thumbnail size, then filtered once at that small size; 
+	// best thumbnails are filtered from the full image
+	const int margin = (quality == FI_THUMBNAIL_FAST) ? 2 : 4;
+	const FREE_IMAGE_FILTER filter = (quality == FI_THUMBNAIL_FAST) ? FILTER_BILINEAR : FILTER_LANCZOS3;
 
 	switch(image_type) {
 		case FIT_BITMAP:
@@ -137,8 +515,14 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			FREE_IMAGE_FILTER filter = FILTER_BILINEAR;
-			thumbnail = FreeImage_Rescale(dib, new_width, new_height, filter);
+			const unsigned kx = MIN(width / (new_width * margin), FI_BOX_MAX_FACTOR);
+			const unsigned ky = MIN(height / (new_height * margin), FI_BOX_MAX_FACTOR);
+			FIBITMAP *reduced = NULL;
+			if ((quality != FI_THUMBNAIL_BEST) && (kx > 1 || ky > 1)) {
+				reduced = BoxReduce(dib, MAX(kx, 1U), MAX(ky, 1U));
+			}
+			thumbnail = FreeImage_Rescale(reduced ? reduced : dib, new_width, new_height, filter);
+			FreeImage_Unload(reduced);
 		}
 		break;
 
@@ -190,3 +574,51 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert) {
 
 	return thumbnail;
 }
+
+/**
+Builds successive half size reductions of an image (width and height divided by 2, rounding down, 
+at least 1 pixel), each level being reduced from the previous one. The levels carry no metadata.
+@param dib Source image
+@param levels Receives the levels, to be unloaded by the caller
+@param count Number of levels to build
+@param filter Reduction filter. FILTER_BOX averages blocks of 2x2 pixels of 8-bit greyscale, 24-bit 
+and 32-bit images exactly, computing the levels of even dimensions in a single pass
+@return Returns the number of levels built: count, or less if the image reaches 1x1 pixel or on error
+*/
+int DLL_CALLCONV
+FreeImage_MakePyramid(FIBITMAP *dib, FIBITMAP **levels, int count, FREE_IMAGE_FILTER filter) {
+	if (!FreeImage_HasPixels(dib) || !levels) {
+		return 0;
+	}
+
+	FIBITMAP *src = dib;
+	int built = 0;
+
+	while (built < count) {
+		const int width = FreeImage_GetWidth(src);
+		const int height = FreeImage_GetHeight(src);
+		if ((width == 1) && (height == 1)) {
+			break;
+		}
+
+		// the box filter averages blocks of 2x2 pixels exactly, computing all the levels 
+		// of even dimensions in a single pass over src
+		if ((filter == FILTER_BOX) && CanBoxReduce(src)) {
+			const int streamed = BuildBoxLevels(src, levels + built, count - built);
+			if (streamed > 0) {
+				built += streamed;
+				src = levels[built - 1];
+				continue;
+			}
+		}
+
+		// odd dimensions, other filters and other image types
+		levels[built] = FreeImage_RescaleRect(src, MAX(width / 2, 1), MAX(height / 2, 1), 0, 0, width, height, filter, FI_RESCALE_OMIT_METADATA);
+		if (!levels[built]) {
+			break;
+		}
+		src = levels[built++];
+	}
+
+	return built;
+}
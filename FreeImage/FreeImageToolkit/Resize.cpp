@@ -22,6 +22,32 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "ThreadPool.h"
+
+#include <list>
+#include <mutex>
+#include <typeinfo>
+
+/// Minimum number of destination pixels in a band of rows or columns filtered by a thread
+#define FI_RESIZE_BAND_PIXELS	65536
+
+/// Maximum number of source rows read by a block of the vertical pass (unless a single window is larger)
+#define FI_RESIZE_BLOCK_ROWS	64
+
+/// Size of the source window of a strip of columns of the vertical pass, so that it stays in the L2 cache
+#define FI_RESIZE_BLOCK_BYTES	(512 * 1024)
+
+/// Default number of weights tables kept by CWeightsCache
+#define FI_WEIGHTS_CACHE_ENTRIES	64
+
+/// Maximum size of the weights tables kept by CWeightsCache
+#define FI_WEIGHTS_CACHE_BYTES		(32 * 1024 * 1024)
+
+/// Size of the batches of source rows read by CResizeEngine::scaleStream
+#define FI_RESIZE_STREAM_BYTES		(1024 * 1024)
+
+/// Maximum number of rows of the batches of CResizeEngine::scaleStream
+#define FI_RESIZE_STREAM_ROWS		64
 
 /**
 Returns the color type of a bitmap. In contrast to FreeImage_GetColorType,
@@ -136,6 +162,16 @@ GetRGBAPalette(FIBITMAP *dib, RGBQUAD * const buffer) {
 	return buffer;
 }
 
+/**
+Rounds a sum of pixel values weighted with fixed point weights to the nearest integer
+@param value Sum of products of pixel values with weights scaled by FI_WEIGHT_ONE
+@return Returns the rounded value, not clamped
+*/
+static inline int
+RoundFixed(int value) {
+	return (value + (FI_WEIGHT_ONE >> 1)) >> FI_WEIGHT_BITS;
+}
+
 // --------------------------------------------------------------------------
 
 CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize) {
@@ -160,15 +196,28 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 	//
 	// window size is the number of sampled pixels
 	m_WindowSize = 2 * (int)ceil(dWidth) + 1; 
+	// windows are padded to 8 weights, so that every fixed point window is 16-byte aligned
+	m_WindowStride = (m_WindowSize + 7) & ~7;
 	// length of dst line (no. of rows / cols) 
 	m_LineLength = uDstSize; 
 
-	 // allocate list of contributions 
-	m_WeightTable = (Contribution*)malloc(m_LineLength * sizeof(Contribution));
-	for(unsigned u = 0; u < m_LineLength; u++) {
-		// allocate contributions for every pixel
-		m_WeightTable[u].Weights = (double*)malloc(m_WindowSize * sizeof(double));
+	// allocate the double weights, the fixed point weights and the bounds in a single block
+	const size_t weights_size = (size_t)m_LineLength * m_WindowStride;
+	BYTE *block = (BYTE*)FreeImage_Aligned_Malloc(weights_size * (sizeof(double) + sizeof(short)) + m_LineLength * sizeof(Contribution), FIBITMAP_ALIGNMENT);
+	if(!block) {
+		// leave an empty table, see isValid()
+		m_Block = NULL;
+		m_Weights = NULL;
+		m_FixedWeights = NULL;
+		m_Bounds = NULL;
+		m_LineLength = 0;
+		return;
 	}
+	memset(block, 0, weights_size * (sizeof(double) + sizeof(short)));
+	m_Block = block;
+	m_Weights = (double*)block;
+	m_FixedWeights = (short*)(block + weights_size * sizeof(double));
+	m_Bounds = (Contribution*)(block + weights_size * (sizeof(double) + sizeof(short)));
 
 	// offset for discrete to continuous coordinate conversion
 	const double dOffset = (0.5 / dScale);
@@ -183,32 +232,50 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 		const int iLeft = MAX(0, (int)(dCenter - dWidth + 0.5));
 		const int iRight = MIN((int)(dCenter + dWidth + 0.5), int(uSrcSize));
 
-		m_WeightTable[u].Left = iLeft; 
-		m_WeightTable[u].Right = iRight;
+		double *weights = m_Weights + u * m_WindowStride;
+		short *fixed_weights = m_FixedWeights + u * m_WindowStride;
+
+		m_Bounds[u].Left = iLeft; 
+		m_Bounds[u].Right = iRight;
 
 		double dTotalWeight = 0;  // sum of weights (initialized to zero)
 		for(int iSrc = iLeft; iSrc < iRight; iSrc++) {
 			// calculate weights
 			const double weight = dFScale * pFilter->Filter(dFScale * ((double)iSrc + 0.5 - dCenter));
 			// assert((iSrc-iLeft) < m_WindowSize);
-			m_WeightTable[u].Weights[iSrc-iLeft] = weight;
+			weights[iSrc-iLeft] = weight;
 			dTotalWeight += weight;
 		}
 		if((dTotalWeight > 0) && (dTotalWeight != 1)) {
 			// normalize weight of neighbouring points
 			for(int iSrc = iLeft; iSrc < iRight; iSrc++) {
 				// normalize point
-				m_WeightTable[u].Weights[iSrc-iLeft] /= dTotalWeight; 
+				weights[iSrc-iLeft] /= dTotalWeight; 
+			}
+		}
+
+		// quantize the weights to fixed point, 
+		// giving the rounding error to the largest weight so that the window sums up to FI_WEIGHT_ONE
+		if(dTotalWeight > 0) {
+			int iTotal = 0;
+			int iLargest = 0;
+			for(int i = 0; i < iRight - iLeft; i++) {
+				fixed_weights[i] = (short)floor(weights[i] * FI_WEIGHT_ONE + 0.5);
+				iTotal += fixed_weights[i];
+				if(fixed_weights[i] > fixed_weights[iLargest]) {
+					iLargest = i;
+				}
 			}
+			fixed_weights[iLargest] = (short)(fixed_weights[iLargest] + FI_WEIGHT_ONE - iTotal);
 		}
 
 		// simplify the filter, discarding null weights at the right
 		{			
 			int iTrailing = iRight - iLeft - 1;
-			while(m_WeightTable[u].Weights[iTrailing] == 0) {
-				m_WeightTable[u].Right--;
+			while(weights[iTrailing] == 0) {
+				m_Bounds[u].Right--;
 				iTrailing--;
-				if(m_WeightTable[u].Right == m_WeightTable[u].Left) {
+				if(m_Bounds[u].Right == m_Bounds[u].Left) {
 					break;
 				}
 			}
@@ -218,18 +285,576 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 	} // next dst pixel
 }
 
-CWeightsTable::~CWeightsTable() {
+CWeightsTable::CWeightsTable(const CWeightsTable &table, unsigned first, unsigned last, unsigned origin) {
+	m_WindowSize = table.m_WindowSize;
+	m_WindowStride = table.m_WindowStride;
+	m_LineLength = last - first;
+
+	// the weights are shared, only the bounds are moved to the origin
+	m_Weights = table.m_Weights + (size_t)first * m_WindowStride;
+	m_FixedWeights = table.m_FixedWeights + (size_t)first * m_WindowStride;
+	m_Block = (BYTE*)FreeImage_Aligned_Malloc(MAX(m_LineLength, 1U) * sizeof(Contribution), FIBITMAP_ALIGNMENT);
+	m_Bounds = (Contribution*)m_Block;
+	if(!m_Block) {
+		// leave an empty view, see isValid()
+		m_LineLength = 0;
+		return;
+	}
 	for(unsigned u = 0; u < m_LineLength; u++) {
-		// free contributions for every pixel
-		free(m_WeightTable[u].Weights);
+		m_Bounds[u].Left = table.m_Bounds[first + u].Left - origin;
+		m_Bounds[u].Right = table.m_Bounds[first + u].Right - origin;
+	}
+}
+
+CWeightsTable::~CWeightsTable() {
+	// the bounds and both weight tables share a single block (a view only owns its bounds)
+	FreeImage_Aligned_Free(m_Block);
+}
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+/**
+A cached weights table and the geometry it was computed for
+*/
+struct CachedWeights {
+	const std::type_info *filter;
+	double width;
+	unsigned dst_size;
+	unsigned src_size;
+	size_t memory_size;
+	std::shared_ptr<CWeightsTable> table;
+};
+
+/**
+State of CWeightsCache, the most recently used table first
+*/
+struct WeightsCacheState {
+	std::mutex mutex;
+	std::list<CachedWeights> tables;
+	unsigned capacity;
+	size_t memory_size;
+	UINT64 hits;
+	UINT64 misses;
+
+	WeightsCacheState() : capacity(FI_WEIGHTS_CACHE_ENTRIES), memory_size(0), hits(0), misses(0) {}
+
+	/// Drops the least recently used tables until the cache fits its limits
+	void trim() {
+		while(!tables.empty() && (tables.size() > capacity || memory_size > FI_WEIGHTS_CACHE_BYTES)) {
+			memory_size -= tables.back().memory_size;
+			tables.pop_back();
+		}
+	}
+};
+
+WeightsCacheState&
+GetWeightsCache() {
+	// never destroyed, so that rescaling from other threads while the process exits stays valid
+	static WeightsCacheState *cache = new WeightsCacheState;
+	return *cache;
+}
+
+} // namespace
+
+std::shared_ptr<CWeightsTable> 
+CWeightsCache::getTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize) {
+	WeightsCacheState &cache = GetWeightsCache();
+	const std::type_info *filter = &typeid(*pFilter);
+	const double width = pFilter->GetWidth();
+
+	{
+		std::lock_guard<std::mutex> lock(cache.mutex);
+		for(std::list<CachedWeights>::iterator i = cache.tables.begin(); i != cache.tables.end(); ++i) {
+			if((i->dst_size == uDstSize) && (i->src_size == uSrcSize) && (i->width == width) && (*i->filter == *filter)) {
+				cache.tables.splice(cache.tables.begin(), cache.tables, i);
+				cache.hits++;
+				return i->table;
+			}
+		}
+		cache.misses++;
+	}
+
+	// compute the table unlocked, another thread may cache the same one meanwhile: 
+	// both tables are identical and the older one simply ages out
+	std::shared_ptr<CWeightsTable> table = std::make_shared<CWeightsTable>(pFilter, uDstSize, uSrcSize);
+	if(!table->isValid()) {
+		return std::shared_ptr<CWeightsTable>();
+	}
+
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	if(cache.capacity > 0) {
+		const CachedWeights entry = { filter, width, uDstSize, uSrcSize, table->getMemorySize(), table };
+		cache.tables.push_front(entry);
+		cache.memory_size += entry.memory_size;
+		cache.trim();
+	}
+	return table;
+}
+
+void 
+CWeightsCache::setCapacity(unsigned entries) {
+	WeightsCacheState &cache = GetWeightsCache();
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	cache.capacity = entries;
+	cache.trim();
+}
+
+void 
+CWeightsCache::getStats(UINT64 *hits, UINT64 *misses) {
+	WeightsCacheState &cache = GetWeightsCache();
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	if(hits) {
+		*hits = cache.hits;
+	}
+	if(misses) {
+		*misses = cache.misses;
+	}
+}
+
+// --------------------------------------------------------------------------
+// SIMD kernels
+//
+// The kernels filter whole lines of 8-bit samples (greyscale, 24-bit and 32-bit images) 
+// and of FIT_RGBF / FIT_RGBAF pixels. The 8-bit kernels sum the products of pixels and 
+// fixed point weights in 32-bit integers and the float kernels sum in double precision 
+// with separate multiplies and adds, in the same order as the scalar code, so that 
+// the output is bit-identical to the scalar filters.
+// SSE2 is the baseline of x86 / x64 builds, AVX2 is selected at runtime.
+// --------------------------------------------------------------------------
+
+/**
+Vectorized line filters of CResizeEngine
+*/
+typedef struct {
+	/// Filters a row of 8-bit samples horizontally, bytespp is 1, 3 or 4
+	void (*horizontal8)(CWeightsTable &weightsTable, const BYTE *src_bits, unsigned src_width, unsigned bytespp, BYTE *dst_bits, unsigned dst_width);
+	/// Filters the row dst_pos of 'count' 8-bit samples vertically
+	void (*vertical8)(CWeightsTable &weightsTable, unsigned dst_pos, const BYTE *src_base, unsigned src_pitch, unsigned count, BYTE *dst_bits);
+	/// Filters a row of FIT_RGBF / FIT_RGBAF pixels horizontally, floatspp is 3 or 4
+	void (*horizontalFloat)(CWeightsTable &weightsTable, const float *src_bits, unsigned floatspp, float *dst_bits, unsigned dst_width);
+	/// Filters the row dst_pos of 'count' float samples vertically
+	void (*verticalFloat)(CWeightsTable &weightsTable, unsigned dst_pos, const float *src_base, unsigned src_pitch, unsigned count, float *dst_bits);
+} ResizeKernels;
+
+#ifdef FI_HAS_SSE2
+
+/**
+Loads the fixed point weights of two neighboring pixels into a 32-bit integer
+*/
+static inline int
+LoadWeightPair(const short *weights) {
+	int pair;
+	memcpy(&pair, weights, sizeof(pair));
+	return pair;
+}
+
+/**
+Loads a FIT_RGBF or FIT_RGBAF pixel, the alpha lane of a FIT_RGBF pixel is zero
+*/
+static inline __m128
+LoadFloatPixel(const float *pixel, unsigned floatspp) {
+	if (floatspp == 4) {
+		return _mm_loadu_ps(pixel);
+	}
+	return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double *)pixel)), _mm_load_ss(pixel + 2));
+}
+
+/**
+Stores a FIT_RGBF or FIT_RGBAF pixel
+*/
+static inline void
+StoreFloatPixel(float *pixel, unsigned floatspp, __m128 value) {
+	if (floatspp == 4) {
+		_mm_storeu_ps(pixel, value);
+	} else {
+		_mm_storel_pi((__m64 *)pixel, value);
+		_mm_store_ss(pixel + 2, _mm_movehl_ps(value, value));
+	}
+}
+
+/**
+Adds the fixed point products of the pixels [i, iLimit) of a window to the channel sums
+*/
+static inline void
+AccumulateTail8(const short *weights, const BYTE *pixel, unsigned bytespp, unsigned i, unsigned iLimit, int *sums) {
+	for (; i < iLimit; i++) {
+		const int weight = weights[i];
+		const BYTE *bits = pixel + i * bytespp;
+		for (unsigned c = 0; c < bytespp; c++) {
+			sums[c] += (weight * bits[c]);
+		}
+	}
+}
+
+/**
+Rounds, clamps and stores the channel sums of a destination pixel
+*/
+static inline void
+StoreSums8(int *sums, unsigned bytespp, BYTE *dst_bits) {
+	if (bytespp == 1) {
+		sums[0] += sums[1] + sums[2] + sums[3];
+	}
+	for (unsigned c = 0; c < bytespp; c++) {
+		dst_bits[c] = (BYTE)CLAMP<int>(RoundFixed(sums[c]), 0, 0xFF);
+	}
+}
+
+/**
+Sums the fixed point products of pixels [i, iLimit) of a window with SSE2, 
+stopping at the first group of pixels that would read past the source line. 
+Greyscale sums are spread over the four lanes of 'sum'. 
+@return Returns the index of the first pixel not accumulated
+*/
+static inline unsigned
+Accumulate8_SSE2(const short *weights, const BYTE *pixel, unsigned bytespp, unsigned i, unsigned iLimit, unsigned iSafe, __m128i &sum) {
+	const __m128i zero = _mm_setzero_si128();
+
+	// windows are zero padded to a multiple of 8 weights, so that a group of pixels 
+	// may run past iLimit as long as it stays within the source line
+	switch (bytespp) {
+		case 1:
+			for (; (i < iLimit) && (i + 8 <= iSafe); i += 8) {
+				const __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pixel + i)), zero);
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(p, _mm_load_si128((const __m128i *)(weights + i))));
+			}
+			break;
+
+		case 3:
+			for (; (i < iLimit) && (3 * i + 8 <= 3 * iSafe); i += 2) {
+				// b0 g0 r0 b1 g1 r1 x x -> b0 b1 g0 g1 r0 r1 (the last lane is ignored)
+				const __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pixel + 3 * i)), zero);
+				const __m128i pairs = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 6));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, _mm_set1_epi32(LoadWeightPair(weights + i))));
+			}
+			break;
+
+		case 4:
+			for (; (i < iLimit) && (i + 4 <= iSafe); i += 4) {
+				// b0 g0 r0 a0 b1 g1 r1 a1 -> b0 b1 g0 g1 r0 r1 a0 a1
+				const __m128i p = _mm_loadu_si128((const __m128i *)(pixel + 4 * i));
+				const __m128i w = _mm_loadl_epi64((const __m128i *)(weights + i));
+				const __m128i lo = _mm_unpacklo_epi8(p, zero);
+				const __m128i hi = _mm_unpackhi_epi8(p, zero);
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(lo, _mm_srli_si128(lo, 8)), _mm_shuffle_epi32(w, 0x00)));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(hi, _mm_srli_si128(hi, 8)), _mm_shuffle_epi32(w, 0x55)));
+			}
+			break;
+	}
+	return i;
+}
+
+/**
+Filters 16 samples of a column strip with SSE2 and stores them
+*/
+static inline void
+Filter16_SSE2(const short *weights, const BYTE *src_bits, unsigned src_pitch, unsigned iLimit, BYTE *dst_bits) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32(FI_WEIGHT_ONE >> 1);
+	__m128i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+
+	// interleave two source rows so that each multiply-add sums two weighted samples
+	for (unsigned i = 0; i < iLimit; i += 2) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)src_bits);
+		const __m128i b = (i + 1 < iLimit) ? _mm_loadu_si128((const __m128i *)(src_bits + src_pitch)) : zero;
+		const __m128i w = _mm_set1_epi32(LoadWeightPair(weights + i));
+		const __m128i lo = _mm_unpacklo_epi8(a, b);
+		const __m128i hi = _mm_unpackhi_epi8(a, b);
+		s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+		s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+		s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+		s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+		src_bits += 2 * src_pitch;
+	}
+
+	// round, then clamp through the saturating packs
+	s0 = _mm_srai_epi32(_mm_add_epi32(s0, half), FI_WEIGHT_BITS);
+	s1 = _mm_srai_epi32(_mm_add_epi32(s1, half), FI_WEIGHT_BITS);
+	s2 = _mm_srai_epi32(_mm_add_epi32(s2, half), FI_WEIGHT_BITS);
+	s3 = _mm_srai_epi32(_mm_add_epi32(s3, half), FI_WEIGHT_BITS);
+	_mm_storeu_si128((__m128i *)dst_bits, _mm_packus_epi16(_mm_packs_epi32(s0, s1), _mm_packs_epi32(s2, s3)));
+}
+
+/**
+Filters 8 float samples of a column strip with SSE2 and stores them
+*/
+static inline void
+FilterFloat8_SSE2(CWeightsTable &weightsTable, unsigned dst_pos, const float *src_bits, unsigned src_pitch, unsigned iLimit, float *dst_bits) {
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd(), s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+
+	for (unsigned i = 0; i < iLimit; i++) {
+		const __m128d weight = _mm_set1_pd(weightsTable.getWeight(dst_pos, i));
+		const __m128 p0 = _mm_loadu_ps(src_bits);
+		const __m128 p1 = _mm_loadu_ps(src_bits + 4);
+		s0 = _mm_add_pd(s0, _mm_mul_pd(weight, _mm_cvtps_pd(p0)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(weight, _mm_cvtps_pd(_mm_movehl_ps(p0, p0))));
+		s2 = _mm_add_pd(s2, _mm_mul_pd(weight, _mm_cvtps_pd(p1)));
+		s3 = _mm_add_pd(s3, _mm_mul_pd(weight, _mm_cvtps_pd(_mm_movehl_ps(p1, p1))));
+		src_bits += src_pitch;
+	}
+	_mm_storeu_ps(dst_bits, _mm_movelh_ps(_mm_cvtpd_ps(s0), _mm_cvtpd_ps(s1)));
+	_mm_storeu_ps(dst_bits + 4, _mm_movelh_ps(_mm_cvtpd_ps(s2), _mm_cvtpd_ps(s3)));
+}
+
+/**
+Filters the float samples [x, count) of a row with scalar code
+*/
+static inline void
+FilterFloatTail(CWeightsTable &weightsTable, unsigned dst_pos, const float *src_bits, unsigned src_pitch, unsigned iLimit, unsigned x, unsigned count, float *dst_bits) {
+	for (; x < count; x++) {
+		const float *bits = src_bits + x;
+		double value = 0;
+		for (unsigned i = 0; i < iLimit; i++) {
+			value += (weightsTable.getWeight(dst_pos, i) * (double)*bits);
+			bits += src_pitch;
+		}
+		dst_bits[x] = (float)value;
+	}
+}
+
+/**
+Filters the 8-bit samples [x, count) of a row with scalar code
+*/
+static inline void
+Filter8Tail(const short *weights, const BYTE *src_bits, unsigned src_pitch, unsigned iLimit, unsigned x, unsigned count, BYTE *dst_bits) {
+	for (; x < count; x++) {
+		const BYTE *bits = src_bits + x;
+		int value = 0;
+		for (unsigned i = 0; i < iLimit; i++) {
+			value += (weights[i] * *bits);
+			bits += src_pitch;
+		}
+		dst_bits[x] = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
+	}
+}
+
+static void
+HorizontalFilter8_SSE2(CWeightsTable &weightsTable, const BYTE *src_bits, unsigned src_width, unsigned bytespp, BYTE *dst_bits, unsigned dst_width) {
+	for (unsigned x = 0; x < dst_width; x++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(x);
+		const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+		const short *weights = weightsTable.getFixedWeights(x);
+		const BYTE *pixel = src_bits + iLeft * bytespp;
+		__m128i sum = _mm_setzero_si128();
+
+		const unsigned i = Accumulate8_SSE2(weights, pixel, bytespp, 0, iLimit, src_width - iLeft, sum);
+
+		int sums[4];
+		_mm_storeu_si128((__m128i *)sums, sum);
+		AccumulateTail8(weights, pixel, bytespp, i, iLimit, sums);
+		StoreSums8(sums, bytespp, dst_bits);
+		dst_bits += bytespp;
+	}
+}
+
+static void
+VerticalFilter8_SSE2(CWeightsTable &weightsTable, unsigned dst_pos, const BYTE *src_base, unsigned src_pitch, unsigned count, BYTE *dst_bits) {
+	const unsigned iLeft = weightsTable.getLeftBoundary(dst_pos);
+	const unsigned iLimit = weightsTable.getRightBoundary(dst_pos) - iLeft;
+	const short *weights = weightsTable.getFixedWeights(dst_pos);
+	const BYTE *src_bits = src_base + iLeft * src_pitch;
+	unsigned x = 0;
+
+	for (; x + 16 <= count; x += 16) {
+		Filter16_SSE2(weights, src_bits + x, src_pitch, iLimit, dst_bits + x);
+	}
+	Filter8Tail(weights, src_bits, src_pitch, iLimit, x, count, dst_bits);
+}
+
+static void
+HorizontalFilterFloat_SSE2(CWeightsTable &weightsTable, const float *src_bits, unsigned floatspp, float *dst_bits, unsigned dst_width) {
+	for (unsigned x = 0; x < dst_width; x++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(x);
+		const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+		const float *pixel = src_bits + iLeft * floatspp;
+		__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+
+		for (unsigned i = 0; i < iLimit; i++) {
+			const __m128d weight = _mm_set1_pd(weightsTable.getWeight(x, i));
+			const __m128 p = LoadFloatPixel(pixel, floatspp);
+			s0 = _mm_add_pd(s0, _mm_mul_pd(weight, _mm_cvtps_pd(p)));
+			s1 = _mm_add_pd(s1, _mm_mul_pd(weight, _mm_cvtps_pd(_mm_movehl_ps(p, p))));
+			pixel += floatspp;
+		}
+		StoreFloatPixel(dst_bits, floatspp, _mm_movelh_ps(_mm_cvtpd_ps(s0), _mm_cvtpd_ps(s1)));
+		dst_bits += floatspp;
+	}
+}
+
+static void
+VerticalFilterFloat_SSE2(CWeightsTable &weightsTable, unsigned dst_pos, const float *src_base, unsigned src_pitch, unsigned count, float *dst_bits) {
+	const unsigned iLeft = weightsTable.getLeftBoundary(dst_pos);
+	const unsigned iLimit = weightsTable.getRightBoundary(dst_pos) - iLeft;
+	const float *src_bits = src_base + iLeft * src_pitch;
+	unsigned x = 0;
+
+	for (; x + 8 <= count; x += 8) {
+		FilterFloat8_SSE2(weightsTable, dst_pos, src_bits + x, src_pitch, iLimit, dst_bits + x);
+	}
+	FilterFloatTail(weightsTable, dst_pos, src_bits, src_pitch, iLimit, x, count, dst_bits);
+}
+
+#ifdef FI_HAS_AVX2
+
+FI_TARGET_AVX2 static void
+HorizontalFilter8_AVX2(CWeightsTable &weightsTable, const BYTE *src_bits, unsigned src_width, unsigned bytespp, BYTE *dst_bits, unsigned dst_width) {
+	// pairs up the channels of two pixels: 4 pixels of 24-bit or 32-bit samples per 256-bit register
+	const __m128i shuffle = (bytespp == 3) ?
+		_mm_setr_epi8(0, 3, 1, 4, 2, 5, -1, -1, 6, 9, 7, 10, 8, 11, -1, -1) :
+		_mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+	const __m256i pair_index = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+
+	for (unsigned x = 0; x < dst_width; x++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(x);
+		const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+		const unsigned iSafe = src_width - iLeft;
+		const short *weights = weightsTable.getFixedWeights(x);
+		const BYTE *pixel = src_bits + iLeft * bytespp;
+		__m256i sum256 = _mm256_setzero_si256();
+		unsigned i = 0;
+
+		if (bytespp == 1) {
+			for (; (i + 16 <= iLimit) && (i + 16 <= iSafe); i += 16) {
+				const __m256i p = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(pixel + i)));
+				sum256 = _mm256_add_epi32(sum256, _mm256_madd_epi16(p, _mm256_loadu_si256((const __m256i *)(weights + i))));
+			}
+		} else {
+			for (; (i < iLimit) && (bytespp * i + 16 <= bytespp * iSafe); i += 4) {
+				const __m256i p = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(pixel + bytespp * i)), shuffle));
+				const __m256i w = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)(weights + i))), pair_index);
+				sum256 = _mm256_add_epi32(sum256, _mm256_madd_epi16(p, w));
+			}
+		}
+		__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sum256), _mm256_extracti128_si256(sum256, 1));
+
+		i = Accumulate8_SSE2(weights, pixel, bytespp, i, iLimit, iSafe, sum);
+
+		int sums[4];
+		_mm_storeu_si128((__m128i *)sums, sum);
+		AccumulateTail8(weights, pixel, bytespp, i, iLimit, sums);
+		StoreSums8(sums, bytespp, dst_bits);
+		dst_bits += bytespp;
+	}
+}
+
+FI_TARGET_AVX2 static void
+VerticalFilter8_AVX2(CWeightsTable &weightsTable, unsigned dst_pos, const BYTE *src_base, unsigned src_pitch, unsigned count, BYTE *dst_bits) {
+	const unsigned iLeft = weightsTable.getLeftBoundary(dst_pos);
+	const unsigned iLimit = weightsTable.getRightBoundary(dst_pos) - iLeft;
+	const short *weights = weightsTable.getFixedWeights(dst_pos);
+	const BYTE *src_bits = src_base + iLeft * src_pitch;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i half = _mm256_set1_epi32(FI_WEIGHT_ONE >> 1);
+	unsigned x = 0;
+
+	for (; x + 32 <= count; x += 32) {
+		const BYTE *bits = src_bits + x;
+		__m256i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+
+		// the unpacks and the packs both work within 128-bit lanes, so the samples keep their order
+		for (unsigned i = 0; i < iLimit; i += 2) {
+			const __m256i a = _mm256_loadu_si256((const __m256i *)bits);
+			const __m256i b = (i + 1 < iLimit) ? _mm256_loadu_si256((const __m256i *)(bits + src_pitch)) : zero;
+			const __m256i w = _mm256_set1_epi32(LoadWeightPair(weights + i));
+			const __m256i lo = _mm256_unpacklo_epi8(a, b);
+			const __m256i hi = _mm256_unpackhi_epi8(a, b);
+			s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+			s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+			s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+			s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+			bits += 2 * src_pitch;
+		}
+
+		s0 = _mm256_srai_epi32(_mm256_add_epi32(s0, half), FI_WEIGHT_BITS);
+		s1 = _mm256_srai_epi32(_mm256_add_epi32(s1, half), FI_WEIGHT_BITS);
+		s2 = _mm256_srai_epi32(_mm256_add_epi32(s2, half), FI_WEIGHT_BITS);
+		s3 = _mm256_srai_epi32(_mm256_add_epi32(s3, half), FI_WEIGHT_BITS);
+		_mm256_storeu_si256((__m256i *)(dst_bits + x), _mm256_packus_epi16(_mm256_packs_epi32(s0, s1), _mm256_packs_epi32(s2, s3)));
+	}
+	for (; x + 16 <= count; x += 16) {
+		Filter16_SSE2(weights, src_bits + x, src_pitch, iLimit, dst_bits + x);
+	}
+	Filter8Tail(weights, src_bits, src_pitch, iLimit, x, count, dst_bits);
+}
+
+FI_TARGET_AVX2 static void
+HorizontalFilterFloat_AVX2(CWeightsTable &weightsTable, const float *src_bits, unsigned floatspp, float *dst_bits, unsigned dst_width) {
+	for (unsigned x = 0; x < dst_width; x++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(x);
+		const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+		const float *pixel = src_bits + iLeft * floatspp;
+		__m256d sum = _mm256_setzero_pd();
+
+		for (unsigned i = 0; i < iLimit; i++) {
+			const __m256d weight = _mm256_set1_pd(weightsTable.getWeight(x, i));
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(weight, _mm256_cvtps_pd(LoadFloatPixel(pixel, floatspp))));
+			pixel += floatspp;
+		}
+		StoreFloatPixel(dst_bits, floatspp, _mm256_cvtpd_ps(sum));
+		dst_bits += floatspp;
+	}
+}
+
+FI_TARGET_AVX2 static void
+VerticalFilterFloat_AVX2(CWeightsTable &weightsTable, unsigned dst_pos, const float *src_base, unsigned src_pitch, unsigned count, float *dst_bits) {
+	const unsigned iLeft = weightsTable.getLeftBoundary(dst_pos);
+	const unsigned iLimit = weightsTable.getRightBoundary(dst_pos) - iLeft;
+	const float *src_bits = src_base + iLeft * src_pitch;
+	unsigned x = 0;
+
+	for (; x + 16 <= count; x += 16) {
+		const float *bits = src_bits + x;
+		__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+
+		for (unsigned i = 0; i < iLimit; i++) {
+			const __m256d weight = _mm256_set1_pd(weightsTable.getWeight(dst_pos, i));
+			s0 = _mm256_add_pd(s0, _mm256_mul_pd(weight, _mm256_cvtps_pd(_mm_loadu_ps(bits))));
+			s1 = _mm256_add_pd(s1, _mm256_mul_pd(weight, _mm256_cvtps_pd(_mm_loadu_ps(bits + 4))));
+			s2 = _mm256_add_pd(s2, _mm256_mul_pd(weight, _mm256_cvtps_pd(_mm_loadu_ps(bits + 8))));
+			s3 = _mm256_add_pd(s3, _mm256_mul_pd(weight, _mm256_cvtps_pd(_mm_loadu_ps(bits + 12))));
+			bits += src_pitch;
+		}
+		_mm256_storeu_ps(dst_bits + x, _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(s0)), _mm256_cvtpd_ps(s1), 1));
+		_mm256_storeu_ps(dst_bits + x + 8, _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(s2)), _mm256_cvtpd_ps(s3), 1));
+	}
+	for (; x + 8 <= count; x += 8) {
+		FilterFloat8_SSE2(weightsTable, dst_pos, src_bits + x, src_pitch, iLimit, dst_bits + x);
+	}
+	FilterFloatTail(weightsTable, dst_pos, src_bits, src_pitch, iLimit, x, count, dst_bits);
+}
+
+#endif // FI_HAS_AVX2
+
+#endif // FI_HAS_SSE2
+
+/**
+Returns the SIMD kernels supported by the processor and allowed by FreeImage_SetSIMDLevel, 
+or NULL for the scalar filters
+*/
+static const ResizeKernels*
+GetResizeKernels() {
+#ifdef FI_HAS_SSE2
+	static const ResizeKernels sse2_kernels = {
+		HorizontalFilter8_SSE2, VerticalFilter8_SSE2, HorizontalFilterFloat_SSE2, VerticalFilterFloat_SSE2
+	};
+#ifdef FI_HAS_AVX2
+	static const ResizeKernels avx2_kernels = {
+		HorizontalFilter8_AVX2, VerticalFilter8_AVX2, HorizontalFilterFloat_AVX2, VerticalFilterFloat_AVX2
+	};
+	if (HasAVX2()) {
+		return &avx2_kernels;
 	}
-	// free list of pixels contributions
-	free(m_WeightTable);
+#endif
+	return HasSSE2() ? &sse2_kernels : NULL;
+#else
+	return NULL;
+#endif
 }
 
 // --------------------------------------------------------------------------
 
-FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags) {
+FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags, FIBITMAP *into) {
 
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 	const unsigned src_bpp = FreeImage_GetBPP(src);
@@ -286,7 +911,31 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 		dst_bpp_s1 = dst_bpp;
 	}
 
+	// a caller provided destination image must have the layout we would allocate
+	if (into) {
+		if ((FreeImage_GetImageType(into) != image_type) || (FreeImage_GetBPP(into) != dst_bpp) 
+			|| (FreeImage_GetWidth(into) != dst_width) || (FreeImage_GetHeight(into) != dst_height)) {
+			return NULL;
+		}
+	}
+
 	// early exit if destination size is equal to source size
+	if (into && (src_width == dst_width) && (src_height == dst_height)) {
+		// only a copy of the source rectangle is needed (no conversion, since src_bpp == dst_bpp 
+		// can only happen for 8-bit and higher bit depths)
+		if (src_bpp != dst_bpp) {
+			return NULL;
+		}
+		const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+		const unsigned src_offset_y = FreeImage_GetHeight(src) - src_height - src_top;
+		for (unsigned y = 0; y < dst_height; y++) {
+			memcpy(FreeImage_GetScanLine(into, y), FreeImage_GetScanLine(src, src_offset_y + y) + src_left * bytespp, dst_width * bytespp);
+		}
+		if (dst_bpp == 8) {
+			memcpy(FreeImage_GetPalette(into), FreeImage_GetPalette(src), 256 * sizeof(RGBQUAD));
+		}
+		return into;
+	}
 	if ((src_width == dst_width) && (src_height == dst_height)) {
 		FIBITMAP *out = src;
 		FIBITMAP *tmp = src;
@@ -334,7 +983,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	}
 
 	// allocate the dst image
-	FIBITMAP *dst = FreeImage_AllocateT(image_type, dst_width, dst_height, dst_bpp, 0, 0, 0);
+	FIBITMAP *dst = into ? into : FreeImage_AllocateT(image_type, dst_width, dst_height, dst_bpp, 0, 0, 0);
 	if (!dst) {
 		return NULL;
 	}
@@ -344,7 +993,10 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 		if (color_type == FIC_MINISWHITE) {
 			// build an inverted greyscale palette
 			CREATE_GREYSCALE_PALETTE_REVERSE(dst_pal, 256);
-		} 
+		} else if (dst == into) {
+			// a caller provided image may come with any palette
+			CREATE_GREYSCALE_PALETTE(dst_pal, 256);
+		}
 		/*
 		else {
 			// build a default greyscale palette
@@ -360,6 +1012,8 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	unsigned src_offset_x = src_left;
 	unsigned src_offset_y = FreeImage_GetHeight(src) - src_height - src_top;
 
+	BOOL bResult = TRUE;
+
 	/*
 	Decide which filtering order (xy or yx) is faster for this mapping. 
 	--- The theory ---
@@ -392,7 +1046,9 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 				// a temporary image
 				tmp = FreeImage_AllocateT(image_type, dst_width, src_height, dst_bpp_s1, 0, 0, 0);
 				if (!tmp) {
-					FreeImage_Unload(dst);
+					if (dst != into) {
+						FreeImage_Unload(dst);
+					}
 					return NULL;
 				}
 			} else {
@@ -403,7 +1059,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 
 			// scale source image horizontally into temporary (or destination) image
-			horizontalFilter(src, src_height, src_width, src_offset_x, src_offset_y, src_pal, tmp, dst_width);
+			bResult = horizontalFilter(src, src_height, src_width, src_offset_x, src_offset_y, src_pal, tmp, dst_width);
 
 			// set x and y offsets to zero for the second filter method
 			// invocation (the temporary image only contains the portion of
@@ -423,10 +1079,10 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			tmp = src;
 		}
 
-		if (src_height != dst_height) {
+		if (bResult && (src_height != dst_height)) {
 			// source and destination heights are different so, scale
 			// temporary (or source) image vertically into destination image
-			verticalFilter(tmp, dst_width, src_height, src_offset_x, src_offset_y, src_pal, dst, dst_height);
+			bResult = verticalFilter(tmp, dst_width, src_height, src_offset_x, src_offset_y, src_pal, dst, dst_height);
 		}
 
 		// free temporary image, if not pointing to either src or dst
@@ -458,7 +1114,9 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 				// a temporary image
 				tmp = FreeImage_AllocateT(image_type, src_width, dst_height, dst_bpp_s1, 0, 0, 0);
 				if (!tmp) {
-					FreeImage_Unload(dst);
+					if (dst != into) {
+						FreeImage_Unload(dst);
+					}
 					return NULL;
 				}
 			} else {
@@ -469,7 +1127,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 
 			// scale source image vertically into temporary (or destination) image
-			verticalFilter(src, src_width, src_height, src_offset_x, src_offset_y, src_pal, tmp, dst_height);
+			bResult = verticalFilter(src, src_width, src_height, src_offset_x, src_offset_y, src_pal, tmp, dst_height);
 
 			// set x and y offsets to zero for the second filter method
 			// invocation (the temporary image only contains the portion of
@@ -490,10 +1148,10 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			tmp = src;
 		}
 
-		if (src_width != dst_width) {
+		if (bResult && (src_width != dst_width)) {
 			// source and destination heights are different so, scale
 			// temporary (or source) image horizontally into destination image
-			horizontalFilter(tmp, dst_height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
+			bResult = horizontalFilter(tmp, dst_height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
 		}
 
 		// free temporary image, if not pointing to either src or dst
@@ -502,13 +1160,186 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 		}
 	}
 
+	if (!bResult) {
+		// the weights could not be allocated
+		if (dst != into) {
+			FreeImage_Unload(dst);
+		}
+		return NULL;
+	}
+
 	return dst;
 } 
 
-void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
+BOOL CResizeEngine::scaleStream(FREE_IMAGE_TYPE image_type, unsigned bpp, unsigned width, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, FI_RescaleReadProc read, FI_RescaleWriteProc write, void *data) {
+
+	// the rows are filtered as they are, palettized and packed bitmaps would need a conversion
+	unsigned bytespp;
+	switch (image_type) {
+		case FIT_BITMAP:
+			if ((bpp != 8) && (bpp != 24) && (bpp != 32)) {
+				return FALSE;
+			}
+			bytespp = bpp / 8;
+			break;
+		case FIT_UINT16:
+			bytespp = sizeof(WORD);
+			break;
+		case FIT_FLOAT:
+			bytespp = sizeof(float);
+			break;
+		case FIT_RGB16:
+			bytespp = sizeof(FIRGB16);
+			break;
+		case FIT_RGBA16:
+			bytespp = sizeof(FIRGBA16);
+			break;
+		case FIT_RGBF:
+			bytespp = sizeof(FIRGBF);
+			break;
+		case FIT_RGBAF:
+			bytespp = sizeof(FIRGBAF);
+			break;
+		default:
+			return FALSE;
+	}
+
+	// retrieve the contributions of the passes needed
+	std::shared_ptr<CWeightsTable> htable, vtable;
+	if (src_width != dst_width) {
+		htable = CWeightsCache::getTable(m_pFilter, dst_width, src_width);
+	}
+	if (src_height != dst_height) {
+		vtable = CWeightsCache::getTable(m_pFilter, dst_height, src_height);
+	}
+
+	// source rows are read in batches (filtered horizontally into hband), the window keeps the 
+	// filtered rows still needed by the vertical pass, which filters bands of rows into out
+	const unsigned batch = CLAMP<unsigned>(FI_RESIZE_STREAM_BYTES / (width * bytespp), 1, FI_RESIZE_STREAM_ROWS);
+	const unsigned capacity = vtable ? 2 * vtable->getWindowSize() + FI_RESIZE_STREAM_ROWS : 0;
 
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_width, src_width);
+	FIBITMAP *in = FreeImage_AllocateT(image_type, width, batch, bpp, 0, 0, 0);
+	FIBITMAP *hband = htable ? FreeImage_AllocateT(image_type, dst_width, batch, bpp, 0, 0, 0) : NULL;
+	FIBITMAP *window = vtable ? FreeImage_AllocateT(image_type, dst_width, capacity, bpp, 0, 0, 0) : NULL;
+	FIBITMAP *out = vtable ? FreeImage_AllocateT(image_type, dst_width, FI_RESIZE_STREAM_ROWS, bpp, 0, 0, 0) : NULL;
+
+	BOOL bResult = ((src_width == dst_width) || htable) && ((src_height == dst_height) || vtable);
+	bResult = bResult && in && (hband || !htable) && (window || !vtable) && (out || !vtable);
+
+	// skip the rows above the rectangle
+	for (unsigned y = 0; bResult && (y < src_top); y++) {
+		bResult = read(data, y, FreeImage_GetScanLine(in, 0));
+	}
+
+	const unsigned dst_line = dst_width * bytespp;
+	unsigned next = 0;		// next row of the rectangle to read
+	unsigned base = 0;		// row of the rectangle held by the first row of the window
+	unsigned count = 0;		// number of rows held by the window
+
+	// reads the rows of the rectangle up to 'last' (excluded), writing them out if 
+	// there is no vertical pass, or adding them to the window otherwise
+	auto fetch = [&](unsigned last) -> BOOL {
+		while (next < last) {
+			const unsigned rows = MIN(batch, last - next);
+			for (unsigned i = 0; i < rows; i++) {
+				if (!read(data, src_top + next + i, FreeImage_GetScanLine(in, i))) {
+					return FALSE;
+				}
+			}
+			FIBITMAP *filtered = in;
+			unsigned offset = src_left * bytespp;
+			if (htable) {
+				horizontalFilter(*htable, in, rows, src_width, src_left, 0, NULL, hband, dst_width);
+				filtered = hband;
+				offset = 0;
+			}
+			for (unsigned i = 0; i < rows; i++, next++) {
+				const BYTE *bits = FreeImage_GetScanLine(filtered, i) + offset;
+				if (!vtable) {
+					if (!write(data, next, bits)) {
+						return FALSE;
+					}
+				} else if (next >= base) {
+					// rows before the window are not used by any destination row
+					memcpy(FreeImage_GetScanLine(window, next - base), bits, dst_line);
+					count = next + 1 - base;
+				}
+			}
+		}
+		return TRUE;
+	};
+
+	if (bResult && !vtable) {
+		bResult = fetch(src_height);
+	}
+
+	for (unsigned top = 0, bottom; bResult && vtable && (top < dst_height); top = bottom) {
+		// the band of destination rows [top, bottom) reads the rows [left, right) of the window
+		const unsigned left = vtable->getLeftBoundary(top);
+		unsigned right = vtable->getRightBoundary(top);
+		for (bottom = top + 1; (bottom < dst_height) && (bottom - top < FI_RESIZE_STREAM_ROWS); bottom++) {
+			const unsigned band_right = MAX(right, vtable->getRightBoundary(bottom));
+			if (band_right - left > capacity) {
+				break;
+			}
+			right = band_right;
+		}
+
+		// drop the rows above the band, moving the others to the top of the window
+		if (base < left) {
+			const unsigned drop = MIN(left - base, count);
+			if (drop < count) {
+				memmove(FreeImage_GetScanLine(window, 0), FreeImage_GetScanLine(window, drop), (count - drop) * FreeImage_GetPitch(window));
+			}
+			count -= drop;
+			base = count ? base + drop : left;
+		}
+
+		bResult = fetch(right);
+		if (bResult) {
+			CWeightsTable view(*vtable, top, bottom, base);
+			bResult = view.isValid();
+			if (bResult) {
+				verticalFilter(view, window, dst_width, 0, 0, NULL, out, bottom - top);
+			}
+			for (unsigned y = top; bResult && (y < bottom); y++) {
+				bResult = write(data, y, FreeImage_GetScanLine(out, y - top));
+			}
+		}
+	}
+
+	FreeImage_Unload(in);
+	FreeImage_Unload(hband);
+	FreeImage_Unload(window);
+	FreeImage_Unload(out);
+
+	return bResult;
+}
+
+BOOL CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
+
+	// retrieve the contributions, calculated once per geometry
+	std::shared_ptr<CWeightsTable> table = CWeightsCache::getTable(m_pFilter, dst_width, src_width);
+	if (!table) {
+		return FALSE;
+	}
+	horizontalFilter(*table, src, height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
+	return TRUE;
+}
+
+/// Performs horizontal image filtering with the given weights table
+void CResizeEngine::horizontalFilter(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
+
+	// filter bands of rows, each band only writes its own rows of dst
+	FreeImage_ParallelFor(height, m_Threads, 1 + FI_RESIZE_BAND_PIXELS / dst_width, [&](unsigned first, unsigned last) {
+		horizontalFilterRows(weightsTable, src, first, last, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
+	});
+}
+
+/// Performs horizontal image filtering of the rows [first, last)
+void CResizeEngine::horizontalFilterRows(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned first, unsigned last, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
+
+	const ResizeKernels *const kernels = GetResizeKernels();
 
 	// step through rows
 	switch(FreeImage_GetImageType(src)) {
@@ -524,7 +1355,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -533,22 +1364,22 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										// loop through row
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);		// retrieve left boundary
 										const unsigned iRight = weightsTable.getRightBoundary(x);	// retrieve right boundary
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = iLeft; i < iRight; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
 											const unsigned pixel = (src_bits[i >> 3] & (0x80 >> (i & 0x07))) != 0;
-											value += (weightsTable.getWeight(x, i - iLeft) * (double)*(BYTE *)&src_pal[pixel]);
+											value += (weightsTable.getFixedWeight(x, i - iLeft) * *(BYTE *)&src_pal[pixel]);
 										}
 
 										// clamp and place result in destination pixel
-										dst_bits[x] = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										dst_bits[x] = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -557,18 +1388,18 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										// loop through row
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);		// retrieve left boundary
 										const unsigned iRight = weightsTable.getRightBoundary(x);	// retrieve right boundary
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = iLeft; i < iRight; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
 											const unsigned pixel = (src_bits[i >> 3] & (0x80 >> (i & 0x07))) != 0;
-											value += (weightsTable.getWeight(x, i - iLeft) * (double)pixel);
+											value += (weightsTable.getFixedWeight(x, i - iLeft) * pixel);
 										}
 										value *= 0xFF;
 
 										// clamp and place result in destination pixel
-										dst_bits[x] = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										dst_bits[x] = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 									}
 								}
 							}
@@ -581,7 +1412,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -590,29 +1421,29 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										// loop through row
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
 										const unsigned iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-										double r = 0, g = 0, b = 0;
+										int r = 0, g = 0, b = 0;
 
 										for (unsigned i = iLeft; i < iRight; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											const double weight = weightsTable.getWeight(x, i - iLeft);
+											const int weight = weightsTable.getFixedWeight(x, i - iLeft);
 											const unsigned pixel = (src_bits[i >> 3] & (0x80 >> (i & 0x07))) != 0;
 											const BYTE * const entry = (BYTE *)&src_pal[pixel];
-											r += (weight * (double)entry[FI_RGBA_RED]);
-											g += (weight * (double)entry[FI_RGBA_GREEN]);
-											b += (weight * (double)entry[FI_RGBA_BLUE]);
+											r += (weight * entry[FI_RGBA_RED]);
+											g += (weight * entry[FI_RGBA_GREEN]);
+											b += (weight * entry[FI_RGBA_BLUE]);
 										}
 
 										// clamp and place result in destination pixel
-										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
+										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 										dst_bits += 3;
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -621,18 +1452,18 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										// loop through row
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
 										const unsigned iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = iLeft; i < iRight; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
 											const unsigned pixel = (src_bits[i >> 3] & (0x80 >> (i & 0x07))) != 0;
-											value += (weightsTable.getWeight(x, i - iLeft) * (double)pixel);
+											value += (weightsTable.getFixedWeight(x, i - iLeft) * pixel);
 										}
 										value *= 0xFF;
 
 										// clamp and place result in destination pixel
-										const BYTE bval = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										const BYTE bval = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits[FI_RGBA_RED]	= bval;
 										dst_bits[FI_RGBA_GREEN]	= bval;
 										dst_bits[FI_RGBA_BLUE]	= bval;
@@ -649,7 +1480,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette here
 							src_offset_x >>= 3;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first; y < last; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -658,25 +1489,25 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 									// loop through row
 									const unsigned iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
 									const unsigned iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-									double r = 0, g = 0, b = 0, a = 0;
+									int r = 0, g = 0, b = 0, a = 0;
 
 									for (unsigned i = iLeft; i < iRight; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(x, i - iLeft);
+										const int weight = weightsTable.getFixedWeight(x, i - iLeft);
 										const unsigned pixel = (src_bits[i >> 3] & (0x80 >> (i & 0x07))) != 0;
 										const BYTE * const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
-										a += (weight * (double)entry[FI_RGBA_ALPHA]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
+										a += (weight * entry[FI_RGBA_ALPHA]);
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int)(a + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 									dst_bits += 4;
 								}
 							}
@@ -695,7 +1526,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first; y < last; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -704,17 +1535,17 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 									// loop through row
 									const unsigned iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
 									const unsigned iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-									double value = 0;
+									int value = 0;
 
 									for (unsigned i = iLeft; i < iRight; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
 										const unsigned pixel = i & 0x01 ? src_bits[i >> 1] & 0x0F : src_bits[i >> 1] >> 4;
-										value += (weightsTable.getWeight(x, i - iLeft) * (double)*(BYTE *)&src_pal[pixel]);
+										value += (weightsTable.getFixedWeight(x, i - iLeft) * *(BYTE *)&src_pal[pixel]);
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[x] = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+									dst_bits[x] = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 								}
 							}
 						}
@@ -726,7 +1557,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first; y < last; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -735,23 +1566,23 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 									// loop through row
 									const unsigned iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
 									const unsigned iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-									double r = 0, g = 0, b = 0;
+									int r = 0, g = 0, b = 0;
 
 									for (unsigned i = iLeft; i < iRight; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(x, i - iLeft);
+										const int weight = weightsTable.getFixedWeight(x, i - iLeft);
 										const unsigned pixel = i & 0x01 ? src_bits[i >> 1] & 0x0F : src_bits[i >> 1] >> 4;
 										const BYTE * const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 									dst_bits += 3;
 								}
 							}
@@ -764,7 +1595,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first; y < last; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -773,25 +1604,25 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 									// loop through row
 									const unsigned iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
 									const unsigned iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-									double r = 0, g = 0, b = 0, a = 0;
+									int r = 0, g = 0, b = 0, a = 0;
 
 									for (unsigned i = iLeft; i < iRight; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(x, i - iLeft);
+										const int weight = weightsTable.getFixedWeight(x, i - iLeft);
 										const unsigned pixel = i & 0x01 ? src_bits[i >> 1] & 0x0F : src_bits[i >> 1] >> 4;
 										const BYTE * const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
-										a += (weight * (double)entry[FI_RGBA_ALPHA]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
+										a += (weight * entry[FI_RGBA_ALPHA]);
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int)(a + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 									dst_bits += 4;
 								}
 							}
@@ -810,7 +1641,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -820,22 +1651,28 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 										const BYTE * const pixel = src_bits + iLeft;
-										double value = 0;
+										int value = 0;
 
 										// for(i = iLeft to iRight)
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(x, i) * (double)*(BYTE *)&src_pal[pixel[i]]);
+											value += (weightsTable.getFixedWeight(x, i) * *(BYTE *)&src_pal[pixel[i]]);
 										}
 
 										// clamp and place result in destination pixel
-										dst_bits[x] = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										dst_bits[x] = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								if (kernels) {
+									for (unsigned y = first; y < last; y++) {
+										kernels->horizontal8(weightsTable, FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x, src_width, 1, FreeImage_GetScanLine(dst, y), dst_width);
+									}
+									break;
+								}
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -845,17 +1682,17 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 										const BYTE * const pixel = src_bits + iLeft;
-										double value = 0;
+										int value = 0;
 
 										// for(i = iLeft to iRight)
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(x, i) * (double)pixel[i]);
+											value += (weightsTable.getFixedWeight(x, i) * pixel[i]);
 										}
 
 										// clamp and place result in destination pixel
-										dst_bits[x] = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										dst_bits[x] = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 									}
 								}
 							}
@@ -867,7 +1704,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -877,29 +1714,29 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 										const BYTE * const pixel = src_bits + iLeft;
-										double r = 0, g = 0, b = 0;
+										int r = 0, g = 0, b = 0;
 
 										// for(i = iLeft to iRight)
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											const double weight = weightsTable.getWeight(x, i);
+											const int weight = weightsTable.getFixedWeight(x, i);
 											const BYTE *const entry = (BYTE *)&src_pal[pixel[i]];
-											r += (weight * (double)entry[FI_RGBA_RED]);
-											g += (weight * (double)entry[FI_RGBA_GREEN]);
-											b += (weight * (double)entry[FI_RGBA_BLUE]);
+											r += (weight * entry[FI_RGBA_RED]);
+											g += (weight * entry[FI_RGBA_GREEN]);
+											b += (weight * entry[FI_RGBA_BLUE]);
 										}
 
 										// clamp and place result in destination pixel
-										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
+										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 										dst_bits += 3;
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first; y < last; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -909,18 +1746,18 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 										const BYTE * const pixel = src_bits + iLeft;
-										double value = 0;
+										int value = 0;
 
 										// for(i = iLeft to iRight)
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											const double weight = weightsTable.getWeight(x, i);
-											value += (weight * (double)pixel[i]);
+											const int weight = weightsTable.getFixedWeight(x, i);
+											value += (weight * pixel[i]);
 										}
 
 										// clamp and place result in destination pixel
-										const BYTE bval = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										const BYTE bval = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits[FI_RGBA_RED]	= bval;
 										dst_bits[FI_RGBA_GREEN]	= bval;
 										dst_bits[FI_RGBA_BLUE]	= bval;
@@ -935,7 +1772,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first; y < last; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -945,25 +1782,25 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 									const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 									const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 									const BYTE * const pixel = src_bits + iLeft;
-									double r = 0, g = 0, b = 0, a = 0;
+									int r = 0, g = 0, b = 0, a = 0;
 
 									// for(i = iLeft to iRight)
 									for (unsigned i = 0; i < iLimit; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(x, i);
+										const int weight = weightsTable.getFixedWeight(x, i);
 										const BYTE * const entry = (BYTE *)&src_pal[pixel[i]];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
-										a += (weight * (double)entry[FI_RGBA_ALPHA]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
+										a += (weight * entry[FI_RGBA_ALPHA]);
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int)(a + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 									dst_bits += 4;
 								}
 							}
@@ -978,9 +1815,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 					// transparently convert the 16-bit non-transparent image to 24 bpp
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = first; y < last; y++) {
 							// scale each row
-							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
 
 							for (unsigned x = 0; x < dst_width; x++) {
@@ -988,29 +1825,29 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 								const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 								const WORD *pixel = src_bits + iLeft;
-								double r = 0, g = 0, b = 0;
+								int r = 0, g = 0, b = 0;
 
 								// for(i = iLeft to iRight)
 								for (unsigned i = 0; i < iLimit; i++) {
 									// scan between boundaries
 									// accumulate weighted effect of each neighboring pixel
-									const double weight = weightsTable.getWeight(x, i);
-									r += (weight * (double)((*pixel & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT));
-									g += (weight * (double)((*pixel & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT));
-									b += (weight * (double)((*pixel & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT));
+									const int weight = weightsTable.getFixedWeight(x, i);
+									r += (weight * ((*pixel & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT));
+									g += (weight * ((*pixel & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT));
+									b += (weight * ((*pixel & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT));
 									pixel++;
 								}
 
 								// clamp and place result in destination pixel
-								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(((r * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(((g * 0xFF) / 0x3F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(((b * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
+								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed((r * 0xFF) / 0x1F), 0, 0xFF);
+								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed((g * 0xFF) / 0x3F), 0, 0xFF);
+								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed((b * 0xFF) / 0x1F), 0, 0xFF);
 								dst_bits += 3;
 							}
 						}
 					} else {
 						// image has 555 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = first; y < last; y++) {
 							// scale each row
 							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1020,23 +1857,23 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 								const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 								const WORD *pixel = src_bits + iLeft;
-								double r = 0, g = 0, b = 0;
+								int r = 0, g = 0, b = 0;
 
 								// for(i = iLeft to iRight)
 								for (unsigned i = 0; i < iLimit; i++) {
 									// scan between boundaries
 									// accumulate weighted effect of each neighboring pixel
-									const double weight = weightsTable.getWeight(x, i);
-									r += (weight * (double)((*pixel & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT));
-									g += (weight * (double)((*pixel & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT));
-									b += (weight * (double)((*pixel & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT));
+									const int weight = weightsTable.getFixedWeight(x, i);
+									r += (weight * ((*pixel & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT));
+									g += (weight * ((*pixel & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT));
+									b += (weight * ((*pixel & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT));
 									pixel++;
 								}
 
 								// clamp and place result in destination pixel
-								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(((r * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(((g * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(((b * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
+								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed((r * 0xFF) / 0x1F), 0, 0xFF);
+								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed((g * 0xFF) / 0x1F), 0, 0xFF);
+								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed((b * 0xFF) / 0x1F), 0, 0xFF);
 								dst_bits += 3;
 							}
 						}
@@ -1047,7 +1884,13 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 24:
 				{
 					// scale the 24-bit non-transparent image into a 24 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					if (kernels) {
+						for (unsigned y = first; y < last; y++) {
+							kernels->horizontal8(weightsTable, FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 3, src_width, 3, FreeImage_GetScanLine(dst, y), dst_width);
+						}
+						break;
+					}
+					for (unsigned y = first; y < last; y++) {
 						// scale each row
 						const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 3;
 						BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1057,23 +1900,23 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 							const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 							const BYTE * pixel = src_bits + iLeft * 3;
-							double r = 0, g = 0, b = 0;
+							int r = 0, g = 0, b = 0;
 
 							// for(i = iLeft to iRight)
 							for (unsigned i = 0; i < iLimit; i++) {
 								// scan between boundaries
 								// accumulate weighted effect of each neighboring pixel
-								const double weight = weightsTable.getWeight(x, i);
-								r += (weight * (double)pixel[FI_RGBA_RED]);
-								g += (weight * (double)pixel[FI_RGBA_GREEN]);
-								b += (weight * (double)pixel[FI_RGBA_BLUE]);
+								const int weight = weightsTable.getFixedWeight(x, i);
+								r += (weight * pixel[FI_RGBA_RED]);
+								g += (weight * pixel[FI_RGBA_GREEN]);
+								b += (weight * pixel[FI_RGBA_BLUE]);
 								pixel += 3;
 							}
 
 							// clamp and place result in destination pixel
-							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
+							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 							dst_bits += 3;
 						}
 					}
@@ -1083,7 +1926,13 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 32:
 				{
 					// scale the 32-bit transparent image into a 32 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					if (kernels) {
+						for (unsigned y = first; y < last; y++) {
+							kernels->horizontal8(weightsTable, FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 4, src_width, 4, FreeImage_GetScanLine(dst, y), dst_width);
+						}
+						break;
+					}
+					for (unsigned y = first; y < last; y++) {
 						// scale each row
 						const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 4;
 						BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1093,25 +1942,25 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
 							const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
 							const BYTE *pixel = src_bits + iLeft * 4;
-							double r = 0, g = 0, b = 0, a = 0;
+							int r = 0, g = 0, b = 0, a = 0;
 
 							// for(i = iLeft to iRight)
 							for (unsigned i = 0; i < iLimit; i++) {
 								// scan between boundaries
 								// accumulate weighted effect of each neighboring pixel
-								const double weight = weightsTable.getWeight(x, i);
-								r += (weight * (double)pixel[FI_RGBA_RED]);
-								g += (weight * (double)pixel[FI_RGBA_GREEN]);
-								b += (weight * (double)pixel[FI_RGBA_BLUE]);
-								a += (weight * (double)pixel[FI_RGBA_ALPHA]);
+								const int weight = weightsTable.getFixedWeight(x, i);
+								r += (weight * pixel[FI_RGBA_RED]);
+								g += (weight * pixel[FI_RGBA_GREEN]);
+								b += (weight * pixel[FI_RGBA_BLUE]);
+								a += (weight * pixel[FI_RGBA_ALPHA]);
 								pixel += 4;
 							}
 
 							// clamp and place result in destination pixel
-							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int)(a + 0.5), 0, 0xFF);
+							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+							dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 							dst_bits += 4;
 						}
 					}
@@ -1124,11 +1973,11 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_UINT16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetBPP(src) / 8) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first; y < last; y++) {
 				// scale each row
-				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * wordspp;
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
 
 				for (unsigned x = 0; x < dst_width; x++) {
@@ -1158,11 +2007,11 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGB16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetBPP(src) / 8) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first; y < last; y++) {
 				// scale each row
-				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * wordspp;
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
 
 				for (unsigned x = 0; x < dst_width; x++) {
@@ -1196,11 +2045,11 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGBA16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetBPP(src) / 8) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first; y < last; y++) {
 				// scale each row
-				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
+				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * wordspp;
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
 
 				for (unsigned x = 0; x < dst_width; x++) {
@@ -1238,11 +2087,18 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGBAF:
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / src_width) / sizeof(float);
+			const unsigned floatspp = (FreeImage_GetBPP(src) / 8) / sizeof(float);
+
+			if (kernels && (floatspp == 3 || floatspp == 4)) {
+				for (unsigned y = first; y < last; y++) {
+					kernels->horizontalFloat(weightsTable, (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * floatspp, floatspp, (float*)FreeImage_GetScanLine(dst, y), dst_width);
+				}
+				break;
+			}
 
-			for(unsigned y = 0; y < height; y++) {
+			for(unsigned y = first; y < last; y++) {
 				// scale each row
-				const float *src_bits = (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(float);
+				const float *src_bits = (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * floatspp;
 				float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
 
 				for(unsigned x = 0; x < dst_width; x++) {
@@ -1276,10 +2132,49 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 }
 
 /// Performs vertical image filtering
-void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
+BOOL CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
 
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_height, src_height);
+	// retrieve the contributions, calculated once per geometry
+	std::shared_ptr<CWeightsTable> table = CWeightsCache::getTable(m_pFilter, dst_height, src_height);
+	if (!table) {
+		return FALSE;
+	}
+	verticalFilter(*table, src, width, src_offset_x, src_offset_y, src_pal, dst, dst_height);
+	return TRUE;
+}
+
+/// Performs vertical image filtering with the given weights table
+void CResizeEngine::verticalFilter(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
+
+	// walking whole columns (or whole rows of a wide image) touches a cache line and a page per 
+	// source row, so the columns are filtered in blocks: strips of columns, cut into runs of 
+	// destination rows reading at most FI_RESIZE_BLOCK_ROWS source rows of the strip
+	const unsigned bytespp = FreeImage_GetBPP(src) > 8 ? FreeImage_GetBPP(src) / 8 : 1;
+	const unsigned block_rows = MAX(weightsTable.getWindowSize(), (unsigned)FI_RESIZE_BLOCK_ROWS);
+	const unsigned strip = MAX(FI_RESIZE_BLOCK_BYTES / (weightsTable.getWindowSize() * bytespp), 16U) & ~15;
+
+	// filter bands of columns, each band only writes its own columns of dst; 
+	// bands are multiples of 16 columns to keep the SIMD kernels on full vectors
+	const unsigned grain = ((FI_RESIZE_BAND_PIXELS / dst_height) + 16) & ~15;
+	FreeImage_ParallelFor(width, m_Threads, grain, [&](unsigned first, unsigned last) {
+		for (unsigned left = first; left < last; left += strip) {
+			const unsigned right = MIN(left + strip, last);
+			for (unsigned top = 0, bottom; top < dst_height; top = bottom) {
+				for (bottom = top + 1; bottom < dst_height; bottom++) {
+					if (weightsTable.getRightBoundary(bottom) - weightsTable.getLeftBoundary(top) > block_rows) {
+						break;
+					}
+				}
+				verticalFilterBlock(weightsTable, src, left, right, top, bottom, src_offset_x, src_offset_y, src_pal, dst);
+			}
+		}
+	});
+}
+
+/// Performs vertical image filtering of the columns [first, last) of the rows [top, bottom)
+void CResizeEngine::verticalFilterBlock(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned first, unsigned last, unsigned top, unsigned bottom, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst) {
+
+	const ResizeKernels *const kernels = GetResizeKernels();
 
 	// step through columns
 	switch(FreeImage_GetImageType(src)) {
@@ -1300,60 +2195,60 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the 1-bit non-transparent greyscale image to 8 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x;
 									const unsigned index = x >> 3;
 									const unsigned mask = 0x80 >> (x & 0x07);
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
 											const unsigned pixel = (*src_bits & mask) != 0;
-											value += (weightsTable.getWeight(y, i) * (double)*(BYTE *)&src_pal[pixel]);
+											value += (weightsTable.getFixedWeight(y, i) * *(BYTE *)&src_pal[pixel]);
 											src_bits += src_pitch;
 										}
 										value *= 0xFF;
 
 										// clamp and place result in destination pixel
-										*dst_bits = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										*dst_bits = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits += dst_pitch;
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x;
 									const unsigned index = x >> 3;
 									const unsigned mask = 0x80 >> (x & 0x07);
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(y, i) * (double)((*src_bits & mask) != 0));
+											value += (weightsTable.getFixedWeight(y, i) * ((*src_bits & mask) != 0));
 											src_bits += src_pitch;
 										}
 										value *= 0xFF;
 
 										// clamp and place result in destination pixel
-										*dst_bits = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										*dst_bits = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits += dst_pitch;
 									}
 								}
@@ -1366,65 +2261,65 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 1-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x * 3;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x * 3;
 									const unsigned index = x >> 3;
 									const unsigned mask = 0x80 >> (x & 0x07);
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-										double r = 0, g = 0, b = 0;
+										int r = 0, g = 0, b = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											const double weight = weightsTable.getWeight(y, i);
+											const int weight = weightsTable.getFixedWeight(y, i);
 											const unsigned pixel = (*src_bits & mask) != 0;
 											const BYTE * const entry = (BYTE *)&src_pal[pixel];
-											r += (weight * (double)entry[FI_RGBA_RED]);
-											g += (weight * (double)entry[FI_RGBA_GREEN]);
-											b += (weight * (double)entry[FI_RGBA_BLUE]);
+											r += (weight * entry[FI_RGBA_RED]);
+											g += (weight * entry[FI_RGBA_GREEN]);
+											b += (weight * entry[FI_RGBA_BLUE]);
 											src_bits += src_pitch;
 										}
 
 										// clamp and place result in destination pixel
-										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
+										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 										dst_bits += dst_pitch;
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x * 3;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x * 3;
 									const unsigned index = x >> 3;
 									const unsigned mask = 0x80 >> (x & 0x07);
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(y, i) * (double)((*src_bits & mask) != 0));
+											value += (weightsTable.getFixedWeight(y, i) * ((*src_bits & mask) != 0));
 											src_bits += src_pitch;
 										}
 										value *= 0xFF;
 
 										// clamp and place result in destination pixel
-										const BYTE bval = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										const BYTE bval = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits[FI_RGBA_RED]	= bval;
 										dst_bits[FI_RGBA_GREEN]	= bval;
 										dst_bits[FI_RGBA_BLUE]	= bval;
@@ -1439,38 +2334,38 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 1-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first; x < last; x++) {
 								// work on column x in dst
-								BYTE *dst_bits = dst_base + x * 4;
+								BYTE *dst_bits = dst_base + top * dst_pitch + x * 4;
 								const unsigned index = x >> 3;
 								const unsigned mask = 0x80 >> (x & 0x07);
 
 								// scale each column
-								for (unsigned y = 0; y < dst_height; y++) {
+								for (unsigned y = top; y < bottom; y++) {
 									// loop through column
 									const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 									const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 									const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-									double r = 0, g = 0, b = 0, a = 0;
+									int r = 0, g = 0, b = 0, a = 0;
 
 									for (unsigned i = 0; i < iLimit; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(y, i);
+										const int weight = weightsTable.getFixedWeight(y, i);
 										const unsigned pixel = (*src_bits & mask) != 0;
 										const BYTE * const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
-										a += (weight * (double)entry[FI_RGBA_ALPHA]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
+										a += (weight * entry[FI_RGBA_ALPHA]);
 										src_bits += src_pitch;
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int)(a + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 									dst_bits += dst_pitch;
 								}
 							}
@@ -1490,29 +2385,29 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the non-transparent 4-bit greyscale image to 8 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first; x < last; x++) {
 								// work on column x in dst
-								BYTE *dst_bits = dst_base + x;
+								BYTE *dst_bits = dst_base + top * dst_pitch + x;
 								const unsigned index = x >> 1;
 
 								// scale each column
-								for (unsigned y = 0; y < dst_height; y++) {
+								for (unsigned y = top; y < bottom; y++) {
 									// loop through column
 									const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 									const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 									const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-									double value = 0;
+									int value = 0;
 
 									for (unsigned i = 0; i < iLimit; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
 										const unsigned pixel = x & 0x01 ? *src_bits & 0x0F : *src_bits >> 4;
-										value += (weightsTable.getWeight(y, i) * (double)*(BYTE *)&src_pal[pixel]);
+										value += (weightsTable.getFixedWeight(y, i) * *(BYTE *)&src_pal[pixel]);
 										src_bits += src_pitch;
 									}
 
 									// clamp and place result in destination pixel
-									*dst_bits = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+									*dst_bits = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 									dst_bits += dst_pitch;
 								}
 							}
@@ -1523,35 +2418,35 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the non-transparent 4-bit image to 24 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first; x < last; x++) {
 								// work on column x in dst
-								BYTE *dst_bits = dst_base + x * 3;
+								BYTE *dst_bits = dst_base + top * dst_pitch + x * 3;
 								const unsigned index = x >> 1;
 
 								// scale each column
-								for (unsigned y = 0; y < dst_height; y++) {
+								for (unsigned y = top; y < bottom; y++) {
 									// loop through column
 									const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 									const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 									const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-									double r = 0, g = 0, b = 0;
+									int r = 0, g = 0, b = 0;
 
 									for (unsigned i = 0; i < iLimit; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(y, i);
+										const int weight = weightsTable.getFixedWeight(y, i);
 										const unsigned pixel = x & 0x01 ? *src_bits & 0x0F : *src_bits >> 4;
 										const BYTE *const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
 										src_bits += src_pitch;
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 									dst_bits += dst_pitch;
 								}
 							}
@@ -1562,37 +2457,37 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 4-bit image to 32 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first; x < last; x++) {
 								// work on column x in dst
-								BYTE *dst_bits = dst_base + x * 4;
+								BYTE *dst_bits = dst_base + top * dst_pitch + x * 4;
 								const unsigned index = x >> 1;
 
 								// scale each column
-								for (unsigned y = 0; y < dst_height; y++) {
+								for (unsigned y = top; y < bottom; y++) {
 									// loop through column
 									const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 									const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 									const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-									double r = 0, g = 0, b = 0, a = 0;
+									int r = 0, g = 0, b = 0, a = 0;
 
 									for (unsigned i = 0; i < iLimit; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(y, i);
+										const int weight = weightsTable.getFixedWeight(y, i);
 										const unsigned pixel = x & 0x01 ? *src_bits & 0x0F : *src_bits >> 4;
 										const BYTE *const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
-										a += (weight * (double)entry[FI_RGBA_ALPHA]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
+										a += (weight * entry[FI_RGBA_ALPHA]);
 										src_bits += src_pitch;
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int)(a + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 									dst_bits += dst_pitch;
 								}
 							}
@@ -1613,53 +2508,59 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// scale the 8-bit non-transparent greyscale image into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x;
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + x;
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(y, i) * (double)*(BYTE *)&src_pal[*src_bits]);
+											value += (weightsTable.getFixedWeight(y, i) * *(BYTE *)&src_pal[*src_bits]);
 											src_bits += src_pitch;
 										}
 
 										// clamp and place result in destination pixel
-										*dst_bits = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										*dst_bits = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits += dst_pitch;
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								if (kernels) {
+									for (unsigned y = top; y < bottom; y++) {
+										kernels->vertical8(weightsTable, y, src_base + first, src_pitch, last - first, dst_base + y * dst_pitch + first);
+									}
+									break;
+								}
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x;
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + x;
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(y, i) * (double)*src_bits);
+											value += (weightsTable.getFixedWeight(y, i) * *src_bits);
 											src_bits += src_pitch;
 										}
 
 										// clamp and place result in destination pixel
-										*dst_bits = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										*dst_bits = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits += dst_pitch;
 									}
 								}
@@ -1672,59 +2573,59 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x * 3;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x * 3;
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + x;
-										double r = 0, g = 0, b = 0;
+										int r = 0, g = 0, b = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											const double weight = weightsTable.getWeight(y, i);
+											const int weight = weightsTable.getFixedWeight(y, i);
 											const BYTE * const entry = (BYTE *)&src_pal[*src_bits];
-											r += (weight * (double)entry[FI_RGBA_RED]);
-											g += (weight * (double)entry[FI_RGBA_GREEN]);
-											b += (weight * (double)entry[FI_RGBA_BLUE]);
+											r += (weight * entry[FI_RGBA_RED]);
+											g += (weight * entry[FI_RGBA_GREEN]);
+											b += (weight * entry[FI_RGBA_BLUE]);
 											src_bits += src_pitch;
 										}
 
 										// clamp and place result in destination pixel
-										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
+										dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+										dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+										dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 										dst_bits += dst_pitch;
 									}
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first; x < last; x++) {
 									// work on column x in dst
-									BYTE *dst_bits = dst_base + x * 3;
+									BYTE *dst_bits = dst_base + top * dst_pitch + x * 3;
 
 									// scale each column
-									for (unsigned y = 0; y < dst_height; y++) {
+									for (unsigned y = top; y < bottom; y++) {
 										// loop through column
 										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 										const BYTE *src_bits = src_base + iLeft * src_pitch + x;
-										double value = 0;
+										int value = 0;
 
 										for (unsigned i = 0; i < iLimit; i++) {
 											// scan between boundaries
 											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(y, i) * (double)*src_bits);
+											value += (weightsTable.getFixedWeight(y, i) * *src_bits);
 											src_bits += src_pitch;
 										}
 
 										// clamp and place result in destination pixel
-										const BYTE bval = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+										const BYTE bval = (BYTE)CLAMP<int>(RoundFixed(value), 0, 0xFF);
 										dst_bits[FI_RGBA_RED]	= bval;
 										dst_bits[FI_RGBA_GREEN]	= bval;
 										dst_bits[FI_RGBA_BLUE]	= bval;
@@ -1739,35 +2640,35 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first; x < last; x++) {
 								// work on column x in dst
-								BYTE *dst_bits = dst_base + x * 4;
+								BYTE *dst_bits = dst_base + top * dst_pitch + x * 4;
 
 								// scale each column
-								for (unsigned y = 0; y < dst_height; y++) {
+								for (unsigned y = top; y < bottom; y++) {
 									// loop through column
 									const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 									const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 									const BYTE *src_bits = src_base + iLeft * src_pitch + x;
-									double r = 0, g = 0, b = 0, a = 0;
+									int r = 0, g = 0, b = 0, a = 0;
 
 									for (unsigned i = 0; i < iLimit; i++) {
 										// scan between boundaries
 										// accumulate weighted effect of each neighboring pixel
-										const double weight = weightsTable.getWeight(y, i);
+										const int weight = weightsTable.getFixedWeight(y, i);
 										const BYTE * const entry = (BYTE *)&src_pal[*src_bits];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
-										a += (weight * (double)entry[FI_RGBA_ALPHA]);
+										r += (weight * entry[FI_RGBA_RED]);
+										g += (weight * entry[FI_RGBA_GREEN]);
+										b += (weight * entry[FI_RGBA_BLUE]);
+										a += (weight * entry[FI_RGBA_ALPHA]);
 										src_bits += src_pitch;
 									}
 
 									// clamp and place result in destination pixel
-									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(b + 0.5), 0, 0xFF);
-									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int)(a + 0.5), 0, 0xFF);
+									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+									dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+									dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 									dst_bits += dst_pitch;
 								}
 							}
@@ -1785,63 +2686,63 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = first; x < last; x++) {
 							// work on column x in dst
-							BYTE *dst_bits = dst_base + x * 3;
+							BYTE *dst_bits = dst_base + top * dst_pitch + x * 3;
 
 							// scale each column
-							for (unsigned y = 0; y < dst_height; y++) {
+							for (unsigned y = top; y < bottom; y++) {
 								// loop through column
 								const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 								const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 								const WORD *src_bits = src_base + iLeft * src_pitch + x;
-								double r = 0, g = 0, b = 0;
+								int r = 0, g = 0, b = 0;
 
 								for (unsigned i = 0; i < iLimit; i++) {
 									// scan between boundaries
 									// accumulate weighted effect of each neighboring pixel
-									const double weight = weightsTable.getWeight(y, i);
-									r += (weight * (double)((*src_bits & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT));
-									g += (weight * (double)((*src_bits & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT));
-									b += (weight * (double)((*src_bits & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT));
+									const int weight = weightsTable.getFixedWeight(y, i);
+									r += (weight * ((*src_bits & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT));
+									g += (weight * ((*src_bits & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT));
+									b += (weight * ((*src_bits & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT));
 									src_bits += src_pitch;
 								}
 
 								// clamp and place result in destination pixel
-								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(((r * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(((g * 0xFF) / 0x3F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(((b * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
+								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed((r * 0xFF) / 0x1F), 0, 0xFF);
+								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed((g * 0xFF) / 0x3F), 0, 0xFF);
+								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed((b * 0xFF) / 0x1F), 0, 0xFF);
 								dst_bits += dst_pitch;
 							}
 						}
 					} else {
 						// image has 555 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = first; x < last; x++) {
 							// work on column x in dst
-							BYTE *dst_bits = dst_base + x * 3;
+							BYTE *dst_bits = dst_base + top * dst_pitch + x * 3;
 
 							// scale each column
-							for (unsigned y = 0; y < dst_height; y++) {
+							for (unsigned y = top; y < bottom; y++) {
 								// loop through column
 								const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 								const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 								const WORD *src_bits = src_base + iLeft * src_pitch + x;
-								double r = 0, g = 0, b = 0;
+								int r = 0, g = 0, b = 0;
 
 								for (unsigned i = 0; i < iLimit; i++) {
 									// scan between boundaries
 									// accumulate weighted effect of each neighboring pixel
-									const double weight = weightsTable.getWeight(y, i);
-									r += (weight * (double)((*src_bits & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT));
-									g += (weight * (double)((*src_bits & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT));
-									b += (weight * (double)((*src_bits & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT));
+									const int weight = weightsTable.getFixedWeight(y, i);
+									r += (weight * ((*src_bits & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT));
+									g += (weight * ((*src_bits & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT));
+									b += (weight * ((*src_bits & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT));
 									src_bits += src_pitch;
 								}
 
 								// clamp and place result in destination pixel
-								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(((r * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(((g * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
-								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int)(((b * 0xFF) / 0x1F) + 0.5), 0, 0xFF);
+								dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed((r * 0xFF) / 0x1F), 0, 0xFF);
+								dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed((g * 0xFF) / 0x1F), 0, 0xFF);
+								dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed((b * 0xFF) / 0x1F), 0, 0xFF);
 								dst_bits += dst_pitch;
 							}
 						}
@@ -1855,33 +2756,40 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 					const unsigned src_pitch = FreeImage_GetPitch(src);
 					const BYTE *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 3;
 
-					for (unsigned x = 0; x < width; x++) {
+					if (kernels) {
+						for (unsigned y = top; y < bottom; y++) {
+							kernels->vertical8(weightsTable, y, src_base + first * 3, src_pitch, (last - first) * 3, dst_base + y * dst_pitch + first * 3);
+						}
+						break;
+					}
+
+					for (unsigned x = first; x < last; x++) {
 						// work on column x in dst
 						const unsigned index = x * 3;
-						BYTE *dst_bits = dst_base + index;
+						BYTE *dst_bits = dst_base + top * dst_pitch + index;
 
 						// scale each column
-						for (unsigned y = 0; y < dst_height; y++) {
+						for (unsigned y = top; y < bottom; y++) {
 							// loop through column
 							const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 							const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 							const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-							double r = 0, g = 0, b = 0;
+							int r = 0, g = 0, b = 0;
 
 							for (unsigned i = 0; i < iLimit; i++) {
 								// scan between boundaries
 								// accumulate weighted effect of each neighboring pixel
-								const double weight = weightsTable.getWeight(y, i);
-								r += (weight * (double)src_bits[FI_RGBA_RED]);
-								g += (weight * (double)src_bits[FI_RGBA_GREEN]);
-								b += (weight * (double)src_bits[FI_RGBA_BLUE]);
+								const int weight = weightsTable.getFixedWeight(y, i);
+								r += (weight * src_bits[FI_RGBA_RED]);
+								g += (weight * src_bits[FI_RGBA_GREEN]);
+								b += (weight * src_bits[FI_RGBA_BLUE]);
 								src_bits += src_pitch;
 							}
 
 							// clamp and place result in destination pixel
-							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int) (r + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int) (g + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int) (b + 0.5), 0, 0xFF);
+							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
 							dst_bits += dst_pitch;
 						}
 					}
@@ -1894,35 +2802,42 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 					const unsigned src_pitch = FreeImage_GetPitch(src);
 					const BYTE *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 4;
 
-					for (unsigned x = 0; x < width; x++) {
+					if (kernels) {
+						for (unsigned y = top; y < bottom; y++) {
+							kernels->vertical8(weightsTable, y, src_base + first * 4, src_pitch, (last - first) * 4, dst_base + y * dst_pitch + first * 4);
+						}
+						break;
+					}
+
+					for (unsigned x = first; x < last; x++) {
 						// work on column x in dst
 						const unsigned index = x * 4;
-						BYTE *dst_bits = dst_base + index;
+						BYTE *dst_bits = dst_base + top * dst_pitch + index;
 
 						// scale each column
-						for (unsigned y = 0; y < dst_height; y++) {
+						for (unsigned y = top; y < bottom; y++) {
 							// loop through column
 							const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 							const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
 							const BYTE *src_bits = src_base + iLeft * src_pitch + index;
-							double r = 0, g = 0, b = 0, a = 0;
+							int r = 0, g = 0, b = 0, a = 0;
 
 							for (unsigned i = 0; i < iLimit; i++) {
 								// scan between boundaries
 								// accumulate weighted effect of each neighboring pixel
-								const double weight = weightsTable.getWeight(y, i);
-								r += (weight * (double)src_bits[FI_RGBA_RED]);
-								g += (weight * (double)src_bits[FI_RGBA_GREEN]);
-								b += (weight * (double)src_bits[FI_RGBA_BLUE]);
-								a += (weight * (double)src_bits[FI_RGBA_ALPHA]);
+								const int weight = weightsTable.getFixedWeight(y, i);
+								r += (weight * src_bits[FI_RGBA_RED]);
+								g += (weight * src_bits[FI_RGBA_GREEN]);
+								b += (weight * src_bits[FI_RGBA_BLUE]);
+								a += (weight * src_bits[FI_RGBA_ALPHA]);
 								src_bits += src_pitch;
 							}
 
 							// clamp and place result in destination pixel
-							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int) (r + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int) (g + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>((int) (b + 0.5), 0, 0xFF);
-							dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>((int) (a + 0.5), 0, 0xFF);
+							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>(RoundFixed(r), 0, 0xFF);
+							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>(RoundFixed(g), 0, 0xFF);
+							dst_bits[FI_RGBA_BLUE]	= (BYTE)CLAMP<int>(RoundFixed(b), 0, 0xFF);
+							dst_bits[FI_RGBA_ALPHA]	= (BYTE)CLAMP<int>(RoundFixed(a), 0, 0xFF);
 							dst_bits += dst_pitch;
 						}
 					}
@@ -1935,7 +2850,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_UINT16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetBPP(src) / 8) / sizeof(WORD);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -1943,13 +2858,13 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src)	+ src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first; x < last; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
-				WORD *dst_bits = dst_base + index;
+				WORD *dst_bits = dst_base + top * dst_pitch + index;
 
 				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
+				for (unsigned y = top; y < bottom; y++) {
 					// loop through column
 					const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 					const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
@@ -1976,7 +2891,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGB16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetBPP(src) / 8) / sizeof(WORD);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -1984,13 +2899,13 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first; x < last; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
-				WORD *dst_bits = dst_base + index;
+				WORD *dst_bits = dst_base + top * dst_pitch + index;
 
 				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
+				for (unsigned y = top; y < bottom; y++) {
 					// loop through column
 					const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 					const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
@@ -2022,7 +2937,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGBA16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetBPP(src) / 8) / sizeof(WORD);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -2030,13 +2945,13 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first; x < last; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
-				WORD *dst_bits = dst_base + index;
+				WORD *dst_bits = dst_base + top * dst_pitch + index;
 
 				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
+				for (unsigned y = top; y < bottom; y++) {
 					// loop through column
 					const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
 					const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
@@ -2072,7 +2987,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGBAF:
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / width) / sizeof(float);
+			const unsigned floatspp = (FreeImage_GetBPP(src) / 8) / sizeof(float);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(float);
 			float *const dst_base = (float *)FreeImage_GetBits(dst);
@@ -2080,13 +2995,20 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(float);
 			const float *const src_base = (float *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * floatspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			if (kernels && (floatspp == 3 || floatspp == 4)) {
+				for (unsigned y = top; y < bottom; y++) {
+					kernels->verticalFloat(weightsTable, y, src_base + first * floatspp, src_pitch, (last - first) * floatspp, dst_base + y * dst_pitch + first * floatspp);
+				}
+				break;
+			}
+
+			for (unsigned x = first; x < last; x++) {
 				// work on column x in dst
 				const unsigned index = x * floatspp;	// pixel index
-				float *dst_bits = (float *)dst_base + index;
+				float *dst_bits = dst_base + top * dst_pitch + index;
 
 				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
+				for (unsigned y = top; y < bottom; y++) {
 					// loop through column
 					const unsigned iLeft = weightsTable.getLeftBoundary(y);    // retrieve left boundary
 					const unsigned iRight = weightsTable.getRightBoundary(y);  // retrieve right boundary
@@ -28,54 +28,105 @@
 #include "Utilities.h"
 #include "Filters.h" 
 
+#include <memory>
+
+/// Number of fractional bits of the fixed point weights used for 8-bit channels
+#define FI_WEIGHT_BITS	14
+/// Fixed point representation of a weight of 1.0
+#define FI_WEIGHT_ONE	(1 << FI_WEIGHT_BITS)
+
 /**
   Filter weights table.<br>
   This class stores contribution information for an entire line (row or column).
+  All weights live in a single aligned block: the normalized double weights 
+  (used for 16-bit and float channels), the fixed point weights (used for 8-bit channels, 
+  each window summing to exactly FI_WEIGHT_ONE) and the window bounds. 
+  Each window of weights starts on a 16-byte boundary and is zero padded.
 */
 class CWeightsTable
 {
 /**
-  Sampled filter weight table.<br>
-  Contribution information for a single pixel
+  Bounds of the source pixels window of a single pixel
 */
 typedef struct {
-	/// Normalized weights of neighboring pixels
-	double *Weights;
-	/// Bounds of source pixels window
 	unsigned Left, Right;
 } Contribution;
 
 private:
-	/// Row (or column) of contribution weights 
-	Contribution *m_WeightTable;
+	/// Normalized weights of neighboring pixels, m_WindowStride per pixel
+	double *m_Weights;
+	/// Fixed point weights of neighboring pixels, m_WindowStride per pixel
+	short *m_FixedWeights;
+	/// Row (or column) of source windows
+	Contribution *m_Bounds;
+	/// Allocated block, released by the destructor
+	BYTE *m_Block;
 	/// Filter window size (of affecting source pixels) 
 	unsigned m_WindowSize;
+	/// Filter window size rounded up to a multiple of 8 weights
+	unsigned m_WindowStride;
 	/// Length of line (no. of rows / cols) 
 	unsigned m_LineLength;
 
 public:
 	/** 
 	Constructor<br>
-	Allocate and compute the weights table
+	Allocate and compute the weights table, use isValid() to check the allocation
 	@param pFilter Filter used for upsampling or downsampling
 	@param uDstSize Length (in pixels) of the destination line buffer
 	@param uSrcSize Length (in pixels) of the source line buffer
 	*/
 	CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize);
 
+	/** 
+	Constructor<br>
+	View of the destination pixels [first, last) of a table, whose source windows start 'origin' 
+	pixels earlier. It shares the weights of the table, which must outlive the view; 
+	use isValid() to check the allocation of its bounds.
+	@param table Weights table
+	@param first First destination pixel of the view
+	@param last Last destination pixel (excluded) of the view
+	@param origin Source pixel becoming pixel 0 of the view, at most the left boundary of 'first'
+	*/
+	CWeightsTable(const CWeightsTable &table, unsigned first, unsigned last, unsigned origin);
+
 	/**
 	Destructor<br>
 	Destroy the weights table
 	*/
 	~CWeightsTable();
 
+	/** Check the table allocation
+	@return Returns TRUE if the table was allocated, FALSE otherwise
+	*/
+	BOOL isValid() const {
+		return (m_Block != NULL);
+	}
+
 	/** Retrieve a filter weight, given source and destination positions
 	@param dst_pos Pixel position in destination line buffer
 	@param src_pos Pixel position in source line buffer
 	@return Returns the filter weight
 	*/
 	double getWeight(unsigned dst_pos, unsigned src_pos) {
-		return m_WeightTable[dst_pos].Weights[src_pos];
+		return m_Weights[dst_pos * m_WindowStride + src_pos];
+	}
+
+	/** Retrieve a fixed point filter weight (scaled by FI_WEIGHT_ONE), given source and destination positions
+	@param dst_pos Pixel position in destination line buffer
+	@param src_pos Pixel position in source line buffer
+	@return Returns the filter weight
+	*/
+	int getFixedWeight(unsigned dst_pos, unsigned src_pos) {
+		return m_FixedWeights[dst_pos * m_WindowStride + src_pos];
+	}
+
+	/** Retrieve the fixed point weights window of a destination pixel
+	@param dst_pos Pixel position in destination line buffer
+	@return Returns a 16-byte aligned pointer to the zero padded weights window
+	*/
+	const short* getFixedWeights(unsigned dst_pos) {
+		return m_FixedWeights + dst_pos * m_WindowStride;
 	}
 
 	/** Retrieve left boundary of source line buffer
@@ -83,7 +134,7 @@ public:
 	@return Returns the left boundary of source line buffer
 	*/
 	unsigned getLeftBoundary(unsigned dst_pos) {
-		return m_WeightTable[dst_pos].Left;
+		return m_Bounds[dst_pos].Left;
 	}
 
 	/** Retrieve right boundary of source line buffer
@@ -91,12 +142,59 @@ public:
 	@return Returns the right boundary of source line buffer
 	*/
 	unsigned getRightBoundary(unsigned dst_pos) {
-		return m_WeightTable[dst_pos].Right;
+		return m_Bounds[dst_pos].Right;
+	}
+
+	/** Retrieve the filter window size
+	@return Returns the largest number of source pixels of a destination pixel
+	*/
+	unsigned getWindowSize() {
+		return m_WindowSize;
+	}
+
+	/** Retrieve the size of the table
+	@return Returns the number of bytes allocated for the weights and bounds
+	*/
+	size_t getMemorySize() {
+		return (size_t)m_LineLength * (m_WindowStride * (sizeof(double) + sizeof(short)) + sizeof(Contribution));
 	}
 };
 
 // ---------------------------------------------
 
+/**
+  Weights tables cache.<br>
+  Tables only depend on the filter and on the source and destination line lengths, 
+  so rescaling many images with the same geometry computes each table once. 
+  The cache keeps the most recently used tables and is shared by all threads; 
+  a cached table is read-only and may be used by several engines at the same time.
+  Filters are identified by their class and width.
+*/
+class CWeightsCache
+{
+public:
+	/**
+	Retrieve a weights table, computing it on a cache miss
+	@param pFilter Filter used for upsampling or downsampling
+	@param uDstSize Length (in pixels) of the destination line buffer
+	@param uSrcSize Length (in pixels) of the source line buffer
+	@return Returns the shared table, or an empty pointer if the table could not be allocated
+	*/
+	static std::shared_ptr<CWeightsTable> getTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize);
+
+	/**
+	Set the maximum number of cached tables, 0 disables the cache and frees the cached tables
+	*/
+	static void setCapacity(unsigned entries);
+
+	/**
+	Retrieve the number of tables found in the cache and computed since the process started
+	*/
+	static void getStats(UINT64 *hits, UINT64 *misses);
+};
+
+// ---------------------------------------------
+
 /**
  CResizeEngine<br>
  This class performs filtered zoom. It scales an image to the desired dimensions with 
@@ -116,14 +214,19 @@ class CResizeEngine
 private:
 	/// Pointer to the FIR / IIR filter
 	CGenericFilter* m_pFilter;
+	/// Maximum number of threads running the filter passes
+	unsigned m_Threads;
 
 public:
 
 	/**
 	Constructor
 	@param filter FIR /IIR filter to be used
+	@param threads Maximum number of threads used by each filter pass. The passes are split 
+	into bands of rows (horizontal pass) or columns (vertical pass), each output pixel is 
+	computed the same way whatever the number of threads.
 	*/
-	CResizeEngine(CGenericFilter* filter):m_pFilter(filter) {}
+	CResizeEngine(CGenericFilter* filter, unsigned threads = 1):m_pFilter(filter), m_Threads(threads) {}
 
 	/// Destructor
 	virtual ~CResizeEngine() {}
@@ -155,9 +258,40 @@ public:
 	@param src_top Top boundary of the source rectangle to be scaled
 	@param src_width Width of the source rectangle to be scaled
 	@param src_height Height of the source rectangle to be scaled
+	@param into Optional destination image, used instead of allocating one. It must have the 
+	size dst_width x dst_height and the type and bit depth of the image scale would allocate
 	@return Returns the scaled image if successful, returns NULL otherwise
 	*/
-	FIBITMAP* scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags);
+	FIBITMAP* scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags, FIBITMAP *into = NULL);
+
+	/** Scale an image read and written row by row.
+
+	The source rows 0 to src_top + src_height - 1 are read in order, the rows above 
+	src_top being skipped, and the destination rows are written in order as soon as 
+	the source rows they depend on have been read. Only the horizontally filtered rows 
+	of the vertical filter window are kept, so that the memory used doesn't depend on 
+	the source height. Rows are FreeImage scanlines without padding, the pixels are 
+	neither converted nor given a palette.
+
+	@param image_type Image type: FIT_BITMAP (8-, 24- or 32-bit), FIT_UINT16, FIT_FLOAT, 
+	FIT_RGB16, FIT_RGBA16, FIT_RGBF or FIT_RGBAF
+	@param bpp Bit depth
+	@param width Width of the source rows
+	@param dst_width Destination image width
+	@param dst_height Destination image height
+	@param src_left Left boundary of the source rectangle to be scaled
+	@param src_top Top boundary of the source rectangle to be scaled
+	@param src_width Width of the source rectangle to be scaled
+	@param src_height Height of the source rectangle to be scaled
+	@param read Source rows producer
+	@param write Destination rows consumer
+	@param data Parameter of read and write
+	@return Returns TRUE if successful, FALSE if the format isn't supported, on memory 
+	error or if read or write returned FALSE
+	*/
+	BOOL scaleStream(FREE_IMAGE_TYPE image_type, unsigned bpp, unsigned width, unsigned dst_width, unsigned dst_height, 
+		unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, 
+		FI_RescaleReadProc read, FI_RescaleWriteProc write, void *data);
 
 private:
 
@@ -172,11 +306,28 @@ private:
 	@param src_pal
 	@param dst Destination image
 	@param dst_width Destination image width
+	@return Returns TRUE if successful, FALSE if the weights table could not be allocated
 	*/
-	void horizontalFilter(FIBITMAP * const src, const unsigned height, const unsigned src_width,
+	BOOL horizontalFilter(FIBITMAP * const src, const unsigned height, const unsigned src_width,
 			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_width);
 
+	/**
+	Performs horizontal image filtering with the given weights table
+	@see horizontalFilter
+	*/
+	void horizontalFilter(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned height, const unsigned src_width,
+			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_width);
+
+	/**
+	Performs horizontal image filtering of the destination rows [first, last)
+	@see horizontalFilter
+	*/
+	void horizontalFilterRows(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned first, const unsigned last,
+			const unsigned src_width, const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_width);
+
 	/**
 	Performs vertical image filtering
 	@param src Source image
@@ -187,10 +338,27 @@ private:
 	@param src_pal
 	@param dst Destination image
 	@param dst_height Destination image height
+	@return Returns TRUE if successful, FALSE if the weights table could not be allocated
 	*/
-	void verticalFilter(FIBITMAP * const src, const unsigned width, const unsigned src_height,
+	BOOL verticalFilter(FIBITMAP * const src, const unsigned width, const unsigned src_height,
 			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_height);
+
+	/**
+	Performs vertical image filtering with the given weights table
+	@see verticalFilter
+	*/
+	void verticalFilter(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned width,
+			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_height);
+
+	/**
+	Performs vertical image filtering of the destination columns [first, last) of the destination rows [top, bottom)
+	@see verticalFilter
+	*/
+	void verticalFilterBlock(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned first, const unsigned last,
+			const unsigned top, const unsigned bottom, const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst);
 };
 
 #endif //   _RESIZE_H_
@@ -0,0 +1,52 @@
+// ==========================================================
+// Thread pool used to split filters into bands of rows or columns
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_THREADPOOL_H
+#define FREEIMAGE_THREADPOOL_H
+
+#include <functional>
+
+/**
+Splits [0, count) into bands and runs body(first, last) on each of them, using up to 'threads'
+threads including the calling one. Band sizes are multiples of 'grain' (except the last band),
+so that tiny bands don't cost more to hand out than to compute.
+Bands are handed out on demand to the worker threads, which are created on first use and shared
+by all callers; body may itself call FreeImage_ParallelFor.
+The function returns once every band is done.
+@param count Number of items (rows, columns, ...) to process
+@param threads Maximum number of threads, 0 or 1 runs body(0, count) on the calling thread
+@param grain Granularity of the bands
+@param body Function processing the items [first, last)
+*/
+void FreeImage_ParallelFor(unsigned count, unsigned threads, unsigned grain, const std::function<void(unsigned first, unsigned last)> &body);
+
+/**
+FreeImage_ParallelFor on a lambda or any other function object. The std::function only refers to body, 
+so that lambdas capturing many variables are not copied to the heap on every call.
+*/
+template <class Body> inline void
+FreeImage_ParallelFor(unsigned count, unsigned threads, unsigned grain, const Body &body) {
+	FreeImage_ParallelFor(count, threads, grain, std::function<void(unsigned, unsigned)>(std::cref(body)));
+}
+
+/**
+Returns the number of hardware threads, at least 1
+*/
+unsigned FreeImage_GetHardwareThreads();
+
+#endif // FREEIMAGE_THREADPOOL_H
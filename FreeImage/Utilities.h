@@ -52,6 +52,34 @@
 #include <limits>
 #include <memory>
 
+// ==========================================================
+//   SIMD instruction sets
+// ==========================================================
+
+// FI_HAS_SSE2 is defined when SSE2 code can be compiled, SSE2 being part of every x64 processor. 
+// FI_HAS_SSSE3 and FI_HAS_AVX2 are defined when the compiler can target these instruction sets: 
+// their kernels are marked FI_TARGET_SSSE3 / FI_TARGET_AVX2 and selected at run time 
+// with HasSSSE3() / HasAVX2(). FreeImage_SetSIMDLevel limits all three: the SSE2 kernels which 
+// have a plain C++ counterpart are selected at run time with HasSSE2().
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FI_HAS_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define FI_HAS_SSSE3
+#define FI_HAS_AVX2
+#include <tmmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define FI_TARGET_SSSE3
+#define FI_TARGET_AVX2
+#else
+#define FI_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define FI_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
 // ==========================================================
 //   Bitmap palette and pixels alignment
 // ==========================================================
@@ -392,6 +420,43 @@ Rotate a dib according to Exif info
 */
 void RotateExif(FIBITMAP **dib);
 
+/**
+Returns the number of threads of the arbitrary angle rotations
+@see FreeImage_SetRotateThreads, ClassicRotate.cpp, BSplineRotate.cpp
+*/
+unsigned GetRotateThreads();
+
+/**
+Copies a line of width pixels of bytespp bytes, with the pixels in reverse order
+@see Flip.cpp, ClassicRotate.cpp
+*/
+void ReverseLine(BYTE *dst, const BYTE *src, unsigned width, unsigned bytespp);
+
+/**
+Exchanges two lines of width pixels of bytespp bytes, reversing the order of their pixels. 
+If a and b are the same line, the line is reversed in place.
+@see Flip.cpp, ClassicRotate.cpp
+*/
+void ReverseSwapLines(BYTE *a, BYTE *b, unsigned width, unsigned bytespp);
+
+/**
+Returns TRUE if the SSE2 kernels may be used, FALSE when FI_HAS_SSE2 is not defined or below FI_SIMD_SSE2
+@see FreeImage.cpp, Resize.cpp, Display.cpp
+*/
+BOOL HasSSE2();
+
+/**
+Returns TRUE if the processor supports SSSE3, FALSE as well when FI_HAS_SSSE3 is not defined or below FI_SIMD_SSSE3
+@see FreeImage.cpp, Flip.cpp, ClassicRotate.cpp
+*/
+BOOL HasSSSE3();
+
+/**
+Returns TRUE if the processor and the operating system support AVX2, FALSE as well when FI_HAS_AVX2 is not defined or below FI_SIMD_AVX2
+@see FreeImage.cpp, Resize.cpp, Display.cpp
+*/
+BOOL HasAVX2();
+
 
 // ==========================================================
 //   Big Endian / Little Endian utility functions
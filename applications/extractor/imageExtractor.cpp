@@ -110,7 +110,7 @@ int main(int argc, char * argv[]) {
     for( int i = 1; i <= targetImages; ++i ) {
         auto targetImage = sourceImage.clip(topLeft.x,topLeft.y,bottomRight.x,bottomRight.y);
         if( optTranspColor ) {
-            targetImage = std::move(targetImage.to32bpp().replace(transpColor,newTranspColor));
+            targetImage.to32bppInPlace().replace(transpColor,newTranspColor);
         }
         auto targetFilename = targetImageNameBuilder.build(i);
         std::cout << "writing " << targetFilename << std::endl;
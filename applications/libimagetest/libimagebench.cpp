@@ -0,0 +1,870 @@
+#include "image/image.h"
+
+#include "FreeImage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// counts the allocations made through operator new, to check the allocation free paths.
+// bitmap blocks come from a BitmapPool in those benchmarks and are counted by its misses
+std::atomic<std::size_t> allocationCount(0);
+
+void * operator new(std::size_t size)
+{
+	++allocationCount;
+	if( void * p = std::malloc(size ? size : 1) ) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+struct Benchmark {
+	std::string name;
+	std::function<void()> run;
+};
+
+// runs fn the given number of times and returns the best time in milliseconds
+double bestOf(int times, std::function<void()> const & fn)
+{
+	double best = 0;
+	for( int i = 0; i < times; ++i ) {
+		auto start = Clock::now();
+		fn();
+		std::chrono::duration<double,std::milli> elapsed = Clock::now() - start;
+		if( i == 0 || elapsed.count() < best ) best = elapsed.count();
+	}
+	return best;
+}
+
+void report(std::string const & label, double ms)
+{
+	std::cout << "  " << label << ": " << ms << " ms" << std::endl;
+}
+
+// failed checks make the run exit with a non-zero status
+int failures = 0;
+
+void check(bool ok, std::string const & what)
+{
+	if( ok ) return;
+	std::cout << "  FAILED: " << what << std::endl;
+	++failures;
+}
+
+template<typename Pixel = img::Pixel32>
+img::Image makeGradient(img::Size width, img::Size height)
+{
+	img::Image image(width,height,sizeof(Pixel)*8);
+	auto y = img::Size(0);
+	for( auto row : image.view<Pixel>() ) {
+		for( img::Size x = 0; x != row.size(); ++x ) {
+			row[x] = Pixel::fromColor({img::Color::component(x),img::Color::component(y),img::Color::component(x ^ y),255});
+		}
+		++y;
+	}
+	return image;
+}
+
+// FreeImage bitmap of a fixed pseudo random content, floats are within [0, 1]
+FIBITMAP * makeNoise(FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned bpp, unsigned seed)
+{
+	FIBITMAP * dib = FreeImage_AllocateT(type,width,height,bpp);
+	auto const isFloat = type == FIT_FLOAT || type == FIT_RGBF || type == FIT_RGBAF;
+	for( unsigned y = 0; y != height; ++y ) {
+		auto bits = FreeImage_GetScanLine(dib,y);
+		for( unsigned i = 0; i != FreeImage_GetLine(dib); i += isFloat ? 4 : 1 ) {
+			seed = seed * 1103515245 + 12345;
+			if( isFloat ) {
+				float const value = float(seed >> 8) / float(1 << 24);
+				std::memcpy(bits + i,&value,4);
+			} else {
+				bits[i] = static_cast<unsigned char>(seed >> 16);
+			}
+		}
+	}
+	return dib;
+}
+
+// the pixels of a FreeImage bitmap without the row padding, then unloads it
+std::vector<unsigned char> takePixels(FIBITMAP * dib)
+{
+	std::vector<unsigned char> pixels;
+	if( !dib ) return pixels;
+	for( unsigned y = 0; y != FreeImage_GetHeight(dib); ++y ) {
+		auto bits = FreeImage_GetScanLine(dib,y);
+		pixels.insert(pixels.end(),bits,bits + FreeImage_GetLine(dib));
+	}
+	FreeImage_Unload(dib);
+	return pixels;
+}
+
+// volatile sink so the compiler can't drop the loops being measured
+volatile unsigned sink;
+
+void benchPixelAccess()
+{
+	auto image = makeGradient(3840,2160);
+
+	report("getColor loop",bestOf(3,[&image]() {
+		unsigned sum = 0;
+		for( img::Size y = 0; y != image.height(); ++y )
+			for( img::Size x = 0; x != image.width(); ++x ) {
+				auto color = image.getColor(x,y);
+				sum += color.r + color.g + color.b;
+			}
+		sink = sum;
+	}));
+
+	report("view<Pixel32> loop",bestOf(3,[&image]() {
+		unsigned sum = 0;
+		for( auto row : image.view<img::Pixel32>() )
+			for( auto & pixel : row ) {
+				sum += pixel.r + pixel.g + pixel.b;
+			}
+		sink = sum;
+	}));
+
+	report("getColor/setColor invert",bestOf(3,[&image]() {
+		for( img::Size y = 0; y != image.height(); ++y )
+			for( img::Size x = 0; x != image.width(); ++x ) {
+				auto color = image.getColor(x,y);
+				image.setColor(x,y,{img::Color::component(255-color.r),img::Color::component(255-color.g),img::Color::component(255-color.b),color.a});
+			}
+	}));
+
+	report("view<Pixel32> invert",bestOf(3,[&image]() {
+		for( auto row : image.view<img::Pixel32>() )
+			for( auto & pixel : row ) {
+				pixel.r = 255 - pixel.r;
+				pixel.g = 255 - pixel.g;
+				pixel.b = 255 - pixel.b;
+			}
+	}));
+}
+
+void benchReplaceColors()
+{
+	auto image = makeGradient(3840,2160);
+	auto isKey = [](img::Color color) { return color.r == 10 && color.g == 20; };
+	auto clearAlpha = [](img::Color color) { color.a = 0; return color; };
+
+	report("getColor/setColor replace",bestOf(3,[&]() {
+		for( img::Size y = 0; y != image.height(); ++y )
+			for( img::Size x = 0; x != image.width(); ++x ) {
+				auto color = image.getColor(x,y);
+				if( isKey(color) ) image.setColor(x,y,clearAlpha(color));
+			}
+	}));
+
+	report("replaceColors with lambdas",bestOf(3,[&]() {
+		image.replaceColors(isKey,clearAlpha);
+	}));
+
+	report("replace exact color",bestOf(3,[&]() {
+		image.replace({10,20,30,255},{10,20,30,0});
+	}));
+
+	report("makeTransparent color range",bestOf(3,[&]() {
+		image.makeTransparent({10,20,0,0},{10,20,255,255});
+	}));
+
+	// 24bpp predicates see the alpha of getColor()
+	auto image24 = makeGradient<img::Pixel24>(64,64);
+	auto const key = image24.getColor(5,7);
+	image24.replaceColors([&](img::Color color) { return color == key; },[](img::Color) { return img::Color{255,0,255,0}; });
+	check(image24.getColor(5,7) == img::Color{255,0,255,0},"replaceColors of a 24bpp key");
+}
+
+// FreeImage_ApplyColorMapping of 8, 24 and 32-bit images as the linear search it used to be: 
+// each color gets the first mapping whose source, or with swap destination, color matches it
+unsigned applyColorMappingLinear(FIBITMAP * dib, RGBQUAD const * srcColors, RGBQUAD const * dstColors, unsigned count, bool ignoreAlpha, bool swap)
+{
+	auto const bpp = FreeImage_GetBPP(dib);
+	auto const withAlpha = bpp == 32 && !ignoreAlpha;
+	RGBQUAD const * const mappings[2][2] = {{srcColors,dstColors},{dstColors,srcColors}};
+	// palette entries have the byte order of the pixels
+	auto map = [&](unsigned char * p) {
+		for( unsigned j = 0; j != count; ++j ) {
+			for( int i = 0; i != (swap ? 2 : 1); ++i ) {
+				auto const & from = mappings[i][0][j];
+				auto const & to = mappings[i][1][j];
+				if( p[FI_RGBA_BLUE] == from.rgbBlue && p[FI_RGBA_GREEN] == from.rgbGreen && p[FI_RGBA_RED] == from.rgbRed
+					&& (!withAlpha || p[FI_RGBA_ALPHA] == from.rgbReserved) ) {
+					p[FI_RGBA_BLUE] = to.rgbBlue;
+					p[FI_RGBA_GREEN] = to.rgbGreen;
+					p[FI_RGBA_RED] = to.rgbRed;
+					if( withAlpha ) p[FI_RGBA_ALPHA] = to.rgbReserved;
+					return 1u;
+				}
+			}
+		}
+		return 0u;
+	};
+	unsigned changed = 0;
+	if( bpp <= 8 ) {
+		auto palette = reinterpret_cast<unsigned char *>(FreeImage_GetPalette(dib));
+		for( unsigned i = 0; i != FreeImage_GetColorsUsed(dib); ++i ) changed += map(palette + i * 4);
+		return changed;
+	}
+	for( unsigned y = 0; y != FreeImage_GetHeight(dib); ++y ) {
+		auto bits = FreeImage_GetScanLine(dib,y);
+		for( unsigned x = 0; x != FreeImage_GetWidth(dib); ++x ) changed += map(bits + x * (bpp / 8));
+	}
+	return changed;
+}
+
+// the hashed mapping table of FreeImage_ApplyColorMapping against the linear search
+void checkColorMappingTable()
+{
+	unsigned seed = 400;
+	// 4 levels per channel, so that pixels match keys and keys repeat
+	auto level = [&seed]() { seed = seed * 1103515245 + 12345; return static_cast<unsigned char>((seed >> 16) % 4 * 0x55); };
+	unsigned const sizes[][2] = {{37,17},{300,5},{1,9}};
+	for( unsigned bpp : {8u,24u,32u} ) {
+		for( auto const & size : sizes ) {
+			FIBITMAP * image = FreeImage_Allocate(size[0],size[1],bpp);
+			for( unsigned y = 0; y != size[1]; ++y ) {
+				auto bits = FreeImage_GetScanLine(image,y);
+				for( unsigned i = 0; i != FreeImage_GetLine(image); ++i ) bits[i] = level();
+			}
+			if( bpp == 8 ) {
+				auto palette = reinterpret_cast<unsigned char *>(FreeImage_GetPalette(image));
+				for( unsigned i = 0; i != 256 * 4; ++i ) palette[i] = level();
+			}
+			for( unsigned count : {1u,3u,40u,300u} ) {
+				std::vector<RGBQUAD> srcColors(count), dstColors(count);
+				for( unsigned j = 0; j != count; ++j ) {
+					srcColors[j] = {level(),level(),level(),level()};
+					dstColors[j] = {level(),level(),level(),level()};
+				}
+				for( int ignoreAlpha = 0; ignoreAlpha != 2; ++ignoreAlpha ) {
+					for( int swap = 0; swap != 2; ++swap ) {
+						FIBITMAP * hashed = FreeImage_Clone(image);
+						FIBITMAP * linear = FreeImage_Clone(image);
+						auto const changed = FreeImage_ApplyColorMapping(hashed,srcColors.data(),dstColors.data(),count,ignoreAlpha,swap);
+						auto const expected = applyColorMappingLinear(linear,srcColors.data(),dstColors.data(),count,ignoreAlpha != 0,swap != 0);
+						bool const samePalette = bpp != 8 || std::memcmp(FreeImage_GetPalette(hashed),FreeImage_GetPalette(linear),256 * 4) == 0;
+						auto const what = std::to_string(bpp) + "bpp " + std::to_string(size[0]) + "x" + std::to_string(size[1]) + ", " + std::to_string(count)
+							+ " mappings" + (ignoreAlpha ? ", ignore alpha" : "") + (swap ? ", swap" : "");
+						check(changed == expected && samePalette && takePixels(hashed) == takePixels(linear),what + " matches the linear search");
+					}
+				}
+			}
+			FreeImage_Unload(image);
+		}
+	}
+}
+
+void benchColorMapping()
+{
+	// a 256 color image, in blocks of 16x4 pixels, recolored by cycling its colors
+	auto paletteColor = [](unsigned i) { return img::Color{img::Color::component(i),img::Color::component(255 - i),img::Color::component(i * 7),255}; };
+	img::Image image(4000,3000,32);
+	auto view = image.view<img::Pixel32>();
+	for( img::Size y = 0; y != view.height(); ++y )
+		for( img::Size x = 0; x != view.width(); ++x ) view[y][x] = img::Pixel32::fromColor(paletteColor((x / 16 + y / 4 * 7) & 255));
+
+	for( unsigned colors : {64u,256u} ) {
+		std::vector<std::pair<img::Color,img::Color>> colorMap;
+		for( unsigned i = 0; i != colors; ++i ) colorMap.push_back({paletteColor(i),paletteColor((i + 1) % colors)});
+		report(std::to_string(colors) + " replace calls",bestOf(3,[&]() {
+			for( auto const & mapping : colorMap ) image.replace(mapping.first,mapping.second);
+		}));
+		report("replace map of " + std::to_string(colors) + " colors",bestOf(3,[&]() { image.replace(colorMap); }));
+	}
+	checkColorMappingTable();
+}
+
+void benchJpegDecodeToSize()
+{
+	std::ostringstream encoded;
+	makeGradient<img::Pixel24>(6000,4000).save(encoded,img::JPG);
+	auto const jpeg = encoded.str();
+
+	for( img::Size size : {0u,1500u,256u} ) {
+		img::LoadOptions options;
+		options.minimumSize = size;
+		img::Size width = 0;
+		auto ms = bestOf(3,[&]() {
+			std::istringstream iss(jpeg);
+			img::Image image(iss,img::JPG,options);
+			width = image.width();
+		});
+		report("minimumSize " + std::to_string(size) + " -> width " + std::to_string(width),ms);
+	}
+}
+
+void benchStreamSave()
+{
+	auto image = makeGradient<img::Pixel24>(3840,2160);
+	for( std::string ext : {".bmp",".png",".jpg"} ) {
+		auto filename = "libimagebench_tmp" + ext;
+		auto type = img::TypeFromExtension(ext);
+		report("save to file " + ext,bestOf(3,[&]() {
+			image.save(filename);
+		}));
+		report("save to ofstream " + ext,bestOf(3,[&]() {
+			std::ofstream ofs(filename,std::ios::binary);
+			image.save(ofs,type);
+		}));
+		// the in-memory streams isolate the adapter overhead from the file system
+		report("save to ostringstream " + ext,bestOf(3,[&]() {
+			std::ostringstream oss;
+			image.save(oss,type);
+		}));
+		report("load from file " + ext,bestOf(3,[&]() {
+			img::Image loaded(filename);
+		}));
+		report("load from ifstream " + ext,bestOf(3,[&]() {
+			std::ifstream ifs(filename,std::ios::binary);
+			img::Image loaded(ifs,type);
+		}));
+		auto encoded = image.encode(type);
+		auto const bytes = std::string(encoded.begin(),encoded.end());
+		report("load from istringstream " + ext,bestOf(3,[&]() {
+			std::istringstream iss(bytes);
+			img::Image loaded(iss,type);
+		}));
+		std::remove(filename.c_str());
+	}
+}
+
+void benchMappedLoad()
+{
+	auto image = makeGradient<img::Pixel24>(7680,4320);
+	img::LoadOptions mapped;
+	mapped.memoryMap = true;
+	for( std::string ext : {".bmp",".tga",".png"} ) {
+		auto filename = "libimagebench_tmp" + ext;
+		image.save(filename);
+		report("load " + ext,bestOf(3,[&]() {
+			img::Image loaded(filename);
+		}));
+		report("load mapped " + ext,bestOf(3,[&]() {
+			img::Image loaded(filename,mapped);
+		}));
+		std::remove(filename.c_str());
+	}
+}
+
+void benchBitmapPool()
+{
+	auto image = makeGradient(3840,2160);
+	auto job = [&image]() {
+		for( int i = 0; i != 20; ++i ) {
+			auto copy = image.clone();
+			sink = copy.clip(0,0,1919,1079).width();
+		}
+	};
+	report("clone + clip x20",bestOf(3,job));
+
+	img::BitmapPool pool;
+	img::setThreadBitmapPool(&pool);
+	report("clone + clip x20 pooled",bestOf(3,job));
+	img::setThreadBitmapPool(nullptr);
+
+	auto stats = pool.stats();
+	std::cout << "  pool hits " << stats.hits << ", misses " << stats.misses
+		<< ", peak " << (stats.peakBytes >> 20) << " MB, cached " << (stats.bytesCached >> 20) << " MB" << std::endl;
+}
+
+void benchInPlaceTransforms()
+{
+	auto image = makeGradient(4000,4000);
+	report("flipH copy",bestOf(3,[&]() { sink = image.flipH().width(); }));
+	report("flipH in place",bestOf(3,[&]() { sink = image.flipHInPlace().width(); }));
+	report("flipV copy",bestOf(3,[&]() { sink = image.flipV().width(); }));
+	report("flipV in place",bestOf(3,[&]() { sink = image.flipVInPlace().width(); }));
+	report("rotate 90 copy",bestOf(3,[&]() { sink = image.rotate(90).width(); }));
+	report("rotate 90 in place",bestOf(3,[&]() { sink = image.rotateInPlace(90).width(); }));
+	report("rotate 180 copy",bestOf(3,[&]() { sink = image.rotate(180).width(); }));
+	report("rotate 180 in place",bestOf(3,[&]() { sink = image.rotateInPlace(180).width(); }));
+}
+
+void benchFlips()
+{
+	auto color = makeGradient<img::Pixel24>(4000,3000);
+	auto alpha = makeGradient(4000,3000);
+	report("24bpp flipH in place",bestOf(5,[&]() { sink = color.flipHInPlace().width(); }));
+	report("24bpp flipV in place",bestOf(5,[&]() { sink = color.flipVInPlace().width(); }));
+	report("32bpp flipH in place",bestOf(5,[&]() { sink = alpha.flipHInPlace().width(); }));
+	report("32bpp flipV in place",bestOf(5,[&]() { sink = alpha.flipVInPlace().width(); }));
+}
+
+void benchOrientation()
+{
+	// EXIF orientation turns most camera images on load
+	auto color = makeGradient<img::Pixel24>(4000,3000);
+	for( int angle : {90,180,270} ) {
+		report("24bpp rotate " + std::to_string(angle),bestOf(3,[&]() { sink = color.rotate(angle).width(); }));
+	}
+	report("24bpp rotate 180 in place",bestOf(3,[&]() { sink = color.rotateInPlace(180).width(); }));
+
+	auto alpha = makeGradient(4000,3000);
+	for( int angle : {90,180,270} ) {
+		report("32bpp rotate " + std::to_string(angle),bestOf(3,[&]() { sink = alpha.rotate(angle).width(); }));
+	}
+	report("32bpp rotate 180 in place",bestOf(3,[&]() { sink = alpha.rotateInPlace(180).width(); }));
+
+	img::Image grey(4000,3000,8);
+	for( int angle : {90,270} ) {
+		report("8bpp rotate " + std::to_string(angle),bestOf(3,[&]() { sink = grey.rotate(angle).width(); }));
+	}
+}
+
+void benchArbitraryRotation()
+{
+	auto color = makeGradient<img::Pixel24>(3000,2000);
+	for( unsigned threads : {1u,img::threadCount()} ) {
+		img::setRotateThreadCount(threads);
+		auto const suffix = " (" + std::to_string(threads) + " threads)";
+		for( double angle : {5.0,30.0,45.0,100.0} ) {
+			report("24bpp shear rotate " + std::to_string(int(angle)) + suffix,bestOf(3,[&]() { sink = color.rotate(angle).width(); }));
+		}
+		for( double angle : {5.0,30.0} ) {
+			report("24bpp spline rotate " + std::to_string(int(angle)) + suffix,bestOf(3,[&]() { sink = color.rotateSpline(angle).width(); }));
+		}
+		if( img::threadCount() == 1 ) break;
+	}
+	img::setRotateThreadCount(1);
+}
+
+// shear and B-spline rotations split over 1, 2, 3 and at least 8 threads give the same bytes
+void benchRotationThreads()
+{
+	struct Format { FREE_IMAGE_TYPE type; unsigned bpp; char const * name; };
+	Format const formats[] = {{FIT_BITMAP,8,"8bpp"},{FIT_BITMAP,24,"24bpp"},{FIT_BITMAP,32,"32bpp"},{FIT_UINT16,16,"UINT16"},{FIT_RGBF,96,"RGBF"}};
+	unsigned const sizes[][2] = {{301,203},{7,180},{250,5}};
+	unsigned const threads[] = {1,2,3,std::max(8u,img::threadCount())};
+
+	unsigned seed = 300;
+	for( auto const & format : formats ) {
+		for( auto const & size : sizes ) {
+			FIBITMAP * src = makeNoise(format.type,size[0],size[1],format.bpp,seed++);
+			for( double angle : {17.0,-33.5,200.0} ) {
+				auto const what = std::string(format.name) + " " + std::to_string(size[0]) + "x" + std::to_string(size[1]) + " by " + std::to_string(angle);
+				std::vector<unsigned char> shear[4], spline[4];
+				for( int i = 0; i != 4; ++i ) {
+					FreeImage_SetRotateThreads(threads[i]);
+					shear[i] = takePixels(FreeImage_Rotate(src,angle));
+					// the B-spline rotation takes 8-bit per channel images
+					if( format.type == FIT_BITMAP ) spline[i] = takePixels(FreeImage_RotateEx(src,angle,1.5,-2.0,size[0] / 3.0,size[1] / 2.0,TRUE));
+				}
+				check(!shear[0].empty() && (format.type != FIT_BITMAP || !spline[0].empty()),what + " rotated");
+				for( int i = 1; i != 4; ++i ) {
+					check(shear[i] == shear[0],what + ": shear rotation on " + std::to_string(threads[i]) + " threads");
+					check(spline[i] == spline[0],what + ": B-spline rotation on " + std::to_string(threads[i]) + " threads");
+				}
+			}
+			FreeImage_Unload(src);
+		}
+	}
+	FreeImage_SetRotateThreads(1);
+}
+
+void benchComposite()
+{
+	auto background = makeGradient(3840,2160);
+	auto overlay = makeGradient(1920,1080);
+	// semi-transparent overlay, as a watermark
+	for( auto row : overlay.view<img::Pixel32>() ) {
+		for( img::Size x = 0; x != row.size(); ++x ) row[x].a = img::Color::component(x);
+	}
+
+	report("per-pixel over loop",bestOf(3,[&]() {
+		auto dst = background.view<img::Pixel32>();
+		auto src = overlay.view<img::Pixel32>();
+		for( img::Size y = 0; y != src.height(); ++y ) {
+			for( img::Size x = 0; x != src.width(); ++x ) {
+				auto const & s = src[y][x];
+				auto & d = dst[y + 540][x + 960];
+				float const sa = s.a / 255.0f, da = d.a / 255.0f * (1 - sa), a = sa + da;
+				if( a > 0 ) {
+					d.b = img::Color::component((s.b * sa + d.b * da) / a + 0.5f);
+					d.g = img::Color::component((s.g * sa + d.g * da) / a + 0.5f);
+					d.r = img::Color::component((s.r * sa + d.r * da) / a + 0.5f);
+				}
+				d.a = img::Color::component(a * 255 + 0.5f);
+			}
+		}
+	}));
+	std::pair<char const *,img::BlendMode> const modes[] = {{"over",img::BlendMode::over},
+		{"premultiplied over",img::BlendMode::premultipliedOver},{"add",img::BlendMode::add},{"multiply",img::BlendMode::multiply}};
+	for( auto const & mode : modes ) {
+		report(std::string("composite ") + mode.first,bestOf(3,[&]() { background.composite(overlay,960,540,mode.second); }));
+	}
+	if( img::threadCount() > 1 ) {
+		report("composite over, parallel",bestOf(3,[&]() { background.composite(overlay,960,540,img::BlendMode::over,img::parallel); }));
+	}
+}
+
+// the SSE2 and AVX2 blend kernels against BlendPixel, over offset and clipped rectangles
+void benchSIMDBlend()
+{
+	std::pair<char const *,FREE_IMAGE_BLEND_MODE> const modes[] = {{"over",FIBLEND_OVER},
+		{"premultiplied over",FIBLEND_PREMULTIPLIED_OVER},{"add",FIBLEND_ADD},{"multiply",FIBLEND_MULTIPLY}};
+	// source size and position in a 67x45 destination
+	int const placements[][4] = {{31,19,0,0},{31,19,5,7},{31,19,-9,-4},{31,19,50,30},{101,60,-13,-6},{67,45,0,0},{3,45,64,0}};
+	int const levels[] = {FI_SIMD_NONE,FI_SIMD_SSE2,FI_SIMD_AVX2};
+	char const * const levelNames[] = {"scalar","SSE2","AVX2"};
+
+	unsigned seed = 100;
+	for( auto const & mode : modes ) {
+		for( auto const & placement : placements ) {
+			FIBITMAP * dst = makeNoise(FIT_BITMAP,67,45,32,seed++);
+			FIBITMAP * src = makeNoise(FIT_BITMAP,placement[0],placement[1],32,seed++);
+			if( mode.second == FIBLEND_PREMULTIPLIED_OVER ) {
+				FreeImage_PreMultiplyWithAlpha(dst);
+				FreeImage_PreMultiplyWithAlpha(src);
+			}
+			std::vector<unsigned char> results[3];
+			for( int i = 0; i != 3; ++i ) {
+				FreeImage_SetSIMDLevel(levels[i]);
+				FIBITMAP * blended = FreeImage_Clone(dst);
+				check(FreeImage_Blend(blended,src,placement[2],placement[3],mode.second,FI_BLEND_DEFAULT) != FALSE,std::string("blend ") + mode.first);
+				results[i] = takePixels(blended);
+			}
+			auto const what = std::string(mode.first) + " " + std::to_string(placement[0]) + "x" + std::to_string(placement[1])
+				+ " at " + std::to_string(placement[2]) + "," + std::to_string(placement[3]);
+			for( int i = 1; i != 3; ++i ) check(results[i] == results[0],what + ": " + levelNames[i] + " matches BlendPixel");
+			FreeImage_Unload(src);
+			FreeImage_Unload(dst);
+		}
+	}
+	FreeImage_SetSIMDLevel(FI_SIMD_AVX2);
+}
+
+void benchPremultipliedAlpha()
+{
+	auto image = makeGradient(4000,3000);
+	for( auto row : image.view<img::Pixel32>() ) {
+		for( img::Size x = 0; x != row.size(); ++x ) row[x].a = img::Color::component(x);
+	}
+
+	report("per-pixel premultiply loop",bestOf(3,[&]() {
+		for( auto row : image.view<img::Pixel32>() ) {
+			for( auto & p : row ) {
+				p.b = img::Color::component((p.b * p.a + 127) / 255);
+				p.g = img::Color::component((p.g * p.a + 127) / 255);
+				p.r = img::Color::component((p.r * p.a + 127) / 255);
+			}
+		}
+	}));
+	report("premultiply + unpremultiply",bestOf(3,[&]() { image.premultiplyInPlace().unpremultiplyInPlace(); }));
+	// alpha-correct downscale: convert around each resize, or keep the image premultiplied
+	report("premultiply, resize 1/2, unpremultiply",bestOf(3,[&]() {
+		auto copy = image.clone();
+		sink = copy.premultiplyInPlace().resize(2000,1500,img::bilinear).unpremultiplyInPlace().width();
+	}));
+	auto premultiplied = image.clone();
+	premultiplied.premultiplyInPlace();
+	report("resize 1/2 premultiplied",bestOf(3,[&]() { sink = premultiplied.resize(2000,1500,img::bilinear).width(); }));
+
+	// the color functions of a premultiplied image take and give straight colors, and keep the pixels valid
+	auto small = makeGradient(64,64);
+	for( auto row : small.view<img::Pixel32>() ) {
+		for( img::Size x = 0; x != row.size(); ++x ) row[x].a = img::Color::component(x * 4);
+	}
+	small.premultiplyInPlace();
+	// alpha 51 = 255/5 keeps multiples of 5 exact through both conversions
+	small.setColor(3,5,{200,100,50,51});
+	check(small.view<img::Pixel32>()[5][3].r == 40,"setColor premultiplies the color");
+	check(small.getColor(3,5) == img::Color{200,100,50,51},"getColor unpremultiplies the color");
+	auto key = small.getColor(40,9);
+	small.replace(key,{1,2,3,255});
+	check(small.getColor(40,9) == img::Color{1,2,3,255},"replace matches and writes straight colors");
+	small.makeTransparent({0,0,0,0},{255,255,255,255});
+	bool valid = true;
+	for( auto row : small.view<img::Pixel32>() ) {
+		for( auto & p : row ) valid = valid && p.a == 0 && p.r == 0 && p.g == 0 && p.b == 0;
+	}
+	check(valid,"makeTransparent of a premultiplied image clears the colors");
+	bool threw = false;
+	try { small.pasteFrom(makeGradient(8,8),0,0); } catch( std::exception const & ) { threw = true; }
+	check(threw,"pasteFrom refuses a straight image onto a premultiplied one");
+}
+
+void benchJpegTransform()
+{
+	auto const jpeg = makeGradient<img::Pixel24>(4000,3000).encode(img::JPG);
+
+	report("decode + rotate 90 + encode",bestOf(3,[&]() {
+		img::Image image(jpeg.data(),jpeg.size(),img::JPG);
+		sink = image.rotate(-90).encode(img::JPG).size();
+	}));
+	report("lossless rotate 90",bestOf(3,[&]() {
+		sink = img::jpeg::transform(jpeg.data(),jpeg.size(),img::jpeg::Transform::rotate90).size();
+	}));
+	report("lossless crop 1000x1000",bestOf(3,[&]() {
+		img::jpeg::Rect rect;
+		rect.left = rect.top = 1000;
+		rect.right = rect.bottom = 2000;
+		sink = img::jpeg::crop(jpeg.data(),jpeg.size(),rect).size();
+	}));
+}
+
+void benchIntoBuffers()
+{
+	auto image = makeGradient(1920,1080);
+	int const frames = 100;
+
+	report("toRawBits + resize x100",bestOf(3,[&]() {
+		for( int i = 0; i != frames; ++i ) {
+			auto bits = image.toRawBits(32);
+			sink = image.resize(480,270,img::bilinear).width() + bits[0];
+		}
+	}));
+
+	std::vector<unsigned char> staging(std::size_t(image.width()) * 4 * image.height());
+	img::Image frame(480,270,32);
+	img::BitmapPool pool;
+	img::setThreadBitmapPool(&pool);
+	auto frameLoop = [&]() {
+		for( int i = 0; i != frames; ++i ) {
+			image.toRawBits(staging.data(),staging.size(),32,image.width() * 4);
+			image.resizeInto(frame,img::bilinear);
+		}
+	};
+	frameLoop();	// warm up the pool
+	report("toRawBits + resizeInto x100",bestOf(3,frameLoop));
+
+	// counted around the loop alone, bestOf and report allocate themselves
+	auto allocations = allocationCount.load();
+	auto misses = pool.stats().misses;
+	frameLoop();
+	auto const newCalls = allocationCount.load() - allocations;
+	auto const bitmapAllocations = pool.stats().misses - misses;
+	std::cout << "  steady state: " << newCalls << " operator new calls, " << bitmapAllocations << " bitmap allocations" << std::endl;
+	check(newCalls == 0 && bitmapAllocations == 0,"toRawBits + resizeInto allocate nothing once warm");
+	img::setThreadBitmapPool(nullptr);
+}
+
+void benchRescale()
+{
+	for( unsigned bpp : {24u,32u} ) {
+		auto image = bpp == 24 ? makeGradient<img::Pixel24>(4000,3000) : makeGradient(4000,3000);
+		for( auto filter : {img::bilinear,img::bicubic,img::lanczos3} ) {
+			auto const name = filter == img::bilinear ? "bilinear" : filter == img::bicubic ? "bicubic" : "lanczos3";
+			for( auto size : {std::make_pair(1920u,1080u),std::make_pair(256u,256u)} ) {
+				report(std::to_string(bpp) + "bpp " + name + " -> " + std::to_string(size.first) + "x" + std::to_string(size.second),bestOf(3,[&]() {
+					sink = image.resize(size.first,size.second,filter).width();
+				}));
+			}
+		}
+	}
+}
+
+// the SSE2 and AVX2 resampling kernels against the plain C++ filters, byte for byte
+void benchSIMDRescale()
+{
+	struct Format { FREE_IMAGE_TYPE type; unsigned bpp; char const * name; };
+	Format const formats[] = {{FIT_BITMAP,8,"8bpp"},{FIT_BITMAP,24,"24bpp"},{FIT_BITMAP,32,"32bpp"},{FIT_RGBF,96,"RGBF"},{FIT_RGBAF,128,"RGBAF"}};
+	struct Filter { FREE_IMAGE_FILTER filter; char const * name; };
+	Filter const filters[] = {{FILTER_BOX,"box"},{FILTER_BILINEAR,"bilinear"},{FILTER_BSPLINE,"bspline"},{FILTER_CATMULLROM,"catmullrom"},{FILTER_LANCZOS3,"lanczos3"}};
+	unsigned const sizes[][4] = {{37,23,13,7},{37,23,71,45},{101,67,33,67},{101,67,101,19},{15,97,41,5},{250,3,17,11}};
+	int const levels[] = {FI_SIMD_NONE,FI_SIMD_SSE2,FI_SIMD_AVX2};
+	char const * const levelNames[] = {"scalar","SSE2","AVX2"};
+
+	unsigned seed = 1;
+	for( auto const & format : formats ) {
+		for( auto const & size : sizes ) {
+			FIBITMAP * src = makeNoise(format.type,size[0],size[1],format.bpp,seed++);
+			for( auto const & filter : filters ) {
+				std::vector<unsigned char> results[3];
+				for( int i = 0; i != 3; ++i ) {
+					FreeImage_SetSIMDLevel(levels[i]);
+					results[i] = takePixels(FreeImage_Rescale(src,size[2],size[3],filter.filter));
+				}
+				auto const what = std::string(format.name) + " " + filter.name + " " + std::to_string(size[0]) + "x" + std::to_string(size[1])
+					+ " -> " + std::to_string(size[2]) + "x" + std::to_string(size[3]);
+				check(!results[0].empty(),what + " rescaled");
+				for( int i = 1; i != 3; ++i ) check(results[i] == results[0],what + ": " + levelNames[i] + " matches the scalar filter");
+			}
+			FreeImage_Unload(src);
+		}
+	}
+
+	auto image = makeGradient<img::Pixel24>(4000,3000);
+	for( int i = 0; i != 3; ++i ) {
+		FreeImage_SetSIMDLevel(levels[i]);
+		report(std::string("24bpp lanczos3 -> 1920x1080 ") + levelNames[i],bestOf(3,[&]() { sink = image.resize(1920,1080,img::lanczos3).width(); }));
+	}
+	FreeImage_SetSIMDLevel(FI_SIMD_AVX2);
+}
+
+void benchParallelRescale()
+{
+	auto image = makeGradient(8000,6000);
+	std::cout << "  " << img::threadCount() << " threads" << std::endl;
+	for( auto filter : {img::bilinear,img::lanczos3} ) {
+		auto const name = std::string(filter == img::bilinear ? "bilinear" : "lanczos3");
+		report(name + " -> 3840x2160 sequential",bestOf(3,[&]() {
+			sink = image.resize(3840,2160,filter,img::sequential).width();
+		}));
+		report(name + " -> 3840x2160 parallel",bestOf(3,[&]() {
+			sink = image.resize(3840,2160,filter,img::parallel).width();
+		}));
+	}
+}
+
+// the filter passes split over 1, 2, 3 and at least 8 threads give the same bytes
+void benchRescaleThreads()
+{
+	struct Format { FREE_IMAGE_TYPE type; unsigned bpp; char const * name; };
+	Format const formats[] = {{FIT_BITMAP,8,"8bpp"},{FIT_BITMAP,24,"24bpp"},{FIT_BITMAP,32,"32bpp"},{FIT_RGBF,96,"RGBF"},{FIT_RGBAF,128,"RGBAF"}};
+	unsigned const sizes[][4] = {{301,203,157,97},{301,203,613,411},{1000,7,333,3},{9,700,5,1111}};
+	unsigned const threads[] = {2,3,std::max(8u,img::threadCount())};
+
+	unsigned seed = 200;
+	for( auto const & format : formats ) {
+		for( auto const & size : sizes ) {
+			FIBITMAP * src = makeNoise(format.type,size[0],size[1],format.bpp,seed++);
+			for( auto filter : {FILTER_BILINEAR,FILTER_LANCZOS3} ) {
+				auto rescale = [&](unsigned count) {
+					return takePixels(FreeImage_RescaleRect(src,size[2],size[3],0,0,size[0],size[1],filter,FI_RESCALE_THREADS(count)));
+				};
+				auto const reference = rescale(1);
+				auto const what = std::string(format.name) + (filter == FILTER_BILINEAR ? " bilinear " : " lanczos3 ") + std::to_string(size[0]) + "x" + std::to_string(size[1])
+					+ " -> " + std::to_string(size[2]) + "x" + std::to_string(size[3]);
+				check(!reference.empty(),what + " rescaled");
+				for( auto count : threads ) check(rescale(count) == reference,what + " on " + std::to_string(count) + " threads");
+			}
+			FreeImage_Unload(src);
+		}
+	}
+}
+
+// the vertical pass alone (same width) against the horizontal pass alone (same height)
+void benchWideRescale()
+{
+	auto image = makeGradient(7680,4320);
+	for( auto filter : {img::bilinear,img::lanczos3} ) {
+		auto const name = std::string(filter == img::bilinear ? "bilinear" : "lanczos3");
+		report(name + " horizontal -> 3840x4320",bestOf(3,[&]() { sink = image.resize(3840,4320,filter).width(); }));
+		report(name + " vertical -> 7680x2160",bestOf(3,[&]() { sink = image.resize(7680,2160,filter).width(); }));
+		report(name + " horizontal -> 480x4320",bestOf(3,[&]() { sink = image.resize(480,4320,filter).width(); }));
+		report(name + " vertical -> 7680x270",bestOf(3,[&]() { sink = image.resize(7680,270,filter).width(); }));
+	}
+}
+
+void benchResizeCache()
+{
+	auto image = makeGradient(640,480);
+	auto job = [&image]() {
+		for( int i = 0; i != 200; ++i ) sink = image.resize(160,120,img::lanczos3).width();
+	};
+	img::setResizeCacheSize(0);
+	report("lanczos3 -> 160x120 x200 uncached",bestOf(3,job));
+	img::setResizeCacheSize(64);
+	auto before = img::resizeCacheStats();
+	report("lanczos3 -> 160x120 x200 cached",bestOf(3,job));
+	auto after = img::resizeCacheStats();
+	std::cout << "  cache hits " << (after.hits - before.hits) << ", misses " << (after.misses - before.misses) << std::endl;
+}
+
+void benchThumbnail()
+{
+	auto image = makeGradient<img::Pixel24>(6000,4000);
+	report("resize bilinear -> 256x171",bestOf(3,[&]() { sink = image.resize(256,171,img::bilinear).width(); }));
+	report("thumbnail fast",bestOf(3,[&]() { sink = image.thumbnail(256,img::ThumbnailQuality::fast).width(); }));
+	report("thumbnail balanced",bestOf(3,[&]() { sink = image.thumbnail(256,img::ThumbnailQuality::balanced).width(); }));
+	report("thumbnail best",bestOf(3,[&]() { sink = image.thumbnail(256,img::ThumbnailQuality::best).width(); }));
+}
+
+void benchPyramid()
+{
+	auto image = makeGradient(4096,4096);
+	report("resize from the source x12",bestOf(3,[&]() {
+		for( unsigned level = 1; level <= 12; ++level ) sink = image.resize(image.width() >> level,image.height() >> level,img::box).width();
+	}));
+	report("buildPyramid box",bestOf(3,[&]() { sink = unsigned(image.buildPyramid(12).size()); }));
+	report("buildPyramid bilinear",bestOf(3,[&]() { sink = unsigned(image.buildPyramid(12,img::bilinear).size()); }));
+	std::vector<unsigned char> buffer(image.pyramidSize(12,32));
+	report("buildPyramid box into buffer",bestOf(3,[&]() { sink = unsigned(image.buildPyramid(buffer.data(),buffer.size(),12,32).size()); }));
+}
+
+void benchRowStream()
+{
+	// the rows of a 30000x30000 scan are generated on the fly, it is never held in memory
+	std::vector<unsigned char> pattern(30000 * 3 + 256);
+	for( std::size_t i = 0; i != pattern.size(); ++i ) pattern[i] = static_cast<unsigned char>(i * 7);
+	auto reader = [&](img::Size width) {
+		return [&pattern,width](img::Size y, unsigned char * row) {
+			std::memcpy(row,pattern.data() + (y & 255),width * 3);
+			return true;
+		};
+	};
+	auto const writer = [](img::Size, unsigned char const * row) { sink = row[0]; return true; };
+
+	auto image = makeGradient<img::Pixel24>(8000,6000);
+	report("resize 8000x6000 in memory to 800x600",bestOf(3,[&]() { sink = image.resize(800,600,img::catmullrom).width(); }));
+	report("resizeRows 8000x6000 to 800x600",bestOf(3,[&]() {
+		img::resizeRows(8000,6000,24,800,600,reader(8000),writer,img::catmullrom);
+	}));
+	report("resizeRows 30000x30000 to 1000x1000",bestOf(1,[&]() {
+		img::resizeRows(30000,30000,24,1000,1000,reader(30000),writer,img::catmullrom);
+	}));
+}
+
+int main(int argc, char * argv[])
+{
+	std::vector<Benchmark> benchmarks = {
+		{"pixel access 3840x2160x32",benchPixelAccess},
+		{"replace colors 3840x2160x32",benchReplaceColors},
+		{"color mapping 4000x3000x32",benchColorMapping},
+		{"jpeg decode to size 6000x4000",benchJpegDecodeToSize},
+		{"stream save/load 3840x2160x24",benchStreamSave},
+		{"mapped load 7680x4320x24",benchMappedLoad},
+		{"bitmap pool 3840x2160x32",benchBitmapPool},
+		{"in-place transforms 4000x4000x32",benchInPlaceTransforms},
+		{"flips 4000x3000",benchFlips},
+		{"orientation 4000x3000",benchOrientation},
+		{"arbitrary rotation 3000x2000x24",benchArbitraryRotation},
+		{"composite 1920x1080 onto 3840x2160",benchComposite},
+		{"rotation threads",benchRotationThreads},
+		{"simd blend",benchSIMDBlend},
+		{"premultiplied alpha 4000x3000",benchPremultipliedAlpha},
+		{"jpeg transform 4000x3000",benchJpegTransform},
+		{"into buffers 1920x1080x32",benchIntoBuffers},
+		{"rescale 4000x3000",benchRescale},
+		{"simd rescale",benchSIMDRescale},
+		{"rescale threads",benchRescaleThreads},
+		{"parallel rescale 8000x6000x32",benchParallelRescale},
+		{"wide rescale 7680x4320x32",benchWideRescale},
+		{"resize cache 640x480x32",benchResizeCache},
+		{"thumbnail 6000x4000x24",benchThumbnail},
+		{"pyramid 4096x4096x32",benchPyramid},
+		{"row stream 30000x30000x24",benchRowStream},
+	};
+
+	// optional argument: run only benchmarks whose name contains it
+	auto filter = std::string(argc > 1 ? argv[1] : "");
+	for( auto & benchmark : benchmarks ) {
+		if( benchmark.name.find(filter) == std::string::npos ) continue;
+		std::cout << benchmark.name << std::endl;
+		benchmark.run();
+	}
+	return failures ? 1 : 0;
+}
@@ -1,10 +1,42 @@
 #include "image.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <exception>
+#include <mutex>
+#include <new>
 #include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <FreeImage.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define LIBIMAGE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIBIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+// the AVX2 kernels are compiled for that target and only used when the processor supports it
+#if defined(LIBIMAGE_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define LIBIMAGE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LIBIMAGE_TARGET_AVX2
+#else
+#define LIBIMAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 namespace img {
 
 FREE_IMAGE_FORMAT type2fif(Type type)
@@ -41,6 +73,61 @@ FREE_IMAGE_FILTER convertFilter(ResizeFilter filter)
 	}
 }
 
+int convertQuality(ThumbnailQuality quality)
+{
+	switch(quality) {
+		case ThumbnailQuality::balanced: return FI_THUMBNAIL_BALANCED;
+		case ThumbnailQuality::best: return FI_THUMBNAIL_BEST;
+		default: return FI_THUMBNAIL_FAST;
+	}
+}
+
+std::atomic<unsigned> configuredThreadCount(0);
+
+// the FreeImage rescale flags running the filter passes on the threads of policy
+unsigned rescaleFlags(ExecutionPolicy policy)
+{
+	return FI_RESCALE_THREADS(std::min(policy.threads ? policy.threads : threadCount(),255u));
+}
+
+int loadFlags(FREE_IMAGE_FORMAT fif, LoadOptions const & options)
+{
+	int flags = 0;
+	switch(fif) {
+		case FIF_JPEG:
+			flags |= options.accurate ? JPEG_ACCURATE : JPEG_FAST;
+			if( options.exifRotate ) flags |= JPEG_EXIFROTATE;
+			if( options.greyscale ) flags |= JPEG_GREYSCALE;
+			// the JPEG plugin reads the requested size from the upper 16 bits
+			flags |= int(std::min<Size>(options.minimumSize,0x7FFF)) << 16;
+			break;
+		case FIF_RAW:
+			if( options.rawPreview ) flags |= RAW_PREVIEW;
+			if( options.rawHalfSize ) flags |= RAW_HALFSIZE;
+			break;
+		case FIF_PNG:
+			if( options.ignoreGamma ) flags |= PNG_IGNOREGAMMA;
+			break;
+		case FIF_GIF:
+			if( options.gifPlayback ) flags |= GIF_PLAYBACK;
+			break;
+		default:
+			break;
+	}
+	return flags;
+}
+
+using MemoryPtr = std::unique_ptr<FIMEMORY,decltype(&FreeImage_CloseMemory)>;
+
+// wraps data without copying it. the memory stream must only be read from
+MemoryPtr openMemory(void const * data, std::size_t size)
+{
+	if( size > std::numeric_limits<DWORD>::max() ) throw std::runtime_error("image buffer is too large");
+	MemoryPtr result(FreeImage_OpenMemory(static_cast<BYTE *>(const_cast<void *>(data)),DWORD(size)),&FreeImage_CloseMemory);
+	if( ! result ) throw std::runtime_error("error opening memory stream");
+	return result;
+}
+
 RGBQUAD toRgbQuad(Color color) {
 	RGBQUAD result;
 	result.rgbRed = color.r;
@@ -63,24 +150,30 @@ Image::Image(Size width, Size height, int bpp):
 	}
 }
 
-Image::Image(char const * filename)
+Image::Image(char const * filename, LoadOptions const & options)
+{
+	load(filename,options);
+}
+
+Image::Image(std::string const & filename, LoadOptions const & options)
 {
-	load(filename);
+	load(filename.c_str(),options);
 }
 
-Image::Image(std::string const & filename)
+Image::Image(std::istream & stream, Type type, LoadOptions const & options)
 {
-	load(filename.c_str());
+	load(stream,type,options);
 }
 
-Image::Image(std::istream & stream, Type type)
+Image::Image(void const * data, std::size_t size, Type type, LoadOptions const & options)
 {
-	load(stream,type);
+	load(data,size,type,options);
 }
 
-Image::Image(FIBITMAP * image, int type):
+Image::Image(FIBITMAP * image, int type, bool premultiplied):
 	image(image),
-	type(type)
+	type(type),
+	premultipliedAlpha(premultiplied)
 {
 }
 
@@ -91,7 +184,7 @@ void Image::Deleter::operator()(FIBITMAP * image) const
 	FreeImage_Unload(image);
 }
 
-void Image::load(char const * filename)
+FREE_IMAGE_FORMAT detectFormat(char const * filename)
 {
 	// check the file signature and deduce its format
 	// (the second argument is currently not used by FreeImage)
@@ -105,14 +198,151 @@ void Image::load(char const * filename)
 
 	// check that the plugin has reading capabilities ...
 	if( ! FreeImage_FIFSupportsReading(fif) ) throw std::runtime_error("plugin can't load image");
+	return fif;
+}
+
+void Image::reset(FIBITMAP * dib, int type, std::shared_ptr<void> mapping)
+{
+	// the old bitmap may live in the old mapping, so it goes first
+	image.reset(dib);
+	this->mapping = std::move(mapping);
+	this->type = type;
+}
+
+#ifdef LIBIMAGE_MMAP
+
+// read-only view of a whole file. pages are mapped private and writable so that an image
+// loaded in place can be modified without touching the file
+class FileMapping {
+	void * address;
+	std::size_t length;
+public:
+	explicit FileMapping(char const * filename):
+		address(MAP_FAILED),
+		length(0)
+	{
+		int fd = ::open(filename,O_RDONLY);
+		if( fd < 0 ) throw std::runtime_error("error opening image " + std::string(filename));
+		struct stat st;
+		if( ::fstat(fd,&st) == 0 && st.st_size > 0 ) {
+			length = std::size_t(st.st_size);
+			address = ::mmap(nullptr,length,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+		}
+		::close(fd);
+		if( address == MAP_FAILED ) throw std::runtime_error("error mapping image " + std::string(filename));
+	}
+
+	FileMapping(FileMapping const &) = delete;
+	FileMapping & operator=(FileMapping const &) = delete;
+
+	~FileMapping() {
+		::munmap(address,length);
+	}
+
+	unsigned char * data() const { return static_cast<unsigned char *>(address); }
+	std::size_t size() const { return length; }
+
+	void advise(int advice) const {
+		::madvise(address,length,advice);
+	}
+};
+
+std::uint32_t readLE(unsigned char const * p, int bytes)
+{
+	std::uint32_t result = 0;
+	for( int i = bytes; i-- > 0; ) result = (result << 8) | p[i];
+	return result;
+}
+
+// FreeImage keeps 24/32bpp pixels bottom-up in BGR(A) order, which is how uncompressed BMP and TGA files store them
+// on little-endian machines. returns null when the file needs decoding
+FIBITMAP * wrapUncompressed(FREE_IMAGE_FORMAT fif, unsigned char * data, std::size_t size)
+{
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	// "BA" files are OS/2 bitmap arrays with their own headers
+	if( fif == FIF_BMP && size >= 54 && data[0] == 'B' && data[1] == 'M' ) {
+		auto infoSize = readLE(data + 14,4);
+		auto width = std::int32_t(readLE(data + 18,4));
+		auto height = std::int32_t(readLE(data + 22,4));
+		auto bpp = readLE(data + 28,2);
+		auto compression = readLE(data + 30,4);
+		auto offset = std::size_t(readLE(data + 10,4));
+		// negative heights are top-down bitmaps
+		if( infoSize < 40 || compression != 0 || (bpp != 24 && bpp != 32) || width <= 0 || height <= 0 ) return nullptr;
+		auto pitch = (std::size_t(width) * bpp + 31) / 32 * 4;
+		if( offset > size || pitch * std::size_t(height) > size - offset ) return nullptr;
+		auto dib = FreeImage_ConvertFromRawBitsEx(FALSE,data + offset,FIT_BITMAP,width,height,int(pitch),bpp,
+			FI_RGBA_RED_MASK,FI_RGBA_GREEN_MASK,FI_RGBA_BLUE_MASK);
+		if( dib ) {
+			FreeImage_SetDotsPerMeterX(dib,readLE(data + 38,4));
+			FreeImage_SetDotsPerMeterY(dib,readLE(data + 42,4));
+			FreeImage_SetTransparent(dib,FreeImage_GetColorType(dib) == FIC_RGBALPHA);
+		}
+		return dib;
+	}
+	if( fif == FIF_TARGA && size >= 18 ) {
+		auto idLength = std::size_t(data[0]);
+		auto colorMapType = data[1];
+		auto imageType = data[2];
+		auto width = readLE(data + 12,2);
+		auto height = readLE(data + 14,2);
+		auto bpp = unsigned(data[16]);
+		auto descriptor = data[17];
+		// type 2 is uncompressed true color. descriptor bits 4 and 5 flip the image
+		if( imageType != 2 || colorMapType != 0 || (bpp != 24 && bpp != 32) || (descriptor & 0x30) != 0 || width == 0 || height == 0 ) return nullptr;
+		auto offset = 18 + idLength;
+		auto pitch = std::size_t(width) * bpp / 8;
+		if( offset > size || pitch * height > size - offset ) return nullptr;
+		return FreeImage_ConvertFromRawBitsEx(FALSE,data + offset,FIT_BITMAP,int(width),int(height),int(pitch),bpp,
+			FI_RGBA_RED_MASK,FI_RGBA_GREEN_MASK,FI_RGBA_BLUE_MASK);
+	}
+#endif
+	return nullptr;
+}
+
+void Image::loadMapped(char const * filename, LoadOptions const & options)
+{
+	auto file = std::make_shared<FileMapping>(filename);
+
+	// only the signature is needed to detect the format, so huge files don't have to fit a memory stream
+	auto fif = FreeImage_GetFileTypeFromMemory(openMemory(file->data(),std::min<std::size_t>(file->size(),64 * 1024)).get());
+	if( fif == FIF_UNKNOWN ) fif = FreeImage_GetFIFFromFilename(filename);
+	if( fif == FIF_UNKNOWN ) throw std::runtime_error("can't autodetect image format");
+	if( ! FreeImage_FIFSupportsReading(fif) ) throw std::runtime_error("plugin can't load image");
+
+	if( auto dib = wrapUncompressed(fif,file->data(),file->size()) ) {
+		reset(dib,fif,std::move(file));
+		premultipliedAlpha = false;
+		return;
+	}
+
+	file->advise(MADV_SEQUENTIAL);
+	auto memory = openMemory(file->data(),file->size());
+	auto dib = FreeImage_LoadFromMemory(fif,memory.get(),loadFlags(fif,options));
+	if( dib == 0 ) throw std::runtime_error("error loading image " + std::string(filename));
+	reset(dib,fif);
+	premultipliedAlpha = false;
+}
+
+#endif
+
+void Image::load(char const * filename, LoadOptions const & options)
+{
+#ifdef LIBIMAGE_MMAP
+	if( options.memoryMap ) {
+		loadMapped(filename,options);
+		return;
+	}
+#endif
+	FREE_IMAGE_FORMAT fif = detectFormat(filename);
 
 	// ok, let's load the file
-	FIBITMAP * dib = FreeImage_Load(fif, filename, 0);		// flag = 0 for now. need to customize it in some way
+	FIBITMAP * dib = FreeImage_Load(fif, filename, loadFlags(fif,options));
 	if( dib == 0 ) throw std::runtime_error("error loading image " + std::string(filename));
 
 	// unless a bad file format, we are done !
-	image.reset(dib);
-	type = fif;
+	reset(dib,fif);
+	premultipliedAlpha = false;
 }
 
 Image Image::clone() const
@@ -120,54 +350,320 @@ Image Image::clone() const
 	FIBITMAP * cloneDib = FreeImage_Clone(image.get());
 	if( cloneDib == 0 ) throw std::runtime_error("error cloning image");
 
-	return Image(cloneDib,type);
+	return Image(cloneDib,type,premultipliedAlpha);
 }
 
-Image Image::to32bpp() const
+Image Image::to32bpp() const &
 {
 	FIBITMAP * cloneDib = FreeImage_ConvertTo32Bits(image.get());
 	if( cloneDib == 0 ) throw std::runtime_error("error converting image to 32bpp");
 
-	return Image(cloneDib,type);
+	return Image(cloneDib,type,premultipliedAlpha);
 }
 
-Image Image::rotate(double degrees) const
+Image Image::to32bpp() &&
+{
+	return std::move(to32bppInPlace());
+}
+
+Image Image::rotate(double degrees) const &
 {
 	FIBITMAP * cloneDib = FreeImage_Rotate(image.get(),degrees);
 	if( cloneDib == 0 ) throw std::runtime_error("error rotating image");
-	return Image(cloneDib,type);
+	return Image(cloneDib,type,premultipliedAlpha);
+}
+
+Image Image::rotate(double degrees) &&
+{
+	return std::move(rotateInPlace(degrees));
 }
 
-Image Image::flipH() const
+Image Image::rotateSpline(double degrees) const
+{
+	auto const w = FreeImage_GetWidth(image.get()), h = FreeImage_GetHeight(image.get());
+	FIBITMAP * rotated = FreeImage_RotateEx(image.get(),degrees,0,0,w / 2.0,h / 2.0,TRUE);
+	if( rotated == 0 ) throw std::runtime_error("error rotating image");
+	return Image(rotated,type,premultipliedAlpha);
+}
+
+Image Image::flipH() const &
 {
 	auto result = clone();
 	FreeImage_FlipHorizontal(result.image.get());
 	return result;
 }
 
-Image Image::flipV() const
+Image Image::flipH() &&
+{
+	return std::move(flipHInPlace());
+}
+
+Image Image::flipV() const &
 {
 	auto result = clone();
 	FreeImage_FlipVertical(result.image.get());
 	return result;
 }
 
+Image Image::flipV() &&
+{
+	return std::move(flipVInPlace());
+}
+
+Image & Image::flipHInPlace()
+{
+	if( ! FreeImage_FlipHorizontal(image.get()) ) throw std::runtime_error("error flipping image");
+	return *this;
+}
+
+Image & Image::flipVInPlace()
+{
+	if( ! FreeImage_FlipVertical(image.get()) ) throw std::runtime_error("error flipping image");
+	return *this;
+}
+
+Image & Image::rotateInPlace(double degrees)
+{
+	auto angle = std::fmod(degrees,360.0);
+	if( angle < 0 ) angle += 360;
+	if( angle == 0 && image ) return *this;
+
+	// 180 degrees, and 90 or 270 degrees of square images, move the pixels without a copy
+	if( image && FreeImage_RotateInPlace(image.get(),degrees) ) return *this;
+
+	FIBITMAP * rotated = FreeImage_Rotate(image.get(),degrees);
+	if( rotated == 0 ) throw std::runtime_error("error rotating image");
+	reset(rotated,type);
+	return *this;
+}
+
+Image & Image::to32bppInPlace()
+{
+	if( bpp() == 32 && FreeImage_GetImageType(image.get()) == FIT_BITMAP ) return *this;
+	FIBITMAP * converted = FreeImage_ConvertTo32Bits(image.get());
+	if( converted == 0 ) throw std::runtime_error("error converting image to 32bpp");
+	reset(converted,type);
+	return *this;
+}
+
 Image Image::clip(int left, int top, int right, int bottom) const
 {
 	FIBITMAP * cloneDib = FreeImage_Copy(image.get(),left,top,right+1,bottom+1);
 	if( cloneDib == 0 ) throw std::runtime_error("error clipping image");
-	return Image(cloneDib,type);
+	return Image(cloneDib,type,premultipliedAlpha);
+}
+
+
+// 32bpp scanline kernels. pixels are handled as raw bytes, so the packed values are built from Pixel32
+// and compared in memory order
+
+std::uint32_t packPixel(Color color) {
+	auto pixel = Pixel32::fromColor(color);
+	std::uint32_t result;
+	std::memcpy(&result,&pixel,sizeof(result));
+	return result;
 }
 
+#ifdef LIBIMAGE_AVX2
+
+bool hasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info,0);
+	if( info[0] < 7 ) return false;
+	__cpuid(info,1);
+	// OSXSAVE and AVX, and the OS saves the YMM registers
+	if( (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6 ) return false;
+	__cpuidex(info,7,0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// the AVX2 parts of replaceRow32 and clearAlphaRow32, return the number of pixels done
+LIBIMAGE_TARGET_AVX2 Size replaceRow32AVX2(unsigned char * bits, Size count, std::uint32_t from, std::uint32_t to)
+{
+	Size x = 0;
+	auto from8 = _mm256_set1_epi32(int(from));
+	auto to8 = _mm256_set1_epi32(int(to));
+	for( ; x + 8 <= count; x += 8 ) {
+		auto p = reinterpret_cast<__m256i *>(bits + x*4);
+		auto pixels = _mm256_loadu_si256(p);
+		auto mask = _mm256_cmpeq_epi32(pixels,from8);
+		_mm256_storeu_si256(p,_mm256_blendv_epi8(pixels,to8,mask));
+	}
+	return x;
+}
+
+LIBIMAGE_TARGET_AVX2 Size clearAlphaRow32AVX2(unsigned char * bits, Size count, std::uint32_t low, std::uint32_t high)
+{
+	Size x = 0;
+	auto low8 = _mm256_set1_epi32(int(low));
+	auto high8 = _mm256_set1_epi32(int(high));
+	auto alpha8 = _mm256_set1_epi32(int(FI_RGBA_ALPHA_MASK));
+	for( ; x + 8 <= count; x += 8 ) {
+		auto p = reinterpret_cast<__m256i *>(bits + x*4);
+		auto pixels = _mm256_loadu_si256(p);
+		// saturated differences are zero on every channel only when low <= pixel <= high
+		auto outside = _mm256_or_si256(_mm256_subs_epu8(low8,pixels),_mm256_subs_epu8(pixels,high8));
+		auto mask = _mm256_cmpeq_epi32(outside,_mm256_setzero_si256());
+		_mm256_storeu_si256(p,_mm256_andnot_si256(_mm256_and_si256(mask,alpha8),pixels));
+	}
+	return x;
+}
+
+#endif
+
+void replaceRow32(unsigned char * bits, Size count, std::uint32_t from, std::uint32_t to)
+{
+	Size x = 0;
+#ifdef LIBIMAGE_AVX2
+	static bool const avx2 = hasAVX2();
+	if( avx2 ) x = replaceRow32AVX2(bits,count,from,to);
+#endif
+#ifdef LIBIMAGE_SSE2
+	auto from4 = _mm_set1_epi32(int(from));
+	auto to4 = _mm_set1_epi32(int(to));
+	for( ; x + 4 <= count; x += 4 ) {
+		auto p = reinterpret_cast<__m128i *>(bits + x*4);
+		auto pixels = _mm_loadu_si128(p);
+		auto mask = _mm_cmpeq_epi32(pixels,from4);
+		_mm_storeu_si128(p,_mm_or_si128(_mm_and_si128(mask,to4),_mm_andnot_si128(mask,pixels)));
+	}
+#endif
+	for( ; x < count; ++x ) {
+		std::uint32_t pixel;
+		std::memcpy(&pixel,bits + x*4,4);
+		if( pixel == from ) std::memcpy(bits + x*4,&to,4);
+	}
+}
+
+// low has alpha 0 and high has alpha 255, so only r,g,b decide whether a pixel is in range
+void clearAlphaRow32(unsigned char * bits, Size count, std::uint32_t low, std::uint32_t high)
+{
+	Size x = 0;
+#ifdef LIBIMAGE_AVX2
+	static bool const avx2 = hasAVX2();
+	if( avx2 ) x = clearAlphaRow32AVX2(bits,count,low,high);
+#endif
+#ifdef LIBIMAGE_SSE2
+	auto low4 = _mm_set1_epi32(int(low));
+	auto high4 = _mm_set1_epi32(int(high));
+	auto alpha4 = _mm_set1_epi32(int(FI_RGBA_ALPHA_MASK));
+	for( ; x + 4 <= count; x += 4 ) {
+		auto p = reinterpret_cast<__m128i *>(bits + x*4);
+		auto pixels = _mm_loadu_si128(p);
+		auto outside = _mm_or_si128(_mm_subs_epu8(low4,pixels),_mm_subs_epu8(pixels,high4));
+		auto mask = _mm_cmpeq_epi32(outside,_mm_setzero_si128());
+		_mm_storeu_si128(p,_mm_andnot_si128(_mm_and_si128(mask,alpha4),pixels));
+	}
+#endif
+	unsigned char lowBytes[4], highBytes[4];
+	std::memcpy(lowBytes,&low,4);
+	std::memcpy(highBytes,&high,4);
+	for( ; x < count; ++x ) {
+		auto pixel = bits + x*4;
+		bool inside = true;
+		for( int ch = 0; ch != 4; ++ch ) {
+			inside = inside && pixel[ch] >= lowBytes[ch] && pixel[ch] <= highBytes[ch];
+		}
+		if( inside ) pixel[FI_RGBA_ALPHA] = 0;
+	}
+}
 
 Image & Image::replace(Color origColor, Color newColor) {
+	if( premultipliedAlpha ) {
+		return replaceColors([origColor](Color color) { return color == origColor; },[newColor](Color) { return newColor; });
+	}
+	if( bpp() == 32 ) {
+		auto from = packPixel(origColor);
+		auto to = packPixel(newColor);
+		for( auto row : view() ) {
+			replaceRow32(row.data(),width(),from,to);
+		}
+		return *this;
+	}
 	auto origQuad = toRgbQuad(origColor);
 	auto newQuad = toRgbQuad(newColor);
 	FreeImage_ApplyColorMapping(image.get(),&origQuad,&newQuad,1,false,false);
 	return *this;
 }
 
-Image &	Image::replaceColors(std::function<bool(img::Color)> predicate, std::function<img::Color(img::Color)> colorChanger) {
+Image & Image::replace(std::vector<std::pair<Color,Color>> const & colorMap) {
+	if( colorMap.empty() ) return *this;
+	if( premultipliedAlpha ) {
+		// the straight colors of the pixels are looked up, the first mapping of a color wins
+		std::unordered_map<std::uint32_t,Color> map;
+		for( auto const & mapping : colorMap ) map.emplace(packPixel(mapping.first),mapping.second);
+		for( auto row : view<PremultipliedPixel32>() ) {
+			for( auto & pixel : row ) {
+				auto found = map.find(packPixel(pixel.toColor()));
+				if( found != map.end() ) pixel = PremultipliedPixel32::fromColor(found->second);
+			}
+		}
+		return *this;
+	}
+	std::vector<RGBQUAD> origQuads, newQuads;
+	origQuads.reserve(colorMap.size());
+	newQuads.reserve(colorMap.size());
+	for( auto const & mapping : colorMap ) {
+		origQuads.push_back(toRgbQuad(mapping.first));
+		newQuads.push_back(toRgbQuad(mapping.second));
+	}
+	FreeImage_ApplyColorMapping(image.get(),origQuads.data(),newQuads.data(),unsigned(colorMap.size()),false,false);
+	return *this;
+}
+
+Image & Image::makeTransparent(Color first, Color last) {
+	if( bpp() != 32 ) throw std::runtime_error("makeTransparent requires a 32bpp image");
+	if( premultipliedAlpha ) {
+		// a premultiplied pixel made transparent must be black, which fromColor of alpha 0 gives
+		auto inside = [first,last](Color color) {
+			return color.r >= first.r && color.r <= last.r && color.g >= first.g && color.g <= last.g
+				&& color.b >= first.b && color.b <= last.b;
+		};
+		return replaceColors(inside,[](Color) { return Color{0,0,0,0}; });
+	}
+	first.a = 0;
+	last.a = 255;
+	auto low = packPixel(first);
+	auto high = packPixel(last);
+	for( auto row : view() ) {
+		clearAlphaRow32(row.data(),width(),low,high);
+	}
+	return *this;
+}
+
+void Image::replacePaletteColors(std::function<bool(Color)> const & predicate, std::function<Color(Color)> const & colorChanger)
+{
+	RGBQUAD * pal = FreeImage_GetPalette(image.get());
+	if( ! pal ) throw std::runtime_error("image has no palette");
+	auto colors = FreeImage_GetColorsUsed(image.get());
+	auto transparencyCount = FreeImage_GetTransparencyCount(image.get());
+	BYTE table[256];
+	std::memset(table,255,sizeof(table));
+	std::memcpy(table,FreeImage_GetTransparencyTable(image.get()),transparencyCount);
+	bool alphaChanged = false;
+	for( unsigned i = 0; i != colors; ++i ) {
+		Color color = {pal[i].rgbRed,pal[i].rgbGreen,pal[i].rgbBlue,table[i]};
+		if( ! predicate(color) ) continue;
+		auto newColor = colorChanger(color);
+		pal[i] = toRgbQuad(newColor);
+		if( newColor.a != table[i] ) {
+			table[i] = newColor.a;
+			alphaChanged = true;
+		}
+	}
+	if( alphaChanged ) {
+		FreeImage_SetTransparencyTable(image.get(),table,int(colors));
+	}
+}
+
+void Image::replacePixelColors(std::function<bool(Color)> const & predicate, std::function<Color(Color)> const & colorChanger)
+{
 	for( Size r = 0; r != height(); ++r )
 		for( Size c = 0; c != width(); ++c ) {
 			auto color = getColor(c,r);
@@ -175,16 +671,55 @@ Image &	Image::replaceColors(std::function<bool(img::Color)> predicate, std::fun
 				setColor(c,r,colorChanger(color));
 			}
 		}
-	return *this;
 }
 
 bool Image::pasteFrom(const Image & subImage, Size x, Size y) {
+	if( subImage.premultipliedAlpha != premultipliedAlpha ) throw std::runtime_error("pasteFrom needs both images premultiplied, or neither");
 	if( ! FreeImage_Paste(image.get(),subImage.image.get(),x,y,256) ) { // >255 = no alpha blend
 		return false;
 	}
 	return true;
 }
 
+Image & Image::composite(Image const & src, int x, int y, BlendMode mode, ExecutionPolicy policy)
+{
+	if( bpp() != 32 || src.bpp() != 32 ) throw std::runtime_error("composite supports 32bpp images");
+	if( &src == this ) throw std::runtime_error("can't composite an image onto itself");
+	if( src.premultipliedAlpha != premultipliedAlpha ) throw std::runtime_error("composite needs both images premultiplied, or neither");
+	FREE_IMAGE_BLEND_MODE fiMode = FIBLEND_OVER;
+	switch( mode ) {
+		case BlendMode::over: fiMode = premultipliedAlpha ? FIBLEND_PREMULTIPLIED_OVER : FIBLEND_OVER; break;
+		case BlendMode::premultipliedOver: fiMode = FIBLEND_PREMULTIPLIED_OVER; break;
+		case BlendMode::add: fiMode = FIBLEND_ADD; break;
+		case BlendMode::multiply: fiMode = FIBLEND_MULTIPLY; break;
+	}
+	if( premultipliedAlpha && fiMode != FIBLEND_PREMULTIPLIED_OVER ) throw std::runtime_error("add and multiply composite straight colors");
+	auto threads = std::min(policy.threads ? policy.threads : threadCount(),255u);
+	if( ! FreeImage_Blend(image.get(),src.image.get(),x,y,fiMode,FI_BLEND_THREADS(threads)) ) throw std::runtime_error("error compositing image");
+	return *this;
+}
+
+bool Image::premultiplied() const
+{
+	return premultipliedAlpha;
+}
+
+Image & Image::premultiplyInPlace()
+{
+	if( premultipliedAlpha ) return *this;
+	if( ! FreeImage_PreMultiplyWithAlpha(image.get()) ) throw std::runtime_error("premultiplied alpha needs a 32bpp image");
+	premultipliedAlpha = true;
+	return *this;
+}
+
+Image & Image::unpremultiplyInPlace()
+{
+	if( ! premultipliedAlpha ) return *this;
+	if( ! FreeImage_UnPreMultiplyWithAlpha(image.get()) ) throw std::runtime_error("error unpremultiplying image");
+	premultipliedAlpha = false;
+	return *this;
+}
+
 
 
 Size Image::width() const
@@ -207,6 +742,28 @@ unsigned char * Image::rawBits() const
 	return FreeImage_GetBits(image.get());
 }
 
+unsigned Image::pitch() const
+{
+	return FreeImage_GetPitch(image.get());
+}
+
+ImageView<unsigned char> Image::byteView(RowOrder order, std::size_t elementSize) const
+{
+	if( ! image ) throw std::runtime_error("can't view empty image");
+	unsigned char * bits = FreeImage_GetBits(image.get());
+	if( ! bits ) throw std::runtime_error("image has no pixel data");
+	if( elementSize != 1 && elementSize * 8 != bpp() ) throw std::runtime_error("view pixel type does not match image bpp");
+
+	// FreeImage stores scanline 0 at the bottom
+	auto stride = std::ptrdiff_t(pitch());
+	auto rows = height();
+	if( order == RowOrder::topDown && rows > 0 ) {
+		bits += stride * std::ptrdiff_t(rows - 1);
+		stride = -stride;
+	}
+	return ImageView<unsigned char>(bits,stride,FreeImage_GetLine(image.get()),rows);
+}
+
 std::unique_ptr<unsigned char[]> Image::toRawBits(unsigned targetBpp) const
 {
 	auto scanWidth = width() * (targetBpp/8);
@@ -216,6 +773,16 @@ std::unique_ptr<unsigned char[]> Image::toRawBits(unsigned targetBpp) const
 	return std::unique_ptr<unsigned char[]>(result);
 }
 
+void Image::toRawBits(void * dst, std::size_t size, unsigned targetBpp, std::size_t pitch, RowOrder order) const
+{
+	if( ! image ) throw std::runtime_error("can't convert empty image");
+	auto line = (std::size_t(width()) * targetBpp + 7) / 8;
+	if( pitch < line || pitch > std::size_t(std::numeric_limits<int>::max()) ) throw std::runtime_error("invalid pitch for raw bits");
+	if( height() > 0 && size < pitch * (height() - 1) + line ) throw std::runtime_error("raw bits buffer is too small");
+	FreeImage_ConvertToRawBits(static_cast<BYTE *>(dst), image.get(), int(pitch), targetBpp,
+		FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, order == RowOrder::topDown);
+}
+
 void * Image::getWindowSystemHeader() const
 {
 	// TODO use pImpl to select between windows and linux
@@ -252,10 +819,15 @@ Color Image::getColor(Size x, Size y) const {
 	RGBQUAD value;
 	// todo log if false
 	FreeImage_GetPixelColor(image.get(),x,height()-y-1,&value);
+	if( premultipliedAlpha ) return PremultipliedPixel32{value.rgbBlue,value.rgbGreen,value.rgbRed,value.rgbReserved}.toColor();
 	return {value.rgbRed,value.rgbGreen,value.rgbBlue,value.rgbReserved};
 }
 
 Image & Image::setColor(Size x, Size y, Color color) {
+	if( premultipliedAlpha ) {
+		auto pixel = PremultipliedPixel32::fromColor(color);
+		color = {pixel.r,pixel.g,pixel.b,pixel.a};
+	}
 	auto quad = toRgbQuad(color);
 	FreeImage_SetPixelColor(image.get(),x,height()-y-1,&quad);
 	return *this;
@@ -267,20 +839,108 @@ bool Image::isTransparentPixel(Size x, Size y) const {
 	return table[getColorIndex(x,y)] == 0;
 }
 
-Image Image::thumbnail(Size squareSize) const
+Image Image::thumbnail(Size squareSize, ThumbnailQuality quality) const
 {
-	FIBITMAP * thumbnail = FreeImage_MakeThumbnail(image.get(), squareSize, true);
+	FIBITMAP * thumbnail = FreeImage_MakeThumbnailEx(image.get(), squareSize, true, convertQuality(quality));
 	if( ! thumbnail ) throw std::runtime_error("could not generate thumbnail");
 
-	return Image(thumbnail,type);
+	return Image(thumbnail,type,premultipliedAlpha);
 }
 
 Image Image::resize(Size width, Size height, ResizeFilter filter) const
 {
-	FIBITMAP * result = FreeImage_Rescale(image.get(), width, height, convertFilter(filter));
+	return resize(width,height,filter,sequential);
+}
+
+Image Image::resize(Size width, Size height, ResizeFilter filter, ExecutionPolicy policy) const
+{
+	FIBITMAP * result = FreeImage_RescaleRect(image.get(),int(width),int(height),0,0,int(this->width()),int(this->height()),
+		convertFilter(filter),rescaleFlags(policy));
 	if( ! result ) throw std::runtime_error("could not rescale image");
 
-	return Image(result,type);
+	return Image(result,type,premultipliedAlpha);
+}
+
+std::vector<Image> Image::buildPyramid(unsigned levels, ResizeFilter filter) const
+{
+	if( ! image ) throw std::runtime_error("can't build the pyramid of an empty image");
+	std::vector<FIBITMAP *> dibs(levels,nullptr);
+	auto const built = FreeImage_MakePyramid(image.get(),dibs.data(),int(levels),convertFilter(filter));
+	std::vector<Image> pyramid;
+	pyramid.reserve(std::size_t(built));
+	for( int i = 0; i != built; ++i ) pyramid.push_back(Image(dibs[std::size_t(i)],type,premultipliedAlpha));
+
+	// fewer levels are fine once the pyramid reaches 1x1
+	auto const & last = pyramid.empty() ? *this : pyramid.back();
+	if( std::size_t(built) != levels && (last.width() != 1 || last.height() != 1) ) throw std::runtime_error("could not build pyramid");
+	return pyramid;
+}
+
+std::vector<PyramidLevel> Image::pyramidLayout(unsigned levels, unsigned targetBpp, std::size_t alignment) const
+{
+	if( alignment == 0 ) throw std::runtime_error("pyramid alignment must not be 0");
+	auto align = [alignment](std::size_t value) { return (value + alignment - 1) / alignment * alignment; };
+	std::vector<PyramidLevel> layout;
+	auto w = width(), h = height();
+	std::size_t offset = 0;
+	for( unsigned i = 0; i != levels && (w > 1 || h > 1); ++i ) {
+		PyramidLevel level;
+		level.width = w = std::max(w / 2,Size(1));
+		level.height = h = std::max(h / 2,Size(1));
+		level.pitch = align((std::size_t(w) * targetBpp + 7) / 8);
+		level.offset = offset = align(offset);
+		offset += level.pitch * h;
+		layout.push_back(level);
+	}
+	return layout;
+}
+
+std::size_t Image::pyramidSize(unsigned levels, unsigned targetBpp, std::size_t alignment) const
+{
+	auto layout = pyramidLayout(levels,targetBpp,alignment);
+	return layout.empty() ? 0 : layout.back().offset + layout.back().pitch * layout.back().height;
+}
+
+std::vector<PyramidLevel> Image::buildPyramid(void * dst, std::size_t size, unsigned levels, unsigned targetBpp,
+	ResizeFilter filter, RowOrder order, std::size_t alignment) const
+{
+	auto layout = pyramidLayout(levels,targetBpp,alignment);
+	if( size < pyramidSize(levels,targetBpp,alignment) ) throw std::runtime_error("pyramid buffer is too small");
+	auto pyramid = buildPyramid(levels,filter);
+	for( std::size_t i = 0; i != layout.size(); ++i ) {
+		auto const & level = layout[i];
+		pyramid[i].toRawBits(static_cast<unsigned char *>(dst) + level.offset,size - level.offset,targetBpp,level.pitch,order);
+	}
+	return layout;
+}
+
+void Image::resizeInto(Image & dst, ResizeFilter filter) const
+{
+	resizeInto(dst,filter,sequential);
+}
+
+void Image::resizeInto(Image & dst, ResizeFilter filter, ExecutionPolicy policy) const
+{
+	if( ! dst ) throw std::runtime_error("resizeInto needs a destination of the target size");
+	if( &dst == this ) throw std::runtime_error("can't resize an image into itself");
+	auto const flags = FI_RESCALE_OMIT_METADATA | rescaleFlags(policy);
+	dst.premultipliedAlpha = premultipliedAlpha;
+	if( FreeImage_RescaleInto(image.get(),dst.image.get(),convertFilter(filter),flags) ) return;
+
+	// dst has another pixel format: give it the one of resize() so the next call can reuse it
+	FIBITMAP * result = FreeImage_RescaleRect(image.get(),int(dst.width()),int(dst.height()),0,0,int(width()),int(height()),
+		convertFilter(filter),flags);
+	if( ! result ) throw std::runtime_error("could not rescale image");
+	dst.reset(result,dst.type);
+}
+
+FIBITMAP * Image::straightAlpha(std::unique_ptr<FIBITMAP,Deleter> & copy) const
+{
+	// image files hold straight colors
+	if( ! premultipliedAlpha ) return image.get();
+	copy.reset(FreeImage_Clone(image.get()));
+	if( ! copy || ! FreeImage_UnPreMultiplyWithAlpha(copy.get()) ) throw std::runtime_error("error unpremultiplying image");
+	return copy.get();
 }
 
 void Image::save(char const * filename) const {
@@ -294,8 +954,9 @@ void Image::save(char const * filename) const {
 	auto bpp = FreeImage_GetBPP(image.get());
 	if( ! FreeImage_FIFSupportsExportBPP(fif, bpp) ) throw std::runtime_error("image file format not supported for current bpp");
 
+	std::unique_ptr<FIBITMAP,Deleter> copy;
 	// flag = 0 for now. need to customize it in some way
-	if( ! FreeImage_Save(fif, image.get(), filename, 0 ) ) throw std::runtime_error("error saving image");
+	if( ! FreeImage_Save(fif, straightAlpha(copy), filename, 0 ) ) throw std::runtime_error("error saving image");
 }
 
 void Image::save(std::string const & filename) const
@@ -314,102 +975,220 @@ void Image::save(wchar_t const * filename) const {
 	auto bpp = FreeImage_GetBPP(image.get());
 	if( ! FreeImage_FIFSupportsExportBPP(fif, bpp) ) throw std::runtime_error("image file format not supported for current bpp");
 
+	std::unique_ptr<FIBITMAP,Deleter> copy;
 	// flag = 0 for now. need to customize it in some way
-	if( ! FreeImage_SaveU(fif, image.get(), filename, 0 ) ) throw std::runtime_error("error saving image");
+	if( ! FreeImage_SaveU(fif, straightAlpha(copy), filename, 0 ) ) throw std::runtime_error("error saving image");
 }
 
 void Image::save(std::wstring const & filename) const {
 	save(filename.c_str());
 }
 
-unsigned DLL_CALLCONV ReadProc(void * buffer, unsigned size, unsigned count, fi_handle handle)
+std::ios_base::seekdir getDir(int origin)
 {
-	auto & stream = *reinterpret_cast<std::istream *>(handle);
-	auto buf = static_cast<char *>(buffer);
-	std::streamsize bytesRead = 0;
-
-	// try to read as much as possible when size == 1 , which is a very common case
-	if( size == 1 ) {
-		while( stream && bytesRead < count ) {
-			stream.read(buf,count - bytesRead);
-			auto tot = stream.gcount();
-			if( tot == 0 ) break;
-			bytesRead += tot;
-			buf += tot;
+	auto dir = std::ios_base::beg;
+	switch(origin) {
+	case SEEK_CUR:
+		dir = std::ios_base::cur;
+		break;
+	case SEEK_END:
+		dir = std::ios_base::end;
+		break;
+	}
+	return dir;
+}
+
+// codecs issue lots of tiny reads and writes, so the stream adapters go through a buffer
+// instead of paying a virtual streambuf call for each one of them
+std::size_t const streamBufferSize = 64 * 1024;
+
+// read-ahead buffer over an istream. positions are absolute stream positions
+class StreamReader {
+	std::istream & stream;
+	std::unique_ptr<char[]> buffer;
+	std::streamoff bufferStart;	// stream position of buffer[0]
+	std::size_t pos, filled;
+
+	bool fill() {
+		bufferStart += filled;
+		pos = filled = 0;
+		stream.read(buffer.get(),streamBufferSize);
+		filled = std::size_t(stream.gcount());
+		return filled > 0;
+	}
+public:
+	explicit StreamReader(std::istream & stream):
+		stream(stream),
+		buffer(new char[streamBufferSize]),
+		bufferStart(stream.tellg()),
+		pos(0),
+		filled(0)
+	{}
+
+	StreamReader(StreamReader const &) = delete;
+	StreamReader & operator=(StreamReader const &) = delete;
+
+	// leave the stream right after the last byte consumed by FreeImage
+	~StreamReader() {
+		if( pos != filled ) {
+			stream.clear();
+			stream.seekg(bufferStart + std::streamoff(pos));
 		}
-		return bytesRead;
-	}
-
-	unsigned result = 0;
-	auto chunk = std::streamsize(size);
-	while( stream ) {
-		stream.read(buf,chunk);
-		auto tot = stream.gcount();
-		if( tot == 0 ) break;
-		bytesRead += tot;
-		buf += tot;
-		while( bytesRead >= chunk ) {
-			++result;
-			if( result >= count ) {
-				return result;
+	}
+
+	std::size_t read(void * data, std::size_t size) {
+		auto out = static_cast<char *>(data);
+		std::size_t done = 0;
+		while( done < size ) {
+			if( pos == filled ) {
+				if( size - done >= streamBufferSize ) {
+					// large reads bypass the buffer
+					bufferStart += filled;
+					pos = filled = 0;
+					stream.read(out + done,std::streamsize(size - done));
+					auto count = std::size_t(stream.gcount());
+					bufferStart += count;
+					done += count;
+					break;
+				}
+				if( ! fill() ) break;
 			}
-			bytesRead -= chunk;
+			auto count = std::min(size - done,filled - pos);
+			std::memcpy(out + done,buffer.get() + pos,count);
+			pos += count;
+			done += count;
 		}
+		return done;
 	}
-	if( bytesRead > 0 ) ++result;
-	return result;
+
+	long tell() const {
+		return long(bufferStart + std::streamoff(pos));
+	}
+
+	int seek(long offset, int origin) {
+		auto target = std::streamoff(offset);
+		if( origin == SEEK_CUR ) {
+			target += tell();
+		} else if( origin == SEEK_END ) {
+			stream.clear();
+			if( ! stream.seekg(offset,std::ios_base::end) ) return -1;
+			bufferStart = stream.tellg();
+			pos = filled = 0;
+			return 0;
+		}
+		if( target >= bufferStart && target <= bufferStart + std::streamoff(filled) ) {
+			pos = std::size_t(target - bufferStart);
+			return 0;
+		}
+		stream.clear();
+		if( ! stream.seekg(target) ) return -1;
+		bufferStart = target;
+		pos = filled = 0;
+		return 0;
+	}
+};
+
+// write-behind buffer over an ostream. flush() must be called to push the last bytes
+class StreamWriter {
+	std::ostream & stream;
+	std::unique_ptr<char[]> buffer;
+	std::streamoff position;	// logical position, including the bytes still buffered
+	std::size_t used;
+public:
+	explicit StreamWriter(std::ostream & stream):
+		stream(stream),
+		buffer(new char[streamBufferSize]),
+		position(stream.tellp()),
+		used(0)
+	{}
+
+	StreamWriter(StreamWriter const &) = delete;
+	StreamWriter & operator=(StreamWriter const &) = delete;
+
+	bool flush() {
+		if( used > 0 ) {
+			stream.write(buffer.get(),std::streamsize(used));
+			used = 0;
+		}
+		return bool(stream);
+	}
+
+	bool write(void const * data, std::size_t size) {
+		if( used + size > streamBufferSize && ! flush() ) return false;
+		position += std::streamoff(size);
+		if( size >= streamBufferSize ) {
+			// large writes bypass the buffer
+			stream.write(static_cast<char const *>(data),std::streamsize(size));
+			return bool(stream);
+		}
+		std::memcpy(buffer.get() + used,data,size);
+		used += size;
+		return true;
+	}
+
+	long tell() const {
+		return long(position);
+	}
+
+	int seek(long offset, int origin) {
+		if( ! flush() ) return -1;
+		if( ! stream.seekp(offset,getDir(origin)) ) return -1;
+		position = stream.tellp();
+		return 0;
+	}
+};
+
+unsigned DLL_CALLCONV ReadProc(void * buffer, unsigned size, unsigned count, fi_handle handle)
+{
+	auto & reader = *reinterpret_cast<StreamReader *>(handle);
+	if( size == 0 ) return 0;
+	return unsigned(reader.read(buffer,std::size_t(size) * count) / size);
 }
 
-// TODO implement special case when size == 1
 unsigned DLL_CALLCONV WriteProc(void * buffer, unsigned size, unsigned count, fi_handle handle)
 {
-	std::ostream & stream = *reinterpret_cast<std::ostream *>(handle);
-	char * buf = static_cast<char *>(buffer);
-	unsigned result = 0;
-	while( stream && result < count ) {
-		stream.write(buf,size);
-		buf += size;
-		++result;
-	}
-	return result;
+	auto & writer = *reinterpret_cast<StreamWriter *>(handle);
+	return writer.write(buffer,std::size_t(size) * count) ? count : 0;
 }
 
 long DLL_CALLCONV TellProcR(fi_handle handle)
 {
-	std::istream & stream = *reinterpret_cast<std::istream *>(handle);
-	return stream.tellg();
+	return reinterpret_cast<StreamReader *>(handle)->tell();
 }
 
 long DLL_CALLCONV TellProcW(fi_handle handle)
 {
-	std::ostream & stream = *reinterpret_cast<std::ostream *>(handle);
-	return stream.tellp();
+	return reinterpret_cast<StreamWriter *>(handle)->tell();
 }
 
-std::ios_base::seekdir getDir(int origin)
+int DLL_CALLCONV SeekProcR(fi_handle handle, long offset, int origin)
 {
-	auto dir = std::ios_base::beg;
-	switch(origin) {
-	case SEEK_CUR:
-		dir = std::ios_base::cur;
-		break;
-	case SEEK_END:
-		dir = std::ios_base::end;
-		break;
-	}
-	return dir;
+	return reinterpret_cast<StreamReader *>(handle)->seek(offset,origin);
 }
 
-int DLL_CALLCONV SeekProcR(fi_handle handle, long offset, int origin)
+int DLL_CALLCONV SeekProcW(fi_handle handle, long offset, int origin)
 {
-	std::istream & stream = *reinterpret_cast<std::istream *>(handle);
-	return stream.seekg(offset,getDir(origin)) ? 0 : -1;
+	return reinterpret_cast<StreamWriter *>(handle)->seek(offset,origin);
 }
 
-int DLL_CALLCONV SeekProcW(fi_handle handle, long offset, int origin)
+FreeImageIO readerIO()
 {
-	std::ostream & stream = *reinterpret_cast<std::ostream *>(handle);
-	return stream.seekp(offset,getDir(origin)) ? 0 : -1;
+	FreeImageIO io;
+	io.read_proc  = &ReadProc;
+	io.write_proc = 0;
+	io.tell_proc  = &TellProcR;
+	io.seek_proc  = &SeekProcR;
+	return io;
+}
+
+FreeImageIO writerIO()
+{
+	FreeImageIO io;
+	io.read_proc  = 0;
+	io.write_proc = &WriteProc;
+	io.tell_proc  = &TellProcW;
+	io.seek_proc  = &SeekProcW;
+	return io;
 }
 
 void Image::save(std::ostream & stream) const
@@ -427,40 +1206,76 @@ void Image::save(std::ostream & stream, int type) const
 	if( type == FIF_UNKNOWN ) {
 		throw std::runtime_error("can't save images with unspecified format to a stream");
 	}
-	FreeImageIO io;
-	io.read_proc  = 0;
-	io.write_proc = &WriteProc;
-	io.tell_proc  = &TellProcW;
-	io.seek_proc  = &SeekProcW;
+	auto io = writerIO();
+	StreamWriter writer(stream);
+	std::unique_ptr<FIBITMAP,Deleter> copy;
 	// flag = 0 for now. need to customize it in some way
-	if( ! FreeImage_SaveToHandle(FREE_IMAGE_FORMAT(type),image.get(),&io,reinterpret_cast<fi_handle>(&stream),0) ) throw std::runtime_error("error saving image to stream");
+	if( ! FreeImage_SaveToHandle(FREE_IMAGE_FORMAT(type),straightAlpha(copy),&io,reinterpret_cast<fi_handle>(&writer),0) ||
+		! writer.flush() ) throw std::runtime_error("error saving image to stream");
 }
 
-void Image::load(std::istream & stream, Type type)
+void Image::load(std::istream & stream, Type type, LoadOptions const & options)
 {
-	FreeImageIO io;
-	io.read_proc  = &ReadProc;
-	io.write_proc = 0;
-	io.tell_proc  = &TellProcR;
-	io.seek_proc  = &SeekProcR;
-	// flag = 0 for now. need to customize it in some way
+	auto io = readerIO();
+	StreamReader reader(stream);
 	auto fif = type2fif(type);
-	auto dib = FreeImage_LoadFromHandle(fif,&io,reinterpret_cast<fi_handle>(&stream),0);
+	auto dib = FreeImage_LoadFromHandle(fif,&io,reinterpret_cast<fi_handle>(&reader),loadFlags(fif,options));
 	if( ! dib ) throw std::runtime_error("error loading image from stream");
 
-	image.reset(dib);
-	this->type = fif;
+	reset(dib,fif);
+	premultipliedAlpha = false;
+}
+
+void Image::load(void const * data, std::size_t size, Type type, LoadOptions const & options)
+{
+	auto memory = openMemory(data,size);
+	auto fif = type2fif(type);
+	auto dib = FreeImage_LoadFromMemory(fif,memory.get(),loadFlags(fif,options));
+	if( ! dib ) throw std::runtime_error("error loading image from memory");
+
+	reset(dib,fif);
+	premultipliedAlpha = false;
+}
+
+std::vector<unsigned char> Image::encode() const
+{
+	return encode(type);
+}
+
+std::vector<unsigned char> Image::encode(Type type) const
+{
+	return encode(type2fif(type));
+}
+
+std::vector<unsigned char> Image::encode(int type) const
+{
+	if( type == FIF_UNKNOWN ) {
+		throw std::runtime_error("can't encode images with unspecified format");
+	}
+	MemoryPtr memory(FreeImage_OpenMemory(),&FreeImage_CloseMemory);
+	if( ! memory ) throw std::runtime_error("error opening memory stream");
+	std::unique_ptr<FIBITMAP,Deleter> copy;
+	// flag = 0 for now. need to customize it in some way
+	if( ! FreeImage_SaveToMemory(FREE_IMAGE_FORMAT(type),straightAlpha(copy),memory.get(),0) ) throw std::runtime_error("error encoding image");
+
+	BYTE * data = 0;
+	DWORD size = 0;
+	FreeImage_AcquireMemory(memory.get(),&data,&size);
+	return std::vector<unsigned char>(data,data + size);
 }
 
 Image::operator bool() const {
 	return bool(image);
 }
 
+void installBitmapAllocator();
+
 ImageInitializer::ImageInitializer() {
 	class ImageInitializerHelper {
 	public:
 		ImageInitializerHelper() {
 			FreeImage_Initialise();
+			installBitmapAllocator();
 		}
 		~ImageInitializerHelper() {
 			FreeImage_DeInitialise();
@@ -469,6 +1284,574 @@ ImageInitializer::ImageInitializer() {
 	static ImageInitializerHelper init;
 }
 
+bool isMultiPage(FREE_IMAGE_FORMAT fif)
+{
+	return fif == FIF_GIF || fif == FIF_TIFF || fif == FIF_ICO;
+}
+
+int countPages(FIMULTIBITMAP * multi)
+{
+	if( ! multi ) return 1;
+	int result = FreeImage_GetPageCount(multi);
+	FreeImage_CloseMultiBitmap(multi);
+	return result;
+}
+
+ImageInfo infoFromHeader(FIBITMAP * dib, FREE_IMAGE_FORMAT fif, int pageCount)
+{
+	if( ! dib ) throw std::runtime_error("error reading image header");
+	ImageInfo result;
+	result.format = FreeImage_GetFormatFromFIF(fif);
+	result.width = FreeImage_GetWidth(dib);
+	result.height = FreeImage_GetHeight(dib);
+	result.bpp = FreeImage_GetBPP(dib);
+	result.hasAlpha = FreeImage_IsTransparent(dib);
+	result.pageCount = pageCount;
+	FITAG * tag = 0;
+	if( FreeImage_GetMetadata(FIMD_EXIF_MAIN,dib,"Orientation",&tag) && FreeImage_GetTagType(tag) == FIDT_SHORT ) {
+		result.orientation = *static_cast<WORD const *>(FreeImage_GetTagValue(tag));
+	}
+	FreeImage_Unload(dib);
+	return result;
+}
+
+// free functions don't construct an Image, so they have to initialize FreeImage themselves
+struct LibraryInitializer: private ImageInitializer {};
+
+// every bitmap block starts with a prefix telling where it goes back to. the prefix keeps
+// the FreeImage data behind it aligned on 16 bytes
+struct BlockPrefix {
+	BitmapPool::State * pool;
+	std::size_t capacity;
+};
+
+std::size_t const blockAlignment = 16;
+std::size_t const blockPrefixSize = 16;
+static_assert(sizeof(BlockPrefix) <= blockPrefixSize,"block prefix does not fit");
+
+unsigned char * allocateRaw(std::size_t capacity)
+{
+	return static_cast<unsigned char *>(::operator new(capacity,std::align_val_t(blockAlignment),std::nothrow));
+}
+
+void freeRaw(unsigned char * block)
+{
+	::operator delete(block,std::align_val_t(blockAlignment));
+}
+
+void * finishBlock(unsigned char * block, BitmapPool::State * pool, std::size_t capacity)
+{
+	if( ! block ) return nullptr;
+	BlockPrefix prefix = {pool,capacity};
+	std::memcpy(block,&prefix,sizeof(prefix));
+	return block + blockPrefixSize;
+}
+
+// rounds up to a quarter of the enclosing power of two, wasting at most 25%
+std::size_t sizeClass(std::size_t size)
+{
+	std::size_t step = 1024;
+	while( step * 8 <= size ) step *= 2;
+	return (size + step - 1) / step * step;
+}
+
+struct BitmapPool::State {
+	std::mutex mutex;
+	std::unordered_map<std::size_t,std::vector<unsigned char *>> freeBlocks;	// by capacity
+	std::size_t maxCachedBytes;
+	PoolStats stats;
+	std::size_t liveBlocks = 0;
+	std::size_t selections = 0;	// threads allocating from the pool through setThreadBitmapPool
+	// the pool is gone, the state lives on until its last block is released and no thread selects it
+	bool closed = false;
+
+	explicit State(std::size_t maxCachedBytes): maxCachedBytes(maxCachedBytes) {}
+
+	bool unused() const { return closed && liveBlocks == 0 && selections == 0; }
+
+	// counts a live block of capacity bytes, and returns a cached one if any
+	unsigned char * reserve(std::size_t capacity) {
+		unsigned char * block = nullptr;
+		std::lock_guard<std::mutex> lock(mutex);
+		auto & blocks = freeBlocks[capacity];
+		if( ! blocks.empty() ) {
+			block = blocks.back();
+			blocks.pop_back();
+			stats.bytesCached -= capacity;
+			++stats.hits;
+		} else {
+			++stats.misses;
+		}
+		++liveBlocks;
+		stats.bytesInUse += capacity;
+		stats.peakBytes = std::max(stats.peakBytes,stats.bytesInUse);
+		return block;
+	}
+
+	// the block of a reserve() call, allocated from the system if none was cached
+	void * finish(unsigned char * block, std::size_t capacity) {
+		if( ! block && ! (block = allocateRaw(capacity)) ) {
+			release(nullptr,capacity);
+			return nullptr;
+		}
+		return finishBlock(block,this,capacity);
+	}
+
+	void release(unsigned char * block, std::size_t capacity) {
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--liveBlocks;
+			stats.bytesInUse -= capacity;
+			if( block && ! closed && stats.bytesCached + capacity <= maxCachedBytes ) {
+				freeBlocks[capacity].push_back(block);
+				stats.bytesCached += capacity;
+				block = nullptr;
+			}
+			last = unused();
+		}
+		if( block ) freeRaw(block);
+		if( last ) delete this;
+	}
+
+	void select() {
+		std::lock_guard<std::mutex> lock(mutex);
+		++selections;
+	}
+
+	void deselect() {
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--selections;
+			last = unused();
+		}
+		if( last ) delete this;
+	}
+
+	void trim() {
+		std::unordered_map<std::size_t,std::vector<unsigned char *>> blocks;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			blocks.swap(freeBlocks);
+			stats.bytesCached = 0;
+		}
+		for( auto & entry : blocks )
+			for( auto block : entry.second ) freeRaw(block);
+	}
+};
+
+// the global pool is read under globalPoolMutex and its block reserved before unlocking,
+// so that a pool destroyed by another thread can't go away in between
+std::mutex globalPoolMutex;
+BitmapPool::State * globalPool = nullptr;
+
+// the pool selected by the calling thread, which keeps its state alive until the thread exits
+// or selects another pool
+struct ThreadPoolSelection {
+	BitmapPool::State * pool = nullptr;
+	void select(BitmapPool::State * state) {
+		if( state ) state->select();
+		if( pool ) pool->deselect();
+		pool = state;
+	}
+	~ThreadPoolSelection() { select(nullptr); }
+};
+thread_local ThreadPoolSelection threadPool;
+
+void * DLL_CALLCONV allocateBlock(std::size_t size, void *)
+{
+	auto const classCapacity = sizeClass(size + blockPrefixSize);
+	if( auto pool = threadPool.pool ) return pool->finish(pool->reserve(classCapacity),classCapacity);
+	BitmapPool::State * pool = nullptr;
+	unsigned char * block = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(globalPoolMutex);
+		pool = globalPool;
+		if( pool ) block = pool->reserve(classCapacity);
+	}
+	if( pool ) return pool->finish(block,classCapacity);
+	auto capacity = size + blockPrefixSize;
+	return finishBlock(allocateRaw(capacity),nullptr,capacity);
+}
+
+void DLL_CALLCONV releaseBlock(void * data, void *)
+{
+	auto block = static_cast<unsigned char *>(data) - blockPrefixSize;
+	BlockPrefix prefix;
+	std::memcpy(&prefix,block,sizeof(prefix));
+	if( prefix.pool ) {
+		prefix.pool->release(block,prefix.capacity);
+	} else {
+		freeRaw(block);
+	}
+}
+
+// installed once with FreeImage, before any bitmap can be allocated from another thread
+void installBitmapAllocator()
+{
+	FreeImageAllocator allocator;
+	allocator.alloc_proc = &allocateBlock;
+	allocator.free_proc = &releaseBlock;
+	allocator.user = nullptr;
+	FreeImage_SetBitmapAllocator(&allocator);
+}
+
+BitmapPool::BitmapPool(std::size_t maxCachedBytes):
+	state(new State(maxCachedBytes))
+{
+	LibraryInitializer();
+}
+
+BitmapPool::~BitmapPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(globalPoolMutex);
+		if( globalPool == state ) globalPool = nullptr;
+	}
+	if( threadPool.pool == state ) threadPool.select(nullptr);
+	// once closed, the last release or deselection deletes the state, so it must not be touched after unlocking
+	std::unordered_map<std::size_t,std::vector<unsigned char *>> blocks;
+	bool last = false;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->closed = true;
+		blocks.swap(state->freeBlocks);
+		state->stats.bytesCached = 0;
+		last = state->unused();
+	}
+	for( auto & entry : blocks )
+		for( auto block : entry.second ) freeRaw(block);
+	if( last ) delete state;
+}
+
+PoolStats BitmapPool::stats() const
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+	return state->stats;
+}
+
+void BitmapPool::trim()
+{
+	state->trim();
+}
+
+void setBitmapPool(BitmapPool * pool)
+{
+	LibraryInitializer();
+	std::lock_guard<std::mutex> lock(globalPoolMutex);
+	globalPool = pool ? pool->state : nullptr;
+}
+
+void setThreadBitmapPool(BitmapPool * pool)
+{
+	LibraryInitializer();
+	threadPool.select(pool ? pool->state : nullptr);
+}
+
+void setThreadCount(unsigned threads)
+{
+	configuredThreadCount = threads;
+}
+
+unsigned threadCount()
+{
+	if( auto threads = configuredThreadCount.load() ) return threads;
+	return std::max(std::thread::hardware_concurrency(),1u);
+}
+
+ResizeCacheStats resizeCacheStats()
+{
+	UINT64 hits = 0, misses = 0;
+	FreeImage_GetRescaleCacheStats(&hits,&misses);
+	ResizeCacheStats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	return stats;
+}
+
+void setResizeCacheSize(unsigned entries)
+{
+	FreeImage_SetRescaleCacheSize(entries);
+}
+
+void setRotateThreadCount(unsigned threads)
+{
+	FreeImage_SetRotateThreads(int(std::min(threads,255u)));
+}
+
+// the callbacks of resizeRows, whether one of them stopped the resize, and the exception thrown by one of them
+// (which must not cross FreeImage)
+struct RowStream {
+	RowReader const & readRow;
+	RowWriter const & writeRow;
+	bool stopped;
+	std::exception_ptr error;
+};
+
+BOOL DLL_CALLCONV readStreamRow(void * data, unsigned y, BYTE * bits)
+{
+	auto & stream = *static_cast<RowStream *>(data);
+	try {
+		stream.stopped = ! stream.readRow(y,bits);
+	} catch( ... ) {
+		stream.error = std::current_exception();
+		stream.stopped = true;
+	}
+	return ! stream.stopped;
+}
+
+BOOL DLL_CALLCONV writeStreamRow(void * data, unsigned y, BYTE const * bits)
+{
+	auto & stream = *static_cast<RowStream *>(data);
+	try {
+		stream.stopped = ! stream.writeRow(y,bits);
+	} catch( ... ) {
+		stream.error = std::current_exception();
+		stream.stopped = true;
+	}
+	return ! stream.stopped;
+}
+
+bool resizeRows(Size width, Size height, unsigned bpp, Size dstWidth, Size dstHeight, RowReader const & readRow,
+	RowWriter const & writeRow, ResizeFilter filter, ExecutionPolicy policy)
+{
+	if( bpp != 8 && bpp != 24 && bpp != 32 ) throw std::runtime_error("resizeRows supports 8, 24 and 32 bpp rows");
+	auto const limit = Size(std::numeric_limits<int>::max());
+	if( width == 0 || height == 0 || dstWidth == 0 || dstHeight == 0 || width > limit || height > limit
+		|| dstWidth > limit || dstHeight > limit ) throw std::runtime_error("invalid resizeRows size");
+	if( ! readRow || ! writeRow ) throw std::runtime_error("resizeRows needs both callbacks");
+
+	RowStream stream{readRow,writeRow,false,nullptr};
+	auto const done = FreeImage_RescaleStream(FIT_BITMAP,int(bpp),int(width),int(height),int(dstWidth),int(dstHeight),
+		0,0,int(width),int(height),readStreamRow,writeStreamRow,&stream,convertFilter(filter),rescaleFlags(policy));
+	if( stream.error ) std::rethrow_exception(stream.error);
+	if( ! done && ! stream.stopped ) throw std::runtime_error("could not resize rows");
+	return ! stream.stopped;
+}
+
+ImageInfo probe(char const * filename)
+{
+	LibraryInitializer();
+	auto fif = detectFormat(filename);
+	auto pageCount = isMultiPage(fif) ? countPages(FreeImage_OpenMultiBitmap(fif,filename,FALSE,TRUE,TRUE)) : 1;
+	return infoFromHeader(FreeImage_Load(fif,filename,FIF_LOAD_NOPIXELS),fif,pageCount);
+}
+
+ImageInfo probe(std::string const & filename)
+{
+	return probe(filename.c_str());
+}
+
+ImageInfo probe(std::istream & stream)
+{
+	LibraryInitializer();
+	auto io = readerIO();
+	StreamReader reader(stream);
+	auto handle = reinterpret_cast<fi_handle>(&reader);
+	auto start = reader.tell();
+	auto fif = FreeImage_GetFileTypeFromHandle(&io,handle);
+	if( fif == FIF_UNKNOWN ) throw std::runtime_error("can't autodetect image format");
+	auto pageCount = 1;
+	if( isMultiPage(fif) ) {
+		reader.seek(start,SEEK_SET);
+		pageCount = countPages(FreeImage_OpenMultiBitmapFromHandle(fif,&io,handle));
+	}
+	reader.seek(start,SEEK_SET);
+	return infoFromHeader(FreeImage_LoadFromHandle(fif,&io,handle,FIF_LOAD_NOPIXELS),fif,pageCount);
+}
+
+ImageInfo probe(void const * data, std::size_t size)
+{
+	LibraryInitializer();
+	auto memory = openMemory(data,size);
+	auto fif = FreeImage_GetFileTypeFromMemory(memory.get());
+	if( fif == FIF_UNKNOWN ) throw std::runtime_error("can't autodetect image format");
+	auto pageCount = isMultiPage(fif) ? countPages(FreeImage_LoadMultiBitmapFromMemory(fif,memory.get())) : 1;
+	return infoFromHeader(FreeImage_LoadFromMemory(fif,memory.get(),FIF_LOAD_NOPIXELS),fif,pageCount);
+}
+
+namespace jpeg {
+
+FREE_IMAGE_JPEG_OPERATION convertTransform(Transform op)
+{
+	switch( op ) {
+		case Transform::none: return FIJPEG_OP_NONE;
+		case Transform::flipH: return FIJPEG_OP_FLIP_H;
+		case Transform::flipV: return FIJPEG_OP_FLIP_V;
+		case Transform::transpose: return FIJPEG_OP_TRANSPOSE;
+		case Transform::transverse: return FIJPEG_OP_TRANSVERSE;
+		case Transform::rotate90: return FIJPEG_OP_ROTATE_90;
+		case Transform::rotate180: return FIJPEG_OP_ROTATE_180;
+		case Transform::rotate270: return FIJPEG_OP_ROTATE_270;
+	}
+	throw std::runtime_error("invalid JPEG transform");
+}
+
+// rect is null when there is no crop
+std::vector<unsigned char> transformMemory(void const * data, std::size_t size, Transform op, Rect * rect, bool perfect)
+{
+	LibraryInitializer();
+	auto src = openMemory(data,size);
+	MemoryPtr dst(FreeImage_OpenMemory(),&FreeImage_CloseMemory);
+	if( ! dst ) throw std::runtime_error("error opening memory stream");
+	if( ! FreeImage_JPEGTransformCombinedFromMemory(src.get(),dst.get(),convertTransform(op),rect ? &rect->left : nullptr,
+		rect ? &rect->top : nullptr,rect ? &rect->right : nullptr,rect ? &rect->bottom : nullptr,perfect) ) {
+		throw std::runtime_error("error transforming JPEG");
+	}
+
+	BYTE * result = 0;
+	DWORD resultSize = 0;
+	FreeImage_AcquireMemory(dst.get(),&result,&resultSize);
+	return std::vector<unsigned char>(result,result + resultSize);
+}
+
+void transformStream(std::istream & in, std::ostream & out, Transform op, Rect * rect, bool perfect)
+{
+	LibraryInitializer();
+	auto srcIO = readerIO();
+	auto dstIO = writerIO();
+	StreamReader reader(in);
+	StreamWriter writer(out);
+	if( ! FreeImage_JPEGTransformFromHandle(&srcIO,reinterpret_cast<fi_handle>(&reader),&dstIO,reinterpret_cast<fi_handle>(&writer),
+		convertTransform(op),rect ? &rect->left : nullptr,rect ? &rect->top : nullptr,rect ? &rect->right : nullptr,
+		rect ? &rect->bottom : nullptr,perfect) || ! writer.flush() ) {
+		throw std::runtime_error("error transforming JPEG stream");
+	}
+}
+
+// where the value of the Exif orientation tag (a SHORT of IFD0) is in a JPEG file. offset is 0 when there is none
+struct OrientationTag {
+	std::size_t offset = 0;
+	bool bigEndian = false;
+};
+
+std::uint32_t readTiff(unsigned char const * p, int bytes, bool bigEndian)
+{
+	if( ! bigEndian ) return readLE(p,bytes);
+	std::uint32_t result = 0;
+	for( int i = 0; i < bytes; ++i ) result = (result << 8) | p[i];
+	return result;
+}
+
+OrientationTag findOrientationTag(unsigned char const * data, std::size_t size)
+{
+	OrientationTag result;
+	if( size < 4 || data[0] != 0xFF || data[1] != 0xD8 ) return result;
+	// the Exif APP1 segment comes before the first scan
+	std::size_t pos = 2;
+	while( pos + 4 <= size && data[pos] == 0xFF ) {
+		auto const marker = data[pos + 1];
+		if( marker == 0xFF ) {
+			++pos;	// fill byte
+			continue;
+		}
+		if( marker == 0xDA || marker == 0xD9 ) break;
+		std::size_t const length = readTiff(data + pos + 2,2,true);
+		if( length < 2 || length > size - pos - 2 ) break;
+		auto const segment = data + pos + 4;
+		auto const segmentSize = length - 2;
+		if( marker == 0xE1 && segmentSize >= 14 && std::memcmp(segment,"Exif\0\0",6) == 0 ) {
+			auto const tiff = segment + 6;
+			auto const tiffSize = segmentSize - 6;
+			bool const bigEndian = tiff[0] == 'M' && tiff[1] == 'M';
+			if( ! bigEndian && (tiff[0] != 'I' || tiff[1] != 'I') ) return result;
+			if( readTiff(tiff + 2,2,bigEndian) != 42 ) return result;
+			std::size_t const ifd = readTiff(tiff + 4,4,bigEndian);
+			if( ifd >= tiffSize || tiffSize - ifd < 2 ) return result;
+			std::size_t const count = readTiff(tiff + ifd,2,bigEndian);
+			for( std::size_t i = 0; i < count && (tiffSize - ifd - 2) / 12 > i; ++i ) {
+				auto const entry = tiff + ifd + 2 + i * 12;
+				// SHORT, one value, stored in the entry itself
+				if( readTiff(entry,2,bigEndian) == 0x0112 && readTiff(entry + 2,2,bigEndian) == 3 && readTiff(entry + 4,4,bigEndian) == 1 ) {
+					result.offset = std::size_t(entry + 8 - data);
+					result.bigEndian = bigEndian;
+					return result;
+				}
+			}
+			return result;
+		}
+		pos += 2 + length;
+	}
+	return result;
+}
+
+std::vector<unsigned char> readAll(std::istream & in)
+{
+	std::vector<unsigned char> result;
+	std::size_t size = 0;
+	do {
+		result.resize(size + streamBufferSize);
+		in.read(reinterpret_cast<char *>(result.data() + size),std::streamsize(streamBufferSize));
+		size += std::size_t(in.gcount());
+	} while( in );
+	if( in.bad() ) throw std::runtime_error("error reading JPEG stream");
+	result.resize(size);
+	return result;
+}
+
+std::vector<unsigned char> transform(void const * data, std::size_t size, Transform op, bool perfect)
+{
+	return transformMemory(data,size,op,nullptr,perfect);
+}
+
+void transform(std::istream & in, std::ostream & out, Transform op, bool perfect)
+{
+	transformStream(in,out,op,nullptr,perfect);
+}
+
+std::vector<unsigned char> crop(void const * data, std::size_t size, Rect & rect, Transform op)
+{
+	return transformMemory(data,size,op,&rect,false);
+}
+
+void crop(std::istream & in, std::ostream & out, Rect & rect, Transform op)
+{
+	transformStream(in,out,op,&rect,false);
+}
+
+Transform orientationTransform(int orientation)
+{
+	switch( orientation ) {
+		case 2: return Transform::flipH;
+		case 3: return Transform::rotate180;
+		case 4: return Transform::flipV;
+		case 5: return Transform::transpose;
+		case 6: return Transform::rotate90;
+		case 7: return Transform::transverse;
+		case 8: return Transform::rotate270;
+		default: return Transform::none;
+	}
+}
+
+std::vector<unsigned char> autoOrient(void const * data, std::size_t size, bool perfect)
+{
+	auto const bytes = static_cast<unsigned char const *>(data);
+	auto const tag = findOrientationTag(bytes,size);
+	auto const op = tag.offset ? orientationTransform(int(readTiff(bytes + tag.offset,2,tag.bigEndian))) : Transform::none;
+	if( op == Transform::none ) return std::vector<unsigned char>(bytes,bytes + size);
+
+	auto result = transformMemory(data,size,op,nullptr,perfect);
+	// the markers are copied as they are, the tag still holds the orientation which has just been applied
+	auto const copied = findOrientationTag(result.data(),result.size());
+	if( copied.offset ) {
+		result[copied.offset] = copied.bigEndian ? 0 : 1;
+		result[copied.offset + 1] = copied.bigEndian ? 1 : 0;
+	}
+	return result;
+}
+
+void autoOrient(std::istream & in, std::ostream & out, bool perfect)
+{
+	auto const data = readAll(in);
+	auto const result = autoOrient(data.data(),data.size(),perfect);
+	if( ! out.write(reinterpret_cast<char const *>(result.data()),std::streamsize(result.size())) ) {
+		throw std::runtime_error("error writing JPEG stream");
+	}
+}
+
+}
+
 Type TypeFromExtension(char const * filename) {
 	auto pt = std::strrchr(filename,'.');
 	if( ! pt ) throw std::runtime_error("filename has no extension");
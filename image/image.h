@@ -1,11 +1,19 @@
 #ifndef IMAGE_WRAPPER_H_GUARD_KJASIDc0ewir32j42nrjfdszf93
 #define IMAGE_WRAPPER_H_GUARD_KJASIDc0ewir32j42nrjfdszf93
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <istream>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <ostream>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 struct FIBITMAP;
 
@@ -24,12 +32,169 @@ struct Color {
 	}
 };
 
+// scanline pixel layouts. FreeImage stores 24 and 32 bpp pixels in BGR(A) order on little endian machines
+struct Pixel24 {
+	Color::component b,g,r;
+	// alpha 0, as getColor() reports for 24bpp images
+	Color toColor() const { return {r,g,b,0}; }
+	static Pixel24 fromColor(Color color) { return {color.b,color.g,color.r}; }
+};
+
+struct Pixel32 {
+	Color::component b,g,r,a;
+	Color toColor() const { return {r,g,b,a}; }
+	static Pixel32 fromColor(Color color) { return {color.b,color.g,color.r,color.a}; }
+};
+
+/**
+ * A 32bpp pixel of a premultiplied image. toColor() and fromColor() convert to and from straight colors,
+ * rounding as unpremultiplyInPlace() and premultiplyInPlace(). A fully transparent pixel is black.
+ */
+struct PremultipliedPixel32 {
+	Color::component b,g,r,a;
+	Color toColor() const {
+		if( a == 0 ) return {0,0,0,0};
+		float scale = 255.0f / float(a);
+		auto straight = [scale](Color::component c) { return Color::component(std::min(float(c) * scale + 0.5f,255.0f)); };
+		return {straight(r),straight(g),straight(b),a};
+	}
+	static PremultipliedPixel32 fromColor(Color color) {
+		auto premultiplied = [color](Color::component c) { return Color::component((c * color.a + 127) / 255); };
+		return {premultiplied(color.b),premultiplied(color.g),premultiplied(color.r),color.a};
+	}
+};
+
+static_assert(sizeof(Pixel24) == 3, "Pixel24 must map exactly onto a 24bpp scanline");
+static_assert(sizeof(Pixel32) == 4, "Pixel32 must map exactly onto a 32bpp scanline");
+static_assert(sizeof(PremultipliedPixel32) == 4, "PremultipliedPixel32 must map exactly onto a 32bpp scanline");
+
+enum class RowOrder { bottomUp, topDown };
+
+/** A single scanline of an ImageView. */
+template<typename T>
+class Row {
+	T * first;
+	Size count;
+public:
+	Row(T * first, Size count): first(first), count(count) {}
+
+	T * begin() const { return first; }
+	T * end() const { return first + count; }
+	T * data() const { return first; }
+	Size size() const { return count; }
+	T & operator[](Size x) const { return first[x]; }
+};
+
+/**
+ * Non-owning, stride-aware view over the pixels of an Image.
+ * Iterating a view yields its rows in the order chosen when the view was created.
+ * A view is invalidated by any operation that replaces the underlying bitmap.
+ */
+template<typename T>
+class ImageView {
+	using byte = std::conditional_t<std::is_const<T>::value, unsigned char const, unsigned char>;
+
+	byte * origin;			// first row in iteration order
+	std::ptrdiff_t pitch;	// byte distance between consecutive rows. negative when walking bottom-up storage top-down
+	Size w, h;
+public:
+	class iterator {
+		byte * current;
+		std::ptrdiff_t pitch;
+		Size w;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Row<T>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = Row<T>;
+
+		iterator(byte * current, std::ptrdiff_t pitch, Size w): current(current), pitch(pitch), w(w) {}
+
+		Row<T> operator*() const { return Row<T>(reinterpret_cast<T *>(current),w); }
+		iterator & operator++() { current += pitch; return *this; }
+		iterator operator++(int) { auto result = *this; current += pitch; return result; }
+		bool operator==(iterator const & it) const { return current == it.current; }
+		bool operator!=(iterator const & it) const { return current != it.current; }
+	};
+
+	ImageView(byte * origin, std::ptrdiff_t pitch, Size width, Size height):
+		origin(origin), pitch(pitch), w(width), h(height) {}
+
+	Size width() const { return w; }
+	Size height() const { return h; }
+	std::ptrdiff_t stride() const { return pitch; }
+	byte * data() const { return origin; }
+
+	Row<T> row(Size y) const { return Row<T>(reinterpret_cast<T *>(origin + pitch * std::ptrdiff_t(y)),w); }
+	Row<T> operator[](Size y) const { return row(y); }
+	T & operator()(Size x, Size y) const { return row(y)[x]; }
+
+	iterator begin() const { return iterator(origin,pitch,w); }
+	iterator end() const { return iterator(origin + pitch * std::ptrdiff_t(h),pitch,w); }
+};
+
 enum Type { BMP, GIF, JPG, PNG, };
 
+/** Decoder settings for Image::load. Settings that don't apply to the format being loaded are ignored. */
+struct LoadOptions {
+	bool accurate = false;			// JPEG: slower, higher quality DCT and upsampling
+	bool exifRotate = false;		// JPEG: rotate according to the Exif orientation tag
+	bool greyscale = false;			// JPEG: decode straight to 8 bit greyscale
+	bool rawPreview = false;		// RAW: load the embedded preview instead of developing the sensor data
+	bool rawHalfSize = false;		// RAW: develop at half size
+	bool ignoreGamma = false;		// PNG: skip gamma correction
+	bool gifPlayback = false;		// GIF: compose the frame as 32bpp instead of returning raw frame data
+	/**
+	 * Allow the decoder to shrink the image while decoding, as long as the larger dimension stays >= minimumSize.
+	 * JPEG files decode at N/8 scale, the cheapest way to load a big photo destined to become a thumbnail.
+	 * 0 loads the full image.
+	 */
+	Size minimumSize = 0;
+	/**
+	 * Load files through a memory mapping instead of stdio reads (POSIX only, ignored elsewhere).
+	 * Uncompressed 24/32bpp BMP and TGA files are used in place: the pixels stay in the mapping, copy-on-write,
+	 * for the lifetime of the image. The file must not be truncated while such an image is alive.
+	 */
+	bool memoryMap = false;
+};
+
 enum ResizeFilter {
 	box, bilinear, bspline, bicubic, catmullrom, lanczos3,
 };
 
+/**
+ * Speed/quality tradeoff of Image::thumbnail. fast and balanced average blocks of pixels of 8 bit per channel
+ * images down to 2 (respectively 4) times the thumbnail size, then filter once (bilinear, respectively lanczos3).
+ * best filters the full image with lanczos3. Loading JPEG files with LoadOptions::minimumSize is faster still.
+ */
+enum class ThumbnailQuality { fast, balanced, best };
+
+/** Position of a level of Image::buildPyramid in a caller provided buffer. */
+struct PyramidLevel {
+	Size width = 0, height = 0;
+	std::size_t offset = 0;		// bytes from the start of the buffer to the first row
+	std::size_t pitch = 0;		// bytes between rows
+};
+
+/** How an operation may spread its work over threads. Results don't depend on the number of threads. */
+struct ExecutionPolicy {
+	unsigned threads = 0;	// including the calling thread, 0 uses threadCount()
+};
+
+/** Run on the calling thread only. */
+constexpr ExecutionPolicy sequential{1};
+/** Run on threadCount() threads. */
+constexpr ExecutionPolicy parallel{0};
+
+/** How composite() combines the colors of the source with those of the image. src alpha ends up over the image alpha. */
+enum class BlendMode {
+	over,				// src over the image, straight (non-premultiplied) colors
+	premultipliedOver,	// src over the image, both with colors premultiplied by their alpha
+	add,				// adds the src colors weighted by their alpha, clamped to 255
+	multiply			// multiplies by the src colors, weighted by their alpha
+};
+
 class ImageInitializer {
 protected:
 	ImageInitializer();
@@ -40,12 +205,22 @@ class Image: private ImageInitializer {
 		void operator()(FIBITMAP * image) const;
 	};
 
+	std::shared_ptr<void> mapping;	// file mapping holding the pixels of an in-place loaded image. must outlive image
 	std::unique_ptr<FIBITMAP,Deleter> image;
 	int type;
+	bool premultipliedAlpha = false;	// colors stored multiplied by their alpha, see premultiplyInPlace()
 
-	Image(FIBITMAP * image, int type);
+	Image(FIBITMAP * image, int type, bool premultiplied = false);
+
+	void reset(FIBITMAP * dib, int type, std::shared_ptr<void> mapping = nullptr);
+	void loadMapped(char const * filename, LoadOptions const & options);
 
 	void save(std::ostream & stream, int type) const;
+	std::vector<unsigned char> encode(int type) const;
+	FIBITMAP * straightAlpha(std::unique_ptr<FIBITMAP,Deleter> & copy) const;
+	ImageView<unsigned char> byteView(RowOrder order, std::size_t elementSize) const;
+	void replacePaletteColors(std::function<bool(Color)> const & predicate, std::function<Color(Color)> const & colorChanger);
+	void replacePixelColors(std::function<bool(Color)> const & predicate, std::function<Color(Color)> const & colorChanger);
 public:
 	Image(); // create a zombie image
 	// ~Image();
@@ -56,36 +231,137 @@ public:
 
  	/** Create a black image. */
 	Image(Size width, Size height, int bpp);
-	explicit Image(char const * filename);
-	explicit Image(std::string const & filename);
-	Image(std::istream & stream, Type type);
+	explicit Image(char const * filename, LoadOptions const & options = LoadOptions());
+	explicit Image(std::string const & filename, LoadOptions const & options = LoadOptions());
+	Image(std::istream & stream, Type type, LoadOptions const & options = LoadOptions());
+	/** Decode an image held in memory. The buffer is only read during the call and is not copied. */
+	Image(void const * data, std::size_t size, Type type, LoadOptions const & options = LoadOptions());
 
-	void load(char const * filename);
-	void load(std::istream & stream, Type type);
+	void load(char const * filename, LoadOptions const & options = LoadOptions());
+	void load(std::istream & stream, Type type, LoadOptions const & options = LoadOptions());
+	void load(void const * data, std::size_t size, Type type, LoadOptions const & options = LoadOptions());
 
 	Image clone() const;
-	Image to32bpp() const;
+	// the rvalue overloads transform the image in place, as the *InPlace functions below
+	Image to32bpp() const &;
+	Image to32bpp() &&;
 
-	Image thumbnail(Size squareSize) const;
+	Image thumbnail(Size squareSize, ThumbnailQuality quality = ThumbnailQuality::fast) const;
 	Image resize(Size width, Size height, ResizeFilter filter = bicubic) const;
-	Image rotate(double degrees) const;
-	Image flipH() const;
-	Image flipV() const;
+	/** Resize with the filter passes split over the threads of policy, e.g. resize(w,h,lanczos3,parallel). */
+	Image resize(Size width, Size height, ResizeFilter filter, ExecutionPolicy policy) const;
+	/**
+	 * Successive half-size reductions of the image (width and height halved rounding down, at least 1),
+	 * each computed from the previous one. Stops after levels reductions or at 1x1, the image itself is not included.
+	 * box averages 2x2 blocks exactly and computes all the levels of even size in one pass over the image.
+	 */
+	std::vector<Image> buildPyramid(unsigned levels, ResizeFilter filter = box) const;
+	/**
+	 * buildPyramid into one buffer laid out for texture upload: the levels follow each other, as targetBpp rows
+	 * of alignment bytes, each level starting on an alignment boundary. Throws if the buffer is smaller than
+	 * pyramidSize(). Returns the position of each level.
+	 */
+	std::vector<PyramidLevel> buildPyramid(void * dst, std::size_t size, unsigned levels, unsigned targetBpp,
+		ResizeFilter filter = box, RowOrder order = RowOrder::topDown, std::size_t alignment = 4) const;
+	/** Layout of the buffer of buildPyramid. The buffer size is the offset of the last level plus its rows. */
+	std::vector<PyramidLevel> pyramidLayout(unsigned levels, unsigned targetBpp, std::size_t alignment = 4) const;
+	std::size_t pyramidSize(unsigned levels, unsigned targetBpp, std::size_t alignment = 4) const;
+	/**
+	 * Resize into dst, keeping its size. Nothing is allocated when dst already has the pixel format that
+	 * resize() would produce, besides the intermediate buffer of the two pass filter (recycled by a BitmapPool).
+	 * Otherwise dst is reallocated once in that format. dst's metadata is left untouched.
+	 */
+	void resizeInto(Image & dst, ResizeFilter filter = bicubic) const;
+	void resizeInto(Image & dst, ResizeFilter filter, ExecutionPolicy policy) const;
+	Image rotate(double degrees) const &;
+	Image rotate(double degrees) &&;
+	/**
+	 * Rotate by degrees (counter clockwise, as rotate) about the center with cubic B-spline interpolation,
+	 * keeping the size: the corners are cut and the uncovered pixels are black. 8, 24 and 32bpp images only.
+	 */
+	Image rotateSpline(double degrees) const;
+	Image flipH() const &;
+	Image flipH() &&;
+	Image flipV() const &;
+	Image flipV() &&;
 	// rectangle is closed
 	Image clip(int left, int top, int right, int bottom) const;
 
 	// non-const functions
 	Image & replace(Color origColor, Color newColor);
-	Image & replaceColors(std::function<bool(img::Color)> predicate, std::function<img::Color(img::Color)> colorChanger);
+	/**
+	 * Replace each color of colorMap.first with its colorMap.second, in a single pass with one hash lookup per pixel.
+	 * A color listed twice takes its first replacement. Palettized images have their palette changed instead of their pixels.
+	 */
+	Image & replace(std::vector<std::pair<Color,Color>> const & colorMap);
+	/**
+	 * Replace every color accepted by predicate with colorChanger(color).
+	 * 24 and 32 bpp images are processed row by row with both functors inlined.
+	 * Palettized images have their palette (and transparency table) changed instead of their pixels.
+	 */
+	template<typename Predicate, typename ColorChanger>
+	Image & replaceColors(Predicate predicate, ColorChanger colorChanger);
+	/**
+	 * Make every 32bpp pixel whose r,g,b lie within [first,last] (per channel, inclusive) fully transparent.
+	 * The pixels of a premultiplied image are compared by their straight colors and become black as well.
+	 */
+	Image & makeTransparent(Color first, Color last);
+
+	/**
+	 * Premultiplied alpha: the colors of a 32bpp image are stored multiplied by their alpha, so that resize, rotate,
+	 * thumbnails and pyramids filter the colors in proportion to their coverage, without a conversion per operation.
+	 * Images derived from a premultiplied image are premultiplied as well; loaded images are not.
+	 * getColor, setColor, replace, replaceColors and makeTransparent work with straight colors, converting
+	 * the pixels as PremultipliedPixel32 does; views and raw bits see the stored values; save and encode write
+	 * straight colors.
+	 */
+	bool premultiplied() const;
+	/** Multiply the colors of a 32bpp image by their alpha. Does nothing if the image already is premultiplied. */
+	Image & premultiplyInPlace();
+	/** Divide the colors back by their alpha. Does nothing if the image is not premultiplied. */
+	Image & unpremultiplyInPlace();
+
+	/**
+	 * In-place transforms. The pixel buffer is reused whenever the result has the same layout:
+	 * flips always, rotations by 180 degrees, and by 90/270 degrees for square 8/24/32 bpp images.
+	 * Other cases allocate the result and release the old buffer.
+	 */
+	Image & flipHInPlace();
+	Image & flipVInPlace();
+	Image & rotateInPlace(double degrees);
+	Image & to32bppInPlace();
 
+	/** Copy subImage with its top-left corner at (x,y). Both must be premultiplied, or neither. */
 	bool pasteFrom(Image const & subImage, Size x, Size y);
+	/**
+	 * Blend src onto this image with its top-left corner at (x,y), which may lie outside: only the overlap is changed.
+	 * Both images must be 32bpp, and different. The rows are split over the threads of policy.
+	 * Both must be premultiplied, or neither: over then blends premultiplied colors, add and multiply need straight ones.
+	 */
+	Image & composite(Image const & src, int x, int y, BlendMode mode = BlendMode::over, ExecutionPolicy policy = sequential);
 
 	Size width() const;
 	Size height() const;
 	unsigned bpp() const;
 	unsigned char * rawBits() const;
+	unsigned pitch() const;
+
+	/**
+	 * Typed access to the scanlines. T is either a byte type (rows span every used byte of the line)
+	 * or a pixel type whose size matches bpp(), like Pixel24 or Pixel32.
+	 * Row 0 is the top of the image for RowOrder::topDown, matching getColor(), and the bottom for RowOrder::bottomUp.
+	 */
+	template<typename T = unsigned char>
+	ImageView<T> view(RowOrder order = RowOrder::topDown);
+	template<typename T = unsigned char>
+	ImageView<T const> view(RowOrder order = RowOrder::topDown) const;
 
 	std::unique_ptr<unsigned char[]> toRawBits(unsigned targetBpp) const;
+	/**
+	 * Convert the pixels to targetBpp into a caller provided buffer of size bytes, rows pitch bytes apart.
+	 * Nothing is allocated. Throws if the buffer can't hold height() rows.
+	 */
+	void toRawBits(void * dst, std::size_t size, unsigned targetBpp, std::size_t pitch, RowOrder order = RowOrder::topDown) const;
 
 	// slow pixel access functions. use with care. y starts at the bottom!
 	int getColorIndex(Size x, Size y) const;
@@ -106,9 +382,195 @@ public:
 	void save(std::ostream & stream) const;
 	void save(std::ostream & stream, Type type) const;
 
+	// encode to an in-memory file
+	std::vector<unsigned char> encode() const;
+	std::vector<unsigned char> encode(Type type) const;
+
 	explicit operator bool() const;
 };
 
+template<typename Pixel, typename Predicate, typename ColorChanger>
+void replaceViewColors(ImageView<Pixel> const & view, Predicate & predicate, ColorChanger & colorChanger)
+{
+	for( auto row : view ) {
+		for( auto & pixel : row ) {
+			auto color = pixel.toColor();
+			if( predicate(color) ) {
+				pixel = Pixel::fromColor(colorChanger(color));
+			}
+		}
+	}
+}
+
+template<typename Predicate, typename ColorChanger>
+Image & Image::replaceColors(Predicate predicate, ColorChanger colorChanger)
+{
+	switch( bpp() ) {
+		case 32:
+			if( premultipliedAlpha ) replaceViewColors(view<PremultipliedPixel32>(),predicate,colorChanger);
+			else replaceViewColors(view<Pixel32>(),predicate,colorChanger);
+			break;
+		case 24:
+			replaceViewColors(view<Pixel24>(),predicate,colorChanger);
+			break;
+		case 1:
+		case 4:
+		case 8:
+			replacePaletteColors(std::ref(predicate),std::ref(colorChanger));
+			break;
+		default:
+			replacePixelColors(std::ref(predicate),std::ref(colorChanger));
+	}
+	return *this;
+}
+
+template<typename T>
+ImageView<T> Image::view(RowOrder order)
+{
+	auto bytes = byteView(order,sizeof(T));
+	return ImageView<T>(bytes.data(),bytes.stride(),bytes.width()/Size(sizeof(T)),bytes.height());
+}
+
+template<typename T>
+ImageView<T const> Image::view(RowOrder order) const
+{
+	auto bytes = byteView(order,sizeof(T));
+	return ImageView<T const>(bytes.data(),bytes.stride(),bytes.width()/Size(sizeof(T)),bytes.height());
+}
+
+/** Image properties read from the file header. See probe(). */
+struct ImageInfo {
+	std::string format;		// FreeImage format name, like "JPEG" or "PNG"
+	Size width = 0, height = 0;
+	unsigned bpp = 0;
+	bool hasAlpha = false;
+	int pageCount = 1;
+	int orientation = 1;	// Exif orientation (1 to 8). 1 when the file has none
+};
+
+/**
+ * Read the image properties without decoding its pixels.
+ * Formats whose plugin can't stop after the header (see FreeImage_FIFSupportsNoPixels) are decoded fully.
+ */
+ImageInfo probe(char const * filename);
+ImageInfo probe(std::string const & filename);
+ImageInfo probe(std::istream & stream);
+ImageInfo probe(void const * data, std::size_t size);
+
+/** Lossless JPEG operations. They work on the compressed DCT coefficients: no pixel is decoded or encoded again. */
+namespace jpeg {
+
+/** Rotations are clockwise. transpose mirrors across the top-left to bottom-right diagonal, transverse across the other one. */
+enum class Transform { none, flipH, flipV, transpose, transverse, rotate90, rotate180, rotate270 };
+
+/** Crop rectangle, right and bottom excluded. right and bottom <= 0 count inwards from the right and bottom edges. */
+struct Rect {
+	int left = 0, top = 0, right = 0, bottom = 0;
+};
+
+/**
+ * Flip or rotate a JPEG file without generation loss. Markers (Exif, ICC profile...) are copied as they are.
+ * The blocks of the right and bottom edges that are only partly inside the image can't be moved: when the operation
+ * would have to, they are trimmed (less than 16 pixel rows or columns), or the call throws if perfect is set.
+ * The stream version reads the file from in and writes the result to out as it goes.
+ */
+std::vector<unsigned char> transform(void const * data, std::size_t size, Transform op, bool perfect = false);
+void transform(std::istream & in, std::ostream & out, Transform op, bool perfect = false);
+
+/**
+ * transform() then crop to rect, given in the coordinates of the transformed image. The left and top edges move out to
+ * the previous block boundary (8 or 16 pixels). rect receives the area actually kept; empty rectangles keep everything.
+ */
+std::vector<unsigned char> crop(void const * data, std::size_t size, Rect & rect, Transform op = Transform::none);
+void crop(std::istream & in, std::ostream & out, Rect & rect, Transform op = Transform::none);
+
+/** The transform which shows upright an image with the given Exif orientation. none for 1 and invalid values. */
+Transform orientationTransform(int orientation);
+
+/**
+ * Apply the Exif orientation of a JPEG file with transform() and reset the tag to 1.
+ * Files without orientation or already upright are copied unchanged. The stream version reads in to its end.
+ */
+std::vector<unsigned char> autoOrient(void const * data, std::size_t size, bool perfect = false);
+void autoOrient(std::istream & in, std::ostream & out, bool perfect = false);
+
+}
+
+/** Counters of a BitmapPool. Sizes are in bytes of pooled blocks. */
+struct PoolStats {
+	std::size_t hits = 0;			// allocations served from a recycled block
+	std::size_t misses = 0;			// allocations that went to the system allocator
+	std::size_t bytesInUse = 0;
+	std::size_t peakBytes = 0;		// highest bytesInUse so far
+	std::size_t bytesCached = 0;	// free blocks kept for reuse
+};
+
+/**
+ * Recycles the memory of image bitmaps (header, palette and pixels) by size class, so repeated jobs on
+ * same-sized images stop going to the system allocator. Select a pool with setBitmapPool (every thread)
+ * or setThreadBitmapPool (the calling thread, takes precedence). Images may outlive the pool they came from.
+ * Destroying a pool unselects it globally and for the calling thread; other threads that still select it
+ * allocate from the system until they select another pool or exit.
+ */
+class BitmapPool {
+public:
+	struct State;
+
+	/** Free blocks beyond maxCachedBytes are returned to the system. */
+	explicit BitmapPool(std::size_t maxCachedBytes = std::size_t(256) << 20);
+	~BitmapPool();
+	BitmapPool(BitmapPool const &) = delete;
+	BitmapPool & operator=(BitmapPool const &) = delete;
+
+	PoolStats stats() const;
+	/** Return every cached block to the system. */
+	void trim();
+private:
+	State * state;
+	friend void setBitmapPool(BitmapPool * pool);
+	friend void setThreadBitmapPool(BitmapPool * pool);
+};
+
+/** Allocate the bitmaps of all threads from pool. nullptr goes back to the system allocator. */
+void setBitmapPool(BitmapPool * pool);
+/** Allocate the bitmaps of the calling thread from pool, regardless of setBitmapPool. nullptr clears it. */
+void setThreadBitmapPool(BitmapPool * pool);
+
+/** Set the number of threads of the parallel policy. 0, the default, uses every hardware thread. */
+void setThreadCount(unsigned threads);
+unsigned threadCount();
+
+/** Counters of the filter weights cache of resize, one lookup per filter pass. */
+struct ResizeCacheStats {
+	std::uint64_t hits = 0;		// weights reused from an earlier resize with the same sizes and filter
+	std::uint64_t misses = 0;	// weights computed
+};
+
+ResizeCacheStats resizeCacheStats();
+/** Keep the weights of the last entries resize geometries (64 by default). 0 disables the cache. */
+void setResizeCacheSize(unsigned entries);
+
+/**
+ * Set the number of threads of rotate() and rotateInPlace() by angles other than multiples of 90 degrees
+ * and of rotateSpline(), 1 by default. 0 uses every hardware thread. Results don't depend on it.
+ */
+void setRotateThreadCount(unsigned threads);
+
+/** Fills the source row y of resizeRows (width * bpp / 8 bytes), returns false to stop. */
+using RowReader = std::function<bool(Size y, unsigned char * row)>;
+/** Receives the destination row y of resizeRows (dstWidth * bpp / 8 bytes), returns false to stop. */
+using RowWriter = std::function<bool(Size y, unsigned char const * row)>;
+
+/**
+ * Resize a width x height image of 8, 24 or 32 bpp which is never loaded as a whole, e.g. rows coming from a decoder.
+ * readRow is called for the source rows in order, writeRow for the destination rows in order, each as soon as the
+ * source rows under the filter have been read; only those rows are kept, so a 30000x30000 scan needs a few MB.
+ * The filter passes run on the calling thread unless policy says otherwise, as for resize().
+ * Returns false if a callback returned false. Exceptions thrown by the callbacks are passed on.
+ */
+bool resizeRows(Size width, Size height, unsigned bpp, Size dstWidth, Size dstHeight, RowReader const & readRow,
+	RowWriter const & writeRow, ResizeFilter filter = bicubic, ExecutionPolicy policy = sequential);
+
 Type TypeFromExtension(char const * filename);
 Type TypeFromExtension(std::string const & filename);
 